@@ -0,0 +1,121 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Anomaly Detector Evaluation (host)
+ *
+ * pio run -e native_anomaly
+ * .pio/build/native_anomaly/program [options] trace.csv [trace.csv ...]
+ *
+ * Runs include/anomaly.h over recorded PPM traces ("t_ms,ppm" per line,
+ * '#' comments and a header line are skipped) and prints one JSON line per
+ * trace: events, false alarms before --onset and detection latency.
+ *
+ * Options: --onset <ms>  leak start within the trace (omit for clean air)
+ *          --slope <ppm/s> --alpha <a> --cusum-k <k> --cusum-h <h>
+ *          --holdoff <ms>
+ */
+
+#include "anomaly.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Evaluation Types
+// ============================================
+
+struct TraceResult {
+  uint32_t samples;
+  uint32_t events;
+  uint32_t falseAlarms;  // Events before the onset
+  long firstDetectionMs; // -1 = not detected after the onset
+  const char *firstKind;
+  float ppmAtDetection;
+};
+
+// ============================================
+// Evaluation Functions
+// ============================================
+
+/**
+ * Run one trace file through a fresh detector
+ */
+bool evaluateTrace(const char *path, const AnomalyParams &params, long onsetMs,
+                   TraceResult &result) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+
+  AnomalyDetector det;
+  anomalyReset(det);
+  memset(&result, 0, sizeof(result));
+  result.firstDetectionMs = -1;
+  result.firstKind = "none";
+
+  char line[128];
+  while (fgets(line, sizeof(line), in)) {
+    unsigned long t;
+    float ppm;
+    if (line[0] == '#' || sscanf(line, "%lu,%f", &t, &ppm) != 2) {
+      continue;
+    }
+
+    result.samples++;
+    uint8_t flags = anomalyUpdate(det, params, ppm, (uint32_t)t);
+    if (flags == ANOMALY_NONE) {
+      continue;
+    }
+
+    result.events++;
+    if (onsetMs < 0 || (long)t < onsetMs) {
+      result.falseAlarms++;
+    } else if (result.firstDetectionMs < 0) {
+      result.firstDetectionMs = (long)t - onsetMs;
+      result.firstKind = anomalyName(flags);
+      result.ppmAtDetection = ppm;
+    }
+  }
+
+  fclose(in);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  AnomalyParams params = anomalyDefaultParams();
+  long onsetMs = -1;
+  int status = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (hasValue && strcmp(arg, "--onset") == 0) {
+      onsetMs = atol(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--slope") == 0) {
+      params.slopeLimit = atof(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--alpha") == 0) {
+      params.ewmaAlpha = atof(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--cusum-k") == 0) {
+      params.cusumK = atof(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--cusum-h") == 0) {
+      params.cusumH = atof(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--holdoff") == 0) {
+      params.holdoffMs = (uint32_t)atol(argv[++i]);
+    } else {
+      TraceResult result;
+      if (!evaluateTrace(arg, params, onsetMs, result)) {
+        status = 1;
+        continue;
+      }
+      printf("{\"trace\":\"%s\",\"samples\":%u,\"events\":%u,"
+             "\"false_alarms\":%u,\"detection_ms\":%ld,\"kind\":\"%s\","
+             "\"ppm_at_detection\":%.1f}\n",
+             arg, (unsigned)result.samples, (unsigned)result.events,
+             (unsigned)result.falseAlarms, result.firstDetectionMs,
+             result.firstKind, result.ppmAtDetection);
+    }
+  }
+
+  return status;
+}
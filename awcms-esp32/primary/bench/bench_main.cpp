@@ -0,0 +1,291 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Hot-Path Benchmarks
+ *
+ * Host:   pio run -e native_bench && .pio/build/native_bench/program
+ * Device: pio run -e bench -t upload && pio device monitor
+ *
+ * Prints one JSON line per benchmark. Compare against a stored baseline with
+ * scripts/bench_compare.py.
+ */
+
+#include "anomaly.h"
+#include "auth.h"
+#include "bench.h"
+#include "config.h"
+#include "gas_math.h"
+#include "gas_sensor.h"
+#include "mem_pools.h"
+#include "rules.h"
+#include "trace.h"
+#include "triple_buffer.h"
+#include "window_stats.h"
+#include <ESPAsyncWebServer.h>
+
+#ifdef ARDUINO
+#include "camera.h"
+#include "history.h"
+#include "mqtt_client.h"
+#include "ota.h"
+#include "recorder.h"
+#include "snapshot.h"
+#include "sync_schedule.h"
+#include "webserver.h"
+#endif
+
+// ============================================
+// Benchmark Configuration
+// ============================================
+
+// Iterations per benchmark (device runs use the reduced counts)
+#ifdef ARDUINO
+#define BENCH_ITERATIONS_FAST 20000
+#define BENCH_ITERATIONS_JSON 2000
+#else
+#define BENCH_ITERATIONS_FAST 1000000
+#define BENCH_ITERATIONS_JSON 100000
+#endif
+
+// Fake WebSocket client counts for the fan-out benchmark
+const size_t BENCH_WS_CLIENTS[] = {1, 4, 16};
+
+// ============================================
+// Benchmarks
+// ============================================
+
+/**
+ * ADC -> voltage -> Rs -> PPM over the full ADC range
+ */
+void benchGasConversion() {
+  int adc = 0;
+  benchRun("adc_to_ppm", BENCH_ITERATIONS_FAST, [&adc]() {
+    adc = (adc + 7) & 0x0FFF;
+    float ppm = MQ2::ppm(calculateRs(adc) / 10.0f);
+    benchKeep(ppm);
+  });
+
+  // Convert a full scan of every configured channel
+  initGasSensor();
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    gasChannels[ch].calibrated = true;
+  }
+  uint16_t raw[GAS_CHANNEL_COUNT];
+  benchRun("gas_process_scan", BENCH_ITERATIONS_FAST, [&raw, &adc]() {
+    adc = (adc + 7) & 0x0FFF;
+    for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+      raw[ch] = adc;
+    }
+    processGasScan(raw);
+    benchKeep(gasChannels[0].ppm);
+  });
+}
+
+/**
+ * JSON payloads built on every sensor tick, API call and sync
+ */
+void benchSerialization() {
+  uint16_t raw[GAS_CHANNEL_COUNT];
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    raw[ch] = 1234;
+  }
+  processGasScan(raw);
+
+  benchRun("gas_sensor_json", BENCH_ITERATIONS_JSON, []() {
+    String json = getGasSensorJSON();
+    benchKeep(json);
+  });
+  benchRun("gas_sensor_frame", BENCH_ITERATIONS_JSON, []() {
+    String json = getGasSensorFrame();
+    benchKeep(json);
+  });
+  benchRun("sync_payload", BENCH_ITERATIONS_JSON, []() {
+    String json = getGasSyncPayload();
+    benchKeep(json);
+  });
+
+#ifdef ARDUINO
+  benchRun("device_status", BENCH_ITERATIONS_JSON, []() {
+    String json = getDeviceStatus();
+    benchKeep(json);
+  });
+  benchRun("snapshot", BENCH_ITERATIONS_JSON, []() {
+    static char buffer[2048];
+    JsonDocument doc(&jsonWebPool);
+    buildSnapshot(doc);
+    benchKeep(serializeJson(doc, buffer, sizeof(buffer)));
+  });
+#endif
+}
+
+/**
+ * Basic Auth header check, accepted and rejected
+ */
+void benchAuth() {
+  String valid = "Basic " + base64::encode(String(AUTH_USERNAME) + ":" +
+                                           String(AUTH_PASSWORD));
+  String rejected = "Basic dXNlcjp3cm9uZy1wYXNzd29yZA==";
+
+  benchRun("auth_check_valid", BENCH_ITERATIONS_JSON, [&valid]() {
+    bool ok = checkBasicAuthHeader(valid);
+    benchKeep(ok);
+  });
+  benchRun("auth_check_rejected", BENCH_ITERATIONS_JSON, [&rejected]() {
+    bool ok = checkBasicAuthHeader(rejected);
+    benchKeep(ok);
+  });
+}
+
+/**
+ * Sensor frame broadcast to N in-memory WebSocket clients (host only)
+ */
+void benchBroadcast() {
+#ifndef ARDUINO
+  char name[32];
+  for (size_t i = 0; i < sizeof(BENCH_WS_CLIENTS) / sizeof(BENCH_WS_CLIENTS[0]);
+       i++) {
+    AsyncWebSocket fakeWs("/ws");
+    fakeWs.addFakeClients(BENCH_WS_CLIENTS[i]);
+    snprintf(name, sizeof(name), "ws_fanout_%u", (unsigned)BENCH_WS_CLIENTS[i]);
+
+    benchRun(name, BENCH_ITERATIONS_JSON, [&fakeWs]() {
+      fakeWs.textAll(getGasSensorFrame());
+      fakeWs.cleanupClients();
+    });
+  }
+#endif
+}
+
+/**
+ * Window aggregate update and quantile read-out
+ */
+void benchWindowStats() {
+  WindowStats stats = {};
+  windowStatsReset(stats, 0);
+  uint32_t t = 0;
+  benchRun("window_stats_add", BENCH_ITERATIONS_FAST, [&stats, &t]() {
+    t += 100;
+    windowStatsAdd(stats, (float)((t * 2654435761u) >> 20), t, 500.0f);
+  });
+  benchRun("window_stats_p99", BENCH_ITERATIONS_JSON, [&stats]() {
+    benchKeep(windowStatsQuantile(stats, 0.99f));
+  });
+}
+
+/**
+ * Rate-of-rise + CUSUM detector update per sample
+ */
+void benchAnomaly() {
+  AnomalyDetector det;
+  anomalyReset(det);
+  AnomalyParams params = anomalyDefaultParams();
+  uint32_t t = 0;
+  benchRun("anomaly_update", BENCH_ITERATIONS_FAST, [&det, &params, &t]() {
+    t += 1000;
+    float ppm = 50.0f + (float)((t * 2654435761u) >> 28);
+    benchKeep(anomalyUpdate(det, params, ppm, t));
+  });
+}
+
+/**
+ * Full rule table against one sample of every channel
+ */
+void benchRules() {
+  static RuleSet set;
+  RuleError error;
+  String source;
+  for (int i = 0; i < RULES_MAX; i++) {
+    source += "ch0.ppm > " + String(100 + i * 50) + " for 10s -> ws,log\n";
+  }
+  rulesCompile(source.c_str(), set, error);
+
+  RuleSample samples[GAS_CHANNEL_COUNT] = {};
+  uint32_t t = 0;
+  benchRun("rules_evaluate_16", BENCH_ITERATIONS_FAST, [&samples, &t]() {
+    t += 100;
+    samples[0].field[RULE_FIELD_PPM] = (float)((t * 2654435761u) >> 22);
+    rulesEvaluate(set, samples, GAS_CHANNEL_COUNT, t, NULL);
+  });
+}
+
+/**
+ * Pool block vs malloc() for a typical copied JSON string
+ */
+void benchMemPools() {
+  benchRun("pool_alloc_free", BENCH_ITERATIONS_FAST, []() {
+    void *ptr = jsonTickPool.allocate(48);
+    benchKeep(ptr);
+    jsonTickPool.deallocate(ptr);
+  });
+  benchRun("heap_alloc_free", BENCH_ITERATIONS_FAST, []() {
+    void *ptr = malloc(48);
+    benchKeep(ptr);
+    free(ptr);
+  });
+}
+
+/**
+ * Latest-frame exchange: what a frame consumer and the capture task pay
+ * per frame on top of the copy
+ */
+void benchTripleBuffer() {
+  static TripleBuffer tb;
+  tripleBufferInit(tb);
+  uint32_t t = 0;
+  benchRun("frame_publish", BENCH_ITERATIONS_FAST, [&t]() {
+    FrameSlot *slot = tripleBufferClaim(tb);
+    tripleBufferPublish(tb, slot, 1024, ++t);
+  });
+
+  FrameConsumer consumer = {"bench", 0, 0, 0, 0, 0, 0};
+  benchRun("frame_acquire_release", BENCH_ITERATIONS_FAST, [&consumer, &t]() {
+    FrameSlot *slot = tripleBufferAcquire(tb);
+    frameConsumerNote(consumer, slot, ++t);
+    tripleBufferRelease(slot);
+  });
+}
+
+/**
+ * Overhead of one TRACE_SCOPE() begin/end pair
+ */
+void benchTrace() {
+#if TRACE_ENABLED
+  benchRun("trace_scope", BENCH_ITERATIONS_FAST, []() {
+    TRACE_SCOPE("bench");
+  });
+  traceReset();
+#endif
+}
+
+void runBenchmarks() {
+  loadDeviceConfig();
+  benchGasConversion();
+  benchSerialization();
+  benchAuth();
+  benchBroadcast();
+  benchWindowStats();
+  benchAnomaly();
+  benchRules();
+  benchMemPools();
+  benchTripleBuffer();
+  benchTrace();
+}
+
+// ============================================
+// Entry Points
+// ============================================
+
+#ifdef ARDUINO
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+  runBenchmarks();
+  Serial.println("{\"bench\":\"done\"}");
+}
+
+void loop() { delay(1000); }
+#else
+int main() {
+  runBenchmarks();
+  return 0;
+}
+#endif
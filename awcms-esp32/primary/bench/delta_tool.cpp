@@ -0,0 +1,242 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Delta Patch Tool (host)
+ *
+ * pio run -e native_delta
+ * .pio/build/native_delta/program <command> [args]
+ *
+ * Runs the same delta_patch.h engine the device uses for OTA:
+ *
+ *   synth <old.bin> <new.bin> [size] [seed]  write an image pair with
+ *                                            inserts, edits and a moved tail
+ *   apply <old.bin> <patch> <out.bin> [max]  rebuild the target, feeding the
+ *                                            patch in random 1..max byte
+ *                                            chunks (default 1460, one TCP
+ *                                            segment); exit 1 on any error
+ *   info <patch>                             print the header
+ *
+ * Make patches with scripts/make_delta.py. Signatures are only checked on
+ * the device (ota.h); apply checks sizes and both image hashes.
+ */
+
+#include "delta_patch.h"
+#include "sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Tool Types
+// ============================================
+
+struct ApplyContext {
+  FILE *source;
+  FILE *target;
+  uint32_t sourceSize;
+  uint8_t sourceSha[SHA256_SIZE];
+  uint32_t reads;
+};
+
+// ============================================
+// Tool Functions
+// ============================================
+
+uint32_t nextRandom(uint32_t &x) {
+  x = x * 1103515245u + 12345u;
+  return x >> 8;
+}
+
+bool readFileSha(FILE *file, uint32_t &size, uint8_t digest[SHA256_SIZE]) {
+  static uint8_t buf[4096];
+  Sha256 sha;
+  sha256Init(sha);
+  size = 0;
+  fseek(file, 0, SEEK_SET);
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    sha256Update(sha, buf, n);
+    size += n;
+  }
+  sha256Final(sha, digest);
+  return !ferror(file);
+}
+
+bool readSource(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+  ApplyContext *apply = (ApplyContext *)ctx;
+  apply->reads++;
+  return fseek(apply->source, offset, SEEK_SET) == 0 &&
+         fread(buf, 1, len, apply->source) == len;
+}
+
+bool writeTarget(void *ctx, const uint8_t *buf, size_t len) {
+  return fwrite(buf, 1, len, ((ApplyContext *)ctx)->target) == len;
+}
+
+/**
+ * The checks ota.h makes before writing, minus the signature
+ */
+const char *checkHeader(void *ctx, const DeltaPatch &patch) {
+  ApplyContext *apply = (ApplyContext *)ctx;
+  if (patch.header.sourceSize != apply->sourceSize ||
+      memcmp(patch.header.sourceSha, apply->sourceSha, SHA256_SIZE) != 0) {
+    return "patch is for a different source image";
+  }
+  return NULL;
+}
+
+/**
+ * Image-like filler: runs of "code" words with repeated constants
+ */
+void synthImage(uint8_t *buf, size_t len, uint32_t seed) {
+  uint32_t x = seed;
+  for (size_t i = 0; i < len; i += 4) {
+    uint32_t word = nextRandom(x) % 8 == 0 ? 0x400d0000u + (nextRandom(x) & 0xFFFF)
+                                           : nextRandom(x);
+    memcpy(buf + i, &word, len - i < 4 ? len - i : 4);
+  }
+}
+
+bool writeFile(const char *path, const uint8_t *buf, size_t len) {
+  FILE *file = fopen(path, "wb");
+  bool ok = file && fwrite(buf, 1, len, file) == len;
+  if (file) {
+    fclose(file);
+  }
+  return ok;
+}
+
+/**
+ * New image = old with a few inserted and edited regions, so the tail
+ * moves the way it does when code grows
+ */
+int synthCommand(const char *oldPath, const char *newPath, size_t size,
+                 uint32_t seed) {
+  uint8_t *before = (uint8_t *)malloc(size);
+  uint8_t *after = (uint8_t *)malloc(size + 64 * 1024);
+  synthImage(before, size, seed);
+
+  uint32_t x = seed ^ 0x5bd1e995u;
+  size_t in = 0, out = 0;
+  while (in < size) {
+    size_t keep = 4096 + nextRandom(x) % 65536;
+    keep = keep < size - in ? keep : size - in;
+    memcpy(after + out, before + in, keep);
+    in += keep;
+    out += keep;
+
+    switch (nextRandom(x) % 3) {
+    case 0: { // Inserted code
+      size_t len = 16 + nextRandom(x) % 512;
+      synthImage(after + out, len, nextRandom(x));
+      out += len;
+      break;
+    }
+    case 1: { // Edited in place
+      size_t len = 4 + nextRandom(x) % 64;
+      len = len < size - in ? len : size - in;
+      synthImage(after + out, len, nextRandom(x));
+      in += len;
+      out += len;
+      break;
+    }
+    default: // Removed
+      in += nextRandom(x) % 256;
+      in = in < size ? in : size;
+      break;
+    }
+    if (out > size + 60 * 1024) {
+      break;
+    }
+  }
+
+  bool ok = writeFile(oldPath, before, size) && writeFile(newPath, after, out);
+  printf("{\"old_bytes\":%u,\"new_bytes\":%u}\n", (unsigned)size,
+         (unsigned)out);
+  free(before);
+  free(after);
+  return ok ? 0 : 1;
+}
+
+int applyCommand(const char *sourcePath, const char *patchPath,
+                 const char *outPath, size_t maxChunk) {
+  ApplyContext apply = {};
+  apply.source = fopen(sourcePath, "rb");
+  FILE *patchFile = fopen(patchPath, "rb");
+  apply.target = fopen(outPath, "wb");
+  if (!apply.source || !patchFile || !apply.target ||
+      !readFileSha(apply.source, apply.sourceSize, apply.sourceSha)) {
+    fprintf(stderr, "Cannot open the source, patch or output file\n");
+    return 1;
+  }
+
+  static DeltaPatch patch;
+  deltaBegin(patch, readSource, writeTarget, checkHeader, &apply);
+
+  static uint8_t chunk[65536];
+  maxChunk = maxChunk < sizeof(chunk) ? maxChunk : sizeof(chunk);
+  uint32_t x = 1;
+  uint32_t feeds = 0;
+  size_t n;
+  while ((n = fread(chunk, 1, 1 + nextRandom(x) % maxChunk, patchFile)) > 0) {
+    feeds++;
+    if (!deltaFeed(patch, chunk, n)) {
+      break;
+    }
+  }
+  fclose(patchFile);
+  fclose(apply.source);
+  fclose(apply.target);
+
+  bool ok = deltaFinished(patch);
+  printf("{\"ok\":%s,\"error\":\"%s\",\"patch_bytes\":%u,\"target_bytes\":%u,"
+         "\"ratio\":%.3f,\"feeds\":%u,\"source_reads\":%u,\"ram_bytes\":%u}\n",
+         ok ? "true" : "false",
+         ok ? "" : (patch.error ? patch.error : "patch truncated"),
+         (unsigned)patch.received, (unsigned)patch.written,
+         patch.written ? (double)patch.received / patch.written : 0.0,
+         (unsigned)feeds, (unsigned)apply.reads, (unsigned)sizeof(DeltaPatch));
+  return ok ? 0 : 1;
+}
+
+int infoCommand(const char *patchPath) {
+  FILE *file = fopen(patchPath, "rb");
+  uint8_t raw[DELTA_HEADER_SIZE + 2];
+  if (!file || fread(raw, 1, sizeof(raw), file) != sizeof(raw)) {
+    fprintf(stderr, "Cannot read %s\n", patchPath);
+    return 1;
+  }
+  fclose(file);
+
+  DeltaHeader header;
+  memcpy(&header, raw, sizeof(header));
+  char sourceHex[2 * SHA256_SIZE + 1], targetHex[2 * SHA256_SIZE + 1];
+  sha256Hex(header.sourceSha, sourceHex);
+  sha256Hex(header.targetSha, targetHex);
+  printf("{\"magic_ok\":%s,\"version\":%u,\"source_bytes\":%u,"
+         "\"target_bytes\":%u,\"source_sha256\":\"%s\","
+         "\"target_sha256\":\"%s\",\"signature_bytes\":%u}\n",
+         header.magic == DELTA_MAGIC ? "true" : "false",
+         (unsigned)header.version, (unsigned)header.sourceSize,
+         (unsigned)header.targetSize, sourceHex, targetHex,
+         (unsigned)(raw[DELTA_HEADER_SIZE] | raw[DELTA_HEADER_SIZE + 1] << 8));
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *command = argc > 1 ? argv[1] : "";
+
+  if (strcmp(command, "synth") == 0 && argc >= 4) {
+    return synthCommand(argv[2], argv[3],
+                        argc > 4 ? atol(argv[4]) : 1024 * 1024,
+                        argc > 5 ? atol(argv[5]) : 1);
+  }
+  if (strcmp(command, "apply") == 0 && argc >= 5) {
+    return applyCommand(argv[2], argv[3], argv[4],
+                        argc > 5 ? atol(argv[5]) : 1460);
+  }
+  if (strcmp(command, "info") == 0 && argc >= 3) {
+    return infoCommand(argv[2]);
+  }
+  fprintf(stderr, "Usage: %s synth|apply|info ...\n", argv[0]);
+  return 2;
+}
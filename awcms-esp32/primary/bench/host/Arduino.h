@@ -0,0 +1,223 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Host HAL Stand-In: Arduino core
+ *
+ * Just enough of the Arduino API for the host benchmark build
+ * (env:native_bench). ARDUINO is deliberately left undefined.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <chrono>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define LOW 0x0
+#define HIGH 0x1
+
+// ============================================
+// String
+// ============================================
+
+class String {
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const std::string &s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(float v, unsigned decimals = 2) { setFloat(v, decimals); }
+  String(double v, unsigned decimals = 2) { setFloat(v, decimals); }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned length() const { return _s.length(); }
+  bool reserve(unsigned size) {
+    _s.reserve(size);
+    return true;
+  }
+  bool concat(const char *s) {
+    _s.append(s);
+    return true;
+  }
+  bool concat(const char *s, unsigned n) {
+    _s.append(s, n);
+    return true;
+  }
+  bool concat(char c) {
+    _s.push_back(c);
+    return true;
+  }
+  bool concat(const String &s) { return concat(s.c_str()); }
+  bool startsWith(const String &prefix) const {
+    return _s.compare(0, prefix._s.length(), prefix._s) == 0;
+  }
+  bool equals(const String &other) const { return _s == other._s; }
+  String substring(unsigned from) const { return String(_s.substr(from)); }
+  String substring(unsigned from, unsigned to) const {
+    return String(_s.substr(from, to - from));
+  }
+  int indexOf(char c) const {
+    size_t pos = _s.find(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return atof(_s.c_str()); }
+  char operator[](unsigned i) const { return _s[i]; }
+
+  String &operator+=(const String &s) {
+    concat(s);
+    return *this;
+  }
+  String &operator+=(const char *s) {
+    concat(s);
+    return *this;
+  }
+  String &operator+=(char c) {
+    concat(c);
+    return *this;
+  }
+  bool operator==(const String &other) const { return _s == other._s; }
+  bool operator!=(const String &other) const { return _s != other._s; }
+
+private:
+  void setFloat(double v, unsigned decimals) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    _s = buf;
+  }
+
+  std::string _s;
+};
+
+inline String operator+(const String &a, const String &b) {
+  String out(a);
+  out += b;
+  return out;
+}
+inline String operator+(const String &a, const char *b) {
+  String out(a);
+  out += b;
+  return out;
+}
+inline String operator+(const char *a, const String &b) {
+  String out(a);
+  out += b;
+  return out;
+}
+
+// BSD string copy from the ESP32 newlib, missing from older glibc
+inline size_t hostStrlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#define strlcpy hostStrlcpy
+
+// ============================================
+// Serial
+// ============================================
+
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  size_t print(const String &s) { return fputs(s.c_str(), stdout); }
+  size_t print(const char *s) { return fputs(s, stdout); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(double v) { return printf("%.2f", v); }
+  size_t println() { return puts(""); }
+  template <typename T> size_t println(const T &v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  size_t printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n < 0 ? 0 : n;
+  }
+};
+
+HostSerial Serial;
+
+// ============================================
+// Time, GPIO and ADC
+// ============================================
+
+// Virtual clock for trace replays: while enabled, time only moves through
+// hostAdvanceClock() and delay(), so hours of data run in seconds
+bool hostVirtualClock = false;
+uint64_t hostVirtualUs = 0;
+
+inline void hostAdvanceClock(uint64_t us) { hostVirtualUs += us; }
+
+inline unsigned long micros() {
+  if (hostVirtualClock) {
+    return (unsigned long)hostVirtualUs;
+  }
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count());
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void delay(unsigned long ms) {
+  if (hostVirtualClock) {
+    hostAdvanceClock((uint64_t)ms * 1000);
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void yield() {}
+
+// Simulated ADC input, set by the benchmark driver
+int hostAnalogValue[40] = {0};
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int analogRead(uint8_t pin) { return hostAnalogValue[pin % 40]; }
+
+// ============================================
+// FreeRTOS
+// ============================================
+
+// Critical sections are no-ops, host runs are single-threaded
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+
+// ============================================
+// ESP
+// ============================================
+
+class HostEsp {
+public:
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  uint32_t getHeapSize() { return 320 * 1024; }
+  uint32_t getMinFreeHeap() { return 180 * 1024; }
+  uint32_t getMaxAllocHeap() { return 110 * 1024; }
+  void restart() { exit(0); }
+};
+
+HostEsp ESP;
+
+inline bool psramFound() { return false; }
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,74 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Host HAL Stand-In: ESPAsyncWebServer
+ *
+ * Request headers for the auth checks and a WebSocket whose clients are
+ * in-memory queues, so broadcast fan-out can be measured without sockets.
+ */
+
+#ifndef HOST_ESPASYNCWEBSERVER_H
+#define HOST_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+class AsyncWebServerResponse {
+public:
+  int code;
+  void addHeader(const String &, const String &) {}
+};
+
+class AsyncWebServerRequest {
+public:
+  std::map<std::string, String> headers;
+  int sentCode = 0;
+
+  bool hasHeader(const char *name) const { return headers.count(name) > 0; }
+  String header(const char *name) const {
+    std::map<std::string, String>::const_iterator it = headers.find(name);
+    return it == headers.end() ? String() : it->second;
+  }
+  AsyncWebServerResponse *beginResponse(int code, const String &,
+                                        const String &) {
+    _response.code = code;
+    return &_response;
+  }
+  void send(AsyncWebServerResponse *response) { sentCode = response->code; }
+  void send(int code, const String & = String(), const String & = String()) {
+    sentCode = code;
+  }
+
+private:
+  AsyncWebServerResponse _response;
+};
+
+class AsyncWebSocketClient {
+public:
+  std::vector<String> queue;
+  void text(const String &message) { queue.push_back(message); }
+};
+
+class AsyncWebSocket {
+public:
+  explicit AsyncWebSocket(const String &) {}
+
+  void addFakeClients(size_t n) { _clients.resize(_clients.size() + n); }
+  size_t count() const { return _clients.size(); }
+  void textAll(const String &message) {
+    for (size_t i = 0; i < _clients.size(); i++) {
+      _clients[i].text(message);
+    }
+  }
+  // Drop delivered messages, as the TCP stack would after sending
+  void cleanupClients() {
+    for (size_t i = 0; i < _clients.size(); i++) {
+      _clients[i].queue.clear();
+    }
+  }
+
+private:
+  std::vector<AsyncWebSocketClient> _clients;
+};
+
+#endif // HOST_ESPASYNCWEBSERVER_H
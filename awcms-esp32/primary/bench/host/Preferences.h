@@ -0,0 +1,60 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Host HAL Stand-In: Preferences (NVS)
+ *
+ * In-memory key/value store, contents are lost when the process exits.
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+std::map<std::string, std::vector<uint8_t>> hostNvs;
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false) {
+    _prefix = std::string(name) + "/";
+    return true;
+  }
+  void end() {}
+
+  size_t putBytes(const char *key, const void *value, size_t len) {
+    const uint8_t *bytes = (const uint8_t *)value;
+    hostNvs[_prefix + key].assign(bytes, bytes + len);
+    return len;
+  }
+  size_t getBytesLength(const char *key) {
+    std::map<std::string, std::vector<uint8_t>>::iterator it =
+        hostNvs.find(_prefix + key);
+    return it == hostNvs.end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char *key, void *buf, size_t maxLen) {
+    size_t len = getBytesLength(key);
+    if (len == 0 || len > maxLen) {
+      return 0;
+    }
+    memcpy(buf, hostNvs[_prefix + key].data(), len);
+    return len;
+  }
+
+  size_t putString(const char *key, const char *value) {
+    return putBytes(key, value, strlen(value));
+  }
+  String getString(const char *key, const String &defaultValue = String()) {
+    std::map<std::string, std::vector<uint8_t>>::iterator it =
+        hostNvs.find(_prefix + key);
+    if (it == hostNvs.end()) {
+      return defaultValue;
+    }
+    return String(std::string(it->second.begin(), it->second.end()));
+  }
+
+private:
+  std::string _prefix;
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,60 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Host HAL Stand-In: base64
+ */
+
+#ifndef HOST_BASE64_H
+#define HOST_BASE64_H
+
+#include <Arduino.h>
+
+class base64 {
+public:
+  static String encode(const String &input) {
+    static const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    String output;
+    uint32_t buffer = 0;
+    int bits = 0;
+
+    for (unsigned i = 0; i < input.length(); i++) {
+      buffer = (buffer << 8) | (uint8_t)input[i];
+      bits += 8;
+      while (bits >= 6) {
+        bits -= 6;
+        output += alphabet[(buffer >> bits) & 0x3F];
+      }
+    }
+    if (bits > 0) {
+      output += alphabet[(buffer << (6 - bits)) & 0x3F];
+    }
+    while (output.length() % 4 != 0) {
+      output += '=';
+    }
+    return output;
+  }
+
+  static String decode(const String &input) {
+    static const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    String output;
+    uint32_t buffer = 0;
+    int bits = 0;
+
+    for (unsigned i = 0; i < input.length(); i++) {
+      const char *pos = strchr(alphabet, input[i]);
+      if (input[i] == '=' || pos == NULL) {
+        break;
+      }
+      buffer = (buffer << 6) | (uint32_t)(pos - alphabet);
+      bits += 6;
+      if (bits >= 8) {
+        bits -= 8;
+        output += (char)((buffer >> bits) & 0xFF);
+      }
+    }
+    return output;
+  }
+};
+
+#endif // HOST_BASE64_H
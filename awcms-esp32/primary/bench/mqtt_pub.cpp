@@ -0,0 +1,215 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * MQTT Publisher (host)
+ *
+ * pio run -e native_mqtt
+ * .pio/build/native_mqtt/program <host> [port] [count] [qos] [tenant] [device]
+ *
+ * Publishes count sensor_readings-sized rows through the same mqtt_codec.h
+ * framing the device uses, one in flight at a time like the outbox, and
+ * prints a JSON summary: framing bytes per message next to the body size,
+ * and PUBACK latency at QoS 1. Point it at a local broker and watch with
+ *   mosquitto_sub -v -t 'awcms/#'
+ * Exits 1 if the broker refuses the session or a PUBACK goes missing.
+ */
+
+#include "mqtt_codec.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================
+// Tool Configuration
+// ============================================
+
+#define PUB_TIMEOUT_MS 5000
+
+// ============================================
+// Tool Functions
+// ============================================
+
+double nowMs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int openSocket(const char *host, const char *port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = NULL;
+  if (getaddrinfo(host, port, &hints, &result) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo *ai = result; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(result);
+  if (fd >= 0) {
+    // Header and body are separate writes, do not let Nagle hold the body
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+bool sendAll(int fd, const uint8_t *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, buf, len, 0);
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+/**
+ * Read until a packet of the wanted type completes, false on timeout
+ */
+bool waitFor(int fd, MqttReader &reader, uint8_t type) {
+  double deadline = nowMs() + PUB_TIMEOUT_MS;
+  while (nowMs() < deadline) {
+    pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, (int)(deadline - nowMs()) + 1) <= 0) {
+      continue;
+    }
+    uint8_t buf[64];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      return false;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+      if (mqttReaderPush(reader, buf[i]) && (reader.type & 0xF0) == type) {
+        // One-in-flight means nothing useful can follow in this read
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * A body shaped like getGasSyncPayload() for one channel
+ */
+int makeBody(char *out, size_t len, const char *tenant, const char *device,
+             int i) {
+  return snprintf(out, len,
+                  "{\"tenant_id\":\"%s\",\"device_id\":\"%s\","
+                  "\"sensor_type\":\"gas\",\"gas_ppm\":%.1f,\"gas_min\":%.1f,"
+                  "\"gas_max\":%.1f,\"samples\":6,\"gas_level\":\"normal\"}",
+                  tenant, device, 120.0 + i % 17, 110.0 + i % 13,
+                  130.0 + i % 19);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <host> [port] [count] [qos] [tenant] [device]\n",
+            argv[0]);
+    return 2;
+  }
+  const char *host = argv[1];
+  const char *port = argc > 2 ? argv[2] : "1883";
+  int count = argc > 3 ? atoi(argv[3]) : 100;
+  uint8_t qos = argc > 4 ? atoi(argv[4]) : 1;
+  const char *tenant = argc > 5 ? argv[5] : "bench-tenant";
+  const char *device = argc > 6 ? argv[6] : "bench-001";
+
+  int fd = openSocket(host, port);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot connect to %s:%s\n", host, port);
+    return 1;
+  }
+
+  char topic[128], status[128];
+  snprintf(topic, sizeof(topic), "awcms/%s/%s/sensor_readings", tenant,
+           device);
+  snprintf(status, sizeof(status), "awcms/%s/%s/status", tenant, device);
+
+  static uint8_t buf[512];
+  MqttConnectOptions options = {};
+  options.clientId = device;
+  options.keepAliveSec = 60;
+  options.willTopic = status;
+  options.willMessage = "offline";
+  options.willRetain = true;
+  options.cleanSession = true;
+
+  MqttReader reader;
+  mqttReaderReset(reader);
+  double start = nowMs();
+  size_t len = mqttEncodeConnect(buf, sizeof(buf), options);
+  if (!sendAll(fd, buf, len) || !waitFor(fd, reader, MQTT_CONNACK) ||
+      mqttConnackCode(reader) != 0) {
+    fprintf(stderr, "Broker refused the session (code %d)\n",
+            mqttConnackCode(reader));
+    return 1;
+  }
+  double connectMs = nowMs() - start;
+
+  size_t framing = 0, body = 0;
+  double ackTotal = 0, ackMax = 0;
+  int published = 0, acked = 0;
+  char text[256];
+  start = nowMs();
+  for (int i = 0; i < count; i++) {
+    int bodyLen = makeBody(text, sizeof(text), tenant, device, i);
+    uint16_t packetId = (uint16_t)(i % 0xFFFF + 1);
+    size_t n = mqttEncodePublishHeader(buf, sizeof(buf), topic, bodyLen, qos,
+                                       false, false, packetId);
+    double sentAt = nowMs();
+    if (!sendAll(fd, buf, n) || !sendAll(fd, (uint8_t *)text, bodyLen)) {
+      fprintf(stderr, "Send failed at message %d\n", i);
+      break;
+    }
+    framing += n;
+    body += bodyLen;
+    published++;
+    if (qos == 0) {
+      continue;
+    }
+    if (!waitFor(fd, reader, MQTT_PUBACK) ||
+        mqttPubackId(reader) != packetId) {
+      fprintf(stderr, "No PUBACK for message %d\n", i);
+      break;
+    }
+    double ack = nowMs() - sentAt;
+    ackTotal += ack;
+    ackMax = ack > ackMax ? ack : ackMax;
+    acked++;
+  }
+  double elapsed = nowMs() - start;
+
+  len = mqttEncodeEmpty(buf, MQTT_DISCONNECT);
+  sendAll(fd, buf, len);
+  close(fd);
+
+  printf("{\"messages\":%d,\"qos\":%u,\"connect_ms\":%.2f,"
+         "\"framing_bytes_avg\":%.1f,\"body_bytes_avg\":%.1f,"
+         "\"acked\":%d,\"ack_ms_avg\":%.3f,\"ack_ms_max\":%.3f,"
+         "\"msgs_per_s\":%.1f}\n",
+         published, (unsigned)qos, connectMs,
+         published ? (double)framing / published : 0.0,
+         published ? (double)body / published : 0.0, acked,
+         acked ? ackTotal / acked : 0.0, ackMax,
+         elapsed > 0 ? published * 1000.0 / elapsed : 0.0);
+  return published == count && (qos == 0 || acked == count) ? 0 : 1;
+}
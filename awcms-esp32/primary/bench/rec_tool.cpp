@@ -0,0 +1,231 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Recording Tool (host)
+ *
+ * pio run -e native_rec
+ * .pio/build/native_rec/program <root> <command> [args]
+ *
+ * Works on a copy of the SD card (or any directory holding /rec) with the
+ * same rec_format.h code the recorder runs:
+ *
+ *   synth <frames> <interval_ms> [seed]  write a segment of fake JPEGs
+ *   list                                 one JSON line per segment
+ *   seek <segment> <t_ms>                frame shown at t_ms
+ *   extract <segment> <t_ms> <out.jpg>   copy that frame out
+ *   verify                               check every index entry against
+ *                                        its data file (exit 1 on errors)
+ */
+
+#include "rec_format.h"
+#include "store_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Tool Functions
+// ============================================
+
+/**
+ * Fake JPEG: SOI, filler bytes derived from the frame number, EOI
+ */
+size_t synthFrame(uint8_t *buf, uint32_t frame, uint32_t seed) {
+  uint32_t x = (frame + 1) * 2654435761u ^ seed;
+  size_t len = 2000 + x % 30000;
+  buf[0] = 0xFF;
+  buf[1] = 0xD8;
+  for (size_t i = 2; i < len - 2; i++) {
+    x = x * 1103515245u + 12345u;
+    buf[i] = (uint8_t)(x >> 16);
+  }
+  buf[len - 2] = 0xFF;
+  buf[len - 1] = 0xD9;
+  return len;
+}
+
+/**
+ * Newest segment number on disk, 0 if there is none
+ */
+uint32_t lastSegment(StoreFS &fs) {
+  uint32_t last = 0;
+  fs.list(REC_DIR, [&last](const char *name, uint32_t) {
+    uint32_t segment = recSegmentFromName(name);
+    if (segment > last) {
+      last = segment;
+    }
+  });
+  return last;
+}
+
+int synthCommand(StoreFS &fs, uint32_t frames, uint32_t intervalMs,
+                 uint32_t seed) {
+  static uint8_t block[REC_BLOCK_SIZE];
+  static uint8_t jpeg[32768];
+  RecSegmentWriter w;
+  uint32_t segment = lastSegment(fs) + 1;
+
+  if (!recOpenSegment(w, fs, segment, 0, 0, block)) {
+    fprintf(stderr, "Cannot create segment %u\n", (unsigned)segment);
+    return 1;
+  }
+  for (uint32_t i = 0; i < frames; i++) {
+    size_t len = synthFrame(jpeg, i, seed);
+    if (!recAppendFrame(w, jpeg, len, i * intervalMs)) {
+      fprintf(stderr, "Write failed at frame %u\n", (unsigned)i);
+      recCloseSegment(w);
+      return 1;
+    }
+  }
+  recCloseSegment(w);
+  printf("{\"segment\":%u,\"frames\":%u,\"bytes\":%u}\n", (unsigned)segment,
+         (unsigned)frames, (unsigned)w.dataBytes);
+  return 0;
+}
+
+int listCommand(StoreFS &fs) {
+  uint32_t last = lastSegment(fs);
+  char path[STORE_PATH_MAX];
+  for (uint32_t segment = 1; segment <= last; segment++) {
+    recSegmentPath(segment, "idx", path, sizeof(path));
+    StoreFile index = fs.open(path, "r");
+    if (!index.isOpen()) {
+      continue;
+    }
+    RecIndexHeader header;
+    RecIndexEntry entry = {0, 0, 0, 0};
+    long count = recIndexCount(index, header);
+    if (count > 0) {
+      recIndexRead(index, count - 1, entry);
+    }
+    index.close();
+    printf("{\"segment\":%u,\"frames\":%ld,\"duration_ms\":%u,\"bytes\":%u}\n",
+           (unsigned)segment, count, (unsigned)entry.tMs,
+           (unsigned)(entry.offset + entry.length));
+  }
+  return 0;
+}
+
+/**
+ * Look up the frame at tMs, optionally copying it to out
+ */
+int seekCommand(StoreFS &fs, uint32_t segment, uint32_t tMs, const char *out) {
+  char path[STORE_PATH_MAX];
+  recSegmentPath(segment, "idx", path, sizeof(path));
+  StoreFile index = fs.open(path, "r");
+  if (!index.isOpen()) {
+    fprintf(stderr, "No segment %u\n", (unsigned)segment);
+    return 1;
+  }
+  RecIndexHeader header;
+  RecIndexEntry entry;
+  long found = recIndexSeek(index, recIndexCount(index, header), tMs, entry);
+  index.close();
+  if (found < 0) {
+    fprintf(stderr, "No frames in segment %u\n", (unsigned)segment);
+    return 1;
+  }
+  printf("{\"frame\":%ld,\"t_ms\":%u,\"offset\":%u,\"length\":%u}\n", found,
+         (unsigned)entry.tMs, (unsigned)entry.offset, (unsigned)entry.length);
+  if (!out) {
+    return 0;
+  }
+
+  recSegmentPath(segment, "mjpg", path, sizeof(path));
+  StoreFile data = fs.open(path, "r");
+  uint8_t *buf = (uint8_t *)malloc(entry.length);
+  bool ok = data.isOpen() && buf && data.seek(entry.offset) &&
+            data.read(buf, entry.length) == entry.length;
+  data.close();
+
+  FILE *file = ok ? fopen(out, "wb") : NULL;
+  ok = file && fwrite(buf, 1, entry.length, file) == entry.length;
+  if (file) {
+    fclose(file);
+  }
+  free(buf);
+  if (!ok) {
+    fprintf(stderr, "Cannot extract frame to %s\n", out);
+  }
+  return ok ? 0 : 1;
+}
+
+/**
+ * Every entry must be in time order, contiguous, inside the data file and
+ * start/end with the JPEG SOI/EOI markers
+ */
+int verifyCommand(StoreFS &fs) {
+  uint32_t last = lastSegment(fs);
+  uint32_t errors = 0;
+  char path[STORE_PATH_MAX];
+
+  for (uint32_t segment = 1; segment <= last; segment++) {
+    recSegmentPath(segment, "idx", path, sizeof(path));
+    StoreFile index = fs.open(path, "r");
+    if (!index.isOpen()) {
+      continue;
+    }
+    recSegmentPath(segment, "mjpg", path, sizeof(path));
+    StoreFile data = fs.open(path, "r");
+
+    RecIndexHeader header;
+    long count = recIndexCount(index, header);
+    uint32_t size = data.isOpen() ? data.size() : 0;
+    uint32_t expectOffset = 0;
+    uint32_t lastT = 0;
+    uint32_t bad = count < 0 || !data.isOpen() || header.segment != segment;
+
+    for (long i = 0; !bad && i < count; i++) {
+      RecIndexEntry entry;
+      uint8_t head[2], tail[2];
+      if (!recIndexRead(index, i, entry) || entry.offset != expectOffset ||
+          entry.tMs < lastT || entry.length < 4 ||
+          entry.offset + entry.length > size || !data.seek(entry.offset) ||
+          data.read(head, 2) != 2 ||
+          !data.seek(entry.offset + entry.length - 2) ||
+          data.read(tail, 2) != 2 || head[0] != 0xFF || head[1] != 0xD8 ||
+          tail[0] != 0xFF || tail[1] != 0xD9) {
+        fprintf(stderr, "Segment %u: bad entry %ld\n", (unsigned)segment, i);
+        bad++;
+        break;
+      }
+      expectOffset = entry.offset + entry.length;
+      lastT = entry.tMs;
+    }
+    index.close();
+    data.close();
+
+    printf("{\"segment\":%u,\"frames\":%ld,\"ok\":%s}\n", (unsigned)segment,
+           count, bad ? "false" : "true");
+    errors += bad;
+  }
+  return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <root> synth|list|seek|extract|verify ...\n",
+            argv[0]);
+    return 2;
+  }
+  StoreFS fs(argv[1]);
+  const char *command = argv[2];
+
+  if (strcmp(command, "synth") == 0 && argc >= 5) {
+    return synthCommand(fs, atol(argv[3]), atol(argv[4]),
+                        argc > 5 ? atol(argv[5]) : 1);
+  }
+  if (strcmp(command, "list") == 0) {
+    return listCommand(fs);
+  }
+  if (strcmp(command, "seek") == 0 && argc >= 5) {
+    return seekCommand(fs, atol(argv[3]), atol(argv[4]), NULL);
+  }
+  if (strcmp(command, "extract") == 0 && argc >= 6) {
+    return seekCommand(fs, atol(argv[3]), atol(argv[4]), argv[5]);
+  }
+  if (strcmp(command, "verify") == 0) {
+    return verifyCommand(fs);
+  }
+  fprintf(stderr, "Unknown command or missing arguments: %s\n", command);
+  return 2;
+}
@@ -0,0 +1,366 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * ADC Trace Replay Runner (host)
+ *
+ * pio run -e native_replay
+ * .pio/build/native_replay/program [options] trace.csv|trace.bin [...]
+ *
+ * Feeds recorded raw ADC traces (see include/adc_replay.h) through the
+ * firmware pipeline on a virtual clock: readGasSensor() -> WebSocket frame
+ * -> anomaly events -> local rules -> sync payloads, in the same order and
+ * at the same intervals as loop(). Prints one JSON line per trace with
+ * alarm latency and the WebSocket/upload volume the device would produce.
+ *
+ * Options: --onset <ms>     leak start within the trace (omit for clean air)
+ *          --rules <file>   local rules to load (rules.h syntax)
+ *          --ro <kOhm>      fixed Ro instead of calibrating on the trace start
+ *          --read <ms>      sensor read interval (default from config)
+ *          --sync <ms>      data sync interval (default from config)
+ *          --write-bin <f>  convert the next trace to the binary format
+ *          --trace <file>   record the next trace's run as Chrome trace JSON
+ *                           (host wall-clock stage times, see trace.h)
+ */
+
+// A whole replay fits on the host, not just the last 256 events
+#define TRACE_BUFFER_EVENTS 65536
+
+#include "adc_replay.h"
+#include "config.h"
+#include "device_config.h"
+#include "gas_sensor.h"
+#include "local_rules.h"
+#include "store_fs.h"
+#include "trace.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Replay Types
+// ============================================
+
+struct ReplayOptions {
+  long onsetMs; // -1 = clean air trace
+  float ro;     // 0 = calibrate
+  uint32_t readIntervalMs;
+  uint32_t syncIntervalMs;
+};
+
+struct ReplayResult {
+  uint32_t samples;
+  uint32_t durationMs;
+  uint32_t reads;
+  uint32_t wsFrames;
+  uint64_t wsBytes;
+  uint32_t uploads; // Sync payloads plus queued events
+  uint64_t uploadBytes;
+  uint32_t anomalies;
+  uint32_t ruleFires;
+  uint32_t falseAlarms; // Anomalies or rule fires before the onset
+  long alarmLatencyMs;  // -1 = no alarm after the onset
+  const char *firstAlarm;
+  double wallMs;
+};
+
+// ============================================
+// Replay Variables
+// ============================================
+AdcReplay replay;
+ReplayResult *current = NULL;
+long currentOnsetMs = -1;
+
+// ============================================
+// Replay Functions
+// ============================================
+
+/**
+ * gasScanSource: the trace sample held at the virtual time
+ */
+void replayGasScan(uint16_t *raw) {
+  replaySampleAt(replay, millis(), raw, GAS_CHANNEL_COUNT);
+}
+
+void countWS(const String &frame) {
+  current->wsFrames++;
+  current->wsBytes += frame.length();
+}
+
+void countUpload(const String &body) {
+  current->uploads++;
+  current->uploadBytes += body.length();
+}
+
+/**
+ * Record an alarm (anomaly or rule) against the onset
+ */
+void countAlarm(const char *kind) {
+  long now = (long)millis();
+  if (currentOnsetMs < 0 || now < currentOnsetMs) {
+    current->falseAlarms++;
+  } else if (current->alarmLatencyMs < 0) {
+    current->alarmLatencyMs = now - currentOnsetMs;
+    current->firstAlarm = kind;
+  }
+}
+
+/**
+ * Rule actions as in onRuleEvent(), counted instead of performed
+ */
+void onReplayRule(const RuleSet &set, uint8_t index, bool active) {
+  const Rule &rule = set.rules[index];
+  if (rule.actions & RULE_ACTION_WS) {
+    countWS(getRuleFrame(set, index, active));
+  }
+  if (!active) {
+    return;
+  }
+
+  current->ruleFires++;
+  countAlarm("rule");
+  if (rule.actions & RULE_ACTION_LOG) {
+    char text[RULES_SOURCE_MAX];
+    ruleText(set, index, text, sizeof(text));
+    countUpload(String("{\"event_type\":\"rule\",\"message\":\"") + text +
+                "\"}");
+  }
+  if (rule.actions & RULE_ACTION_SNAPSHOT) {
+    countUpload(getGasSyncPayload());
+  }
+}
+
+/**
+ * One sensor tick as in loop()
+ */
+void replayTick() {
+  {
+    TRACE_SCOPE("readGasSensor");
+    readGasSensor();
+  }
+  current->reads++;
+  {
+    TRACE_SCOPE("serializeJson");
+    countWS(getGasSensorFrame());
+  }
+
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    uint8_t flags = gasAnomalies[ch];
+    if (flags == ANOMALY_NONE) {
+      continue;
+    }
+    current->anomalies++;
+    countAlarm(anomalyName(flags));
+    countWS(getGasAnomalyFrame(ch, flags));
+
+    char message[128];
+    snprintf(message, sizeof(message),
+             "%s on %s: %.1f PPM, slope %.2f PPM/s, baseline %.1f PPM",
+             anomalyName(flags), gasChannels[ch].model, gasChannels[ch].ppm,
+             gasDetectors[ch].slope, gasDetectors[ch].mean);
+    countUpload(String("{\"event_type\":\"anomaly\",\"message\":\"") +
+                message + "\"}");
+  }
+
+  TRACE_SCOPE("rules.evaluate");
+  evaluateGasRules(onReplayRule);
+}
+
+/**
+ * Run one trace from a fresh pipeline state
+ */
+bool runTrace(const char *path, const ReplayOptions &options,
+              ReplayResult &result) {
+  StoreFS fs("");
+  if (!replayOpen(replay, fs, path)) {
+    fprintf(stderr, "Cannot read trace %s\n", path);
+    return false;
+  }
+
+  memset(&result, 0, sizeof(result));
+  result.alarmLatencyMs = -1;
+  result.firstAlarm = "none";
+  current = &result;
+  currentOnsetMs = options.onsetMs;
+
+  std::chrono::steady_clock::time_point wallStart =
+      std::chrono::steady_clock::now();
+  hostVirtualUs = 0;
+  initGasSensor();
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    gasChannels[ch].ro = options.ro;
+  }
+  if (options.ro <= 0) {
+    calibrateGasSensor(); // On the first samples, like a field calibration
+  } else {
+    for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+      gasChannels[ch].calibrated = true;
+    }
+    resetGasDetectors();
+  }
+
+  for (uint8_t i = 0; i < activeRules.count; i++) {
+    Rule &rule = activeRules.rules[i];
+    rule.matching = false;
+    rule.active = false;
+    rule.hits = 0;
+  }
+
+  // Jump straight to the next read or sync, nothing happens in between
+  uint32_t nextRead = millis();
+  uint32_t nextSync = nextRead + options.syncIntervalMs;
+  while (!replayFinished(replay, millis())) {
+    uint32_t now = nextRead < nextSync ? nextRead : nextSync;
+    hostVirtualUs = (uint64_t)now * 1000;
+
+    if (now == nextRead) {
+      replayTick();
+      nextRead += options.readIntervalMs;
+    }
+    if (now == nextSync) {
+      TRACE_SCOPE("serializeJson");
+      countUpload(getGasSyncPayload());
+      resetGasWindows();
+      nextSync += options.syncIntervalMs;
+    }
+  }
+
+  result.samples = replay.samples;
+  result.durationMs = millis();
+  result.wallMs = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - wallStart)
+                      .count();
+  replayClose(replay);
+  return true;
+}
+
+/**
+ * Write the events recorded since traceReset() to a Chrome trace file
+ */
+bool writeTraceFile(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return false;
+  }
+  if (traceOverwritten > 0) {
+    fprintf(stderr, "%s: oldest %u events dropped, raise TRACE_BUFFER_EVENTS\n",
+            path, (unsigned)traceOverwritten);
+  }
+  traceWriteFile(out);
+  fclose(out);
+  return true;
+}
+
+/**
+ * Convert a trace to the binary format
+ */
+bool convertTrace(const char *path, const char *out) {
+  StoreFS fs("");
+  if (!replayOpen(replay, fs, path)) {
+    fprintf(stderr, "Cannot read trace %s\n", path);
+    return false;
+  }
+
+  StoreFile file = fs.open(out, "w");
+  bool ok = file.isOpen() && replayWriteHeader(file, replay.channels);
+  while (ok) {
+    ok = replayWriteSample(file, replay.curMs, replay.cur, replay.channels);
+    if (!replay.hasNext) {
+      break;
+    }
+    replayAdvance(replay);
+  }
+  file.close();
+  replayClose(replay);
+  if (!ok) {
+    fprintf(stderr, "Cannot write %s\n", out);
+  }
+  return ok;
+}
+
+/**
+ * Load a rule file into the running rule set
+ */
+bool loadRuleFile(const char *path) {
+  static char source[RULES_SOURCE_MAX];
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  size_t n = fread(source, 1, sizeof(source) - 1, in);
+  source[n] = '\0';
+  fclose(in);
+
+  RuleError error;
+  if (!applyRules(source, error, false)) {
+    fprintf(stderr, "%s:%u: %s\n", path, (unsigned)error.position,
+            error.message);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  hostVirtualClock = true;
+  loadDeviceConfig();
+
+  ReplayOptions options = {-1, 0, deviceConfig.sensorReadInterval,
+                           deviceConfig.dataSyncInterval};
+  gasScanSource = replayGasScan;
+  const char *writeBin = NULL;
+  const char *tracePath = NULL;
+  int status = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (hasValue && strcmp(arg, "--onset") == 0) {
+      options.onsetMs = atol(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--ro") == 0) {
+      options.ro = atof(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--read") == 0) {
+      options.readIntervalMs = (uint32_t)atol(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--sync") == 0) {
+      options.syncIntervalMs = (uint32_t)atol(argv[++i]);
+    } else if (hasValue && strcmp(arg, "--rules") == 0) {
+      if (!loadRuleFile(argv[++i])) {
+        return 1;
+      }
+    } else if (hasValue && strcmp(arg, "--write-bin") == 0) {
+      writeBin = argv[++i];
+    } else if (hasValue && strcmp(arg, "--trace") == 0) {
+      tracePath = argv[++i];
+    } else if (writeBin) {
+      status |= convertTrace(arg, writeBin) ? 0 : 1;
+      writeBin = NULL;
+    } else {
+      ReplayResult result;
+      traceReset();
+      if (!runTrace(arg, options, result)) {
+        status = 1;
+        continue;
+      }
+      if (tracePath) {
+        status |= writeTraceFile(tracePath) ? 0 : 1;
+        tracePath = NULL;
+      }
+      printf("{\"trace\":\"%s\",\"samples\":%u,\"duration_ms\":%u,"
+             "\"reads\":%u,\"ws_frames\":%u,\"ws_bytes\":%llu,"
+             "\"uploads\":%u,\"upload_bytes\":%llu,\"anomalies\":%u,"
+             "\"rule_fires\":%u,\"false_alarms\":%u,\"alarm_latency_ms\":%ld,"
+             "\"first_alarm\":\"%s\",\"wall_ms\":%.1f,\"speedup\":%.0f}\n",
+             arg, (unsigned)result.samples, (unsigned)result.durationMs,
+             (unsigned)result.reads, (unsigned)result.wsFrames,
+             (unsigned long long)result.wsBytes, (unsigned)result.uploads,
+             (unsigned long long)result.uploadBytes,
+             (unsigned)result.anomalies, (unsigned)result.ruleFires,
+             (unsigned)result.falseAlarms, result.alarmLatencyMs,
+             result.firstAlarm, result.wallMs,
+             result.wallMs > 0 ? result.durationMs / result.wallMs : 0);
+    }
+  }
+
+  return status;
+}
@@ -8,6 +8,11 @@
 let ws = null;
 let reconnectInterval = null;
 let cameraRefreshInterval = null;
+let cameraAvailable = false;
+let snapshotLoaded = false;
+
+// Strings of the current language, from the device's /lang.json bundle
+let strings = {};
 
 // DOM Elements
 const elements = {
@@ -22,10 +27,66 @@ const elements = {
     gasStatus: document.getElementById('gasStatus'),
     gasCalibrated: document.getElementById('gasCalibrated'),
     gasDisplay: document.getElementById('gasDisplay'),
+    gasChannels: document.getElementById('gasChannels'),
     cameraFeed: document.getElementById('cameraFeed'),
-    lastUpdate: document.getElementById('lastUpdate')
+    lastUpdate: document.getElementById('lastUpdate'),
+    langSelect: document.getElementById('langSelect')
 };
 
+/**
+ * Translate a string key (catalog keys as in include/lang_en.h)
+ */
+function t(key) {
+    return strings[key] || key;
+}
+
+/**
+ * Set an element's text by key, kept so a language switch re-renders it
+ */
+function setText(element, key) {
+    element.dataset.i18n = key;
+    element.textContent = t(key);
+}
+
+/**
+ * Re-render every element that carries a string key
+ */
+function applyStrings() {
+    document.querySelectorAll('[data-i18n]').forEach((element) => {
+        if (strings[element.dataset.i18n]) {
+            element.textContent = strings[element.dataset.i18n];
+        }
+    });
+    document.querySelectorAll('[data-i18n-title]').forEach((element) => {
+        element.title = t(element.dataset.i18nTitle);
+    });
+}
+
+/**
+ * Load a language bundle; without a code the device picks from the
+ * browser's Accept-Language, then its own default
+ */
+async function loadLanguage(code) {
+    try {
+        const response = await fetch('/lang.json' + (code ? '?lang=' + code : ''));
+        const bundle = await response.json();
+        strings = bundle.strings;
+        document.documentElement.lang = bundle.lang;
+
+        const languages = Object.entries(bundle.languages);
+        elements.langSelect.replaceChildren(...languages.map(([lang, name]) => {
+            const option = document.createElement('option');
+            option.value = lang;
+            option.textContent = name;
+            option.selected = lang === bundle.lang;
+            return option;
+        }));
+        applyStrings();
+    } catch (error) {
+        console.error('Language error:', error);
+    }
+}
+
 /**
  * Initialize WebSocket connection
  */
@@ -45,6 +106,11 @@ function initWebSocket() {
         console.log('WebSocket disconnected');
         updateConnectionStatus('disconnected');
 
+        // No hello received (e.g. refused), load the state over HTTP once
+        if (!snapshotLoaded) {
+            refreshData();
+        }
+
         reconnectInterval = setInterval(() => {
             console.log('Reconnecting...');
             initWebSocket();
@@ -72,13 +138,17 @@ function initWebSocket() {
 function handleMessage(data) {
     console.log('Received:', data);
 
-    if (data.type === 'sensor_data') {
+    if (data.type === 'snapshot') {
+        applySnapshot(data);
+    } else if (data.type === 'sensor_data') {
         updateGasData(data);
 
-        // Check for alerts
+        // Check for alerts (data.alert is in the device language, show ours)
         if (data.alert) {
-            showAlert(data.alert);
+            showAlert(t('ALERT_GAS_DANGER'));
         }
+    } else if (data.type === 'anomaly') {
+        showAlert(formatAnomaly(data));
     } else if (data.device_id) {
         updateDeviceInfo(data);
     }
@@ -94,30 +164,56 @@ function updateGasData(data) {
         const ppm = data.gas_ppm.toFixed(1);
         elements.gasPPM.textContent = ppm;
 
-        // Update status based on PPM level
-        let status = 'Normal';
-        let level = 'normal';
-
-        if (data.gas_ppm > 1000) {
-            status = 'DANGER';
-            level = 'danger';
-        } else if (data.gas_ppm > 500) {
-            status = 'Warning';
-            level = 'warning';
-        } else if (data.gas_ppm > 200) {
-            status = 'Elevated';
-            level = 'elevated';
-        }
+    }
 
-        elements.gasStatus.textContent = status;
-        elements.gasDisplay.className = 'sensor-item gas ' + level;
+    if (data.gas_level !== undefined) {
+        setText(elements.gasStatus, 'DASH_LEVEL_' + data.gas_level.toUpperCase());
+        elements.gasDisplay.className = 'sensor-item gas ' + data.gas_level;
     }
 
     if (data.gas_calibrated !== undefined) {
-        elements.gasCalibrated.textContent = data.gas_calibrated ? 'Calibrated' : 'Not calibrated';
+        setText(elements.gasCalibrated, data.gas_calibrated ? 'DASH_CALIBRATED' : 'DASH_NOT_CALIBRATED');
+    }
+
+    if (Array.isArray(data.channels)) {
+        updateGasChannels(data.channels);
     }
 }
 
+/**
+ * Update per-channel gas readings
+ */
+function updateGasChannels(channels) {
+    elements.gasChannels.replaceChildren(...channels.map((channel) => {
+        const item = document.createElement('div');
+        item.className = 'info-item ' + channel.level;
+
+        const label = document.createElement('span');
+        label.className = 'label';
+        label.textContent = `${channel.model} (${channel.gas})`;
+
+        const value = document.createElement('span');
+        value.className = 'value';
+        if (channel.calibrated) {
+            value.textContent = `${channel.ppm.toFixed(1)} PPM`;
+        } else {
+            setText(value, 'DASH_NOT_CALIBRATED');
+        }
+
+        item.append(label, value);
+        return item;
+    }));
+}
+
+/**
+ * Describe an anomaly event
+ */
+function formatAnomaly(data) {
+    const kind = t(data.kind === 'rate_of_rise' ? 'ALERT_RAPID_RISE' : 'ALERT_ABNORMAL_TREND');
+    return `${kind} ${t('ALERT_ON')} ${data.model}: ${data.ppm.toFixed(1)} PPM ` +
+        `(${data.slope.toFixed(2)} PPM/s)`;
+}
+
 /**
  * Show alert banner
  */
@@ -139,12 +235,12 @@ function updateConnectionStatus(status) {
     badge.className = 'status-badge ' + status;
 
     const statusText = {
-        connected: 'Connected',
-        disconnected: 'Disconnected',
-        connecting: 'Connecting...'
+        connected: 'DASH_CONNECTED',
+        disconnected: 'DASH_DISCONNECTED',
+        connecting: 'DASH_CONNECTING'
     };
 
-    badge.querySelector('span:last-child').textContent = statusText[status] || 'Unknown';
+    setText(badge.querySelector('span:last-child'), statusText[status] || 'DASH_UNKNOWN');
 }
 
 /**
@@ -168,33 +264,64 @@ function formatUptime(seconds) {
     return `${minutes}m ${seconds % 60}s`;
 }
 
+/**
+ * Apply a full device snapshot (WebSocket hello or /api/snapshot)
+ */
+function applySnapshot(data) {
+    snapshotLoaded = true;
+    updateDeviceInfo(data.status);
+    updateGasData({
+        gas_ppm: data.gas.ppm,
+        gas_level: data.gas.level,
+        gas_calibrated: data.gas.calibrated,
+        channels: data.gas.channels
+    });
+
+    if (data.alarm.dangerous) {
+        showAlert(t('ALERT_GAS_DANGER'));
+    }
+
+    cameraAvailable = data.camera.initialized;
+    if (cameraAvailable) {
+        refreshCamera();
+    } else {
+        elements.cameraFeed.dispatchEvent(new Event('error'));
+    }
+}
+
 /**
  * Refresh all data
  */
 async function refreshData() {
     try {
-        const response = await fetch('/api/status');
-        const data = await response.json();
-        updateDeviceInfo(data);
-
-        const gasResponse = await fetch('/api/gas');
-        const gasData = await gasResponse.json();
-        updateGasData({
-            gas_ppm: gasData.ppm,
-            gas_calibrated: gasData.calibrated
-        });
-
-        refreshCamera();
+        const response = await fetch('/api/snapshot');
+        applySnapshot(await response.json());
+        elements.lastUpdate.textContent = new Date().toLocaleTimeString();
     } catch (error) {
         console.error('Refresh error:', error);
     }
 }
 
+/**
+ * Poll a deferred job until it finishes, resolves to its final state
+ */
+async function waitForJob(id) {
+    while (true) {
+        await new Promise(resolve => setTimeout(resolve, 1000));
+        const response = await fetch('/api/jobs?id=' + id);
+        const job = await response.json();
+
+        if (job.state === 'done' || job.state === 'failed') {
+            return job.state;
+        }
+    }
+}
+
 /**
  * Calibrate gas sensor
  */
 async function calibrateGas() {
-    if (!confirm('Calibrate gas sensor?\nMake sure sensor is in clean air.')) {
+    if (!confirm(t('DASH_CONFIRM_CALIBRATE'))) {
         return;
     }
 
@@ -202,15 +329,22 @@ async function calibrateGas() {
         const response = await fetch('/api/gas/calibrate', { method: 'POST' });
         const data = await response.json();
 
-        if (data.status === 'calibrated') {
-            alert('Calibration successful!');
-            elements.gasCalibrated.textContent = 'Calibrated';
+        if (data.status !== 'queued') {
+            alert(t('DASH_DEVICE_BUSY'));
+            return;
+        }
+
+        setText(elements.gasCalibrated, 'DASH_CALIBRATING');
+        if (await waitForJob(data.job) === 'done') {
+            alert(t('DASH_CALIBRATION_OK'));
+            setText(elements.gasCalibrated, 'DASH_CALIBRATED');
         } else {
-            alert('Calibration failed. Check sensor connection.');
+            alert(t('DASH_CALIBRATION_FAILED'));
+            setText(elements.gasCalibrated, 'DASH_NOT_CALIBRATED');
         }
     } catch (error) {
         console.error('Calibration error:', error);
-        alert('Calibration error');
+        alert(t('DASH_CALIBRATION_ERROR'));
     }
 }
 
@@ -218,10 +352,24 @@ async function calibrateGas() {
  * Refresh camera feed
  */
 function refreshCamera() {
+    if (!cameraAvailable) return;
+
     const timestamp = new Date().getTime();
     elements.cameraFeed.src = '/capture?' + timestamp;
 }
 
+/**
+ * Placeholder when no frame can be loaded
+ */
+function showCameraOffline(img) {
+    const svg = '<svg xmlns="http://www.w3.org/2000/svg" viewBox="0 0 640 480">' +
+        '<rect fill="#1e293b" width="640" height="480"/>' +
+        '<text x="320" y="240" text-anchor="middle" fill="#94a3b8" font-size="20">' +
+        t('DASH_CAMERA_OFFLINE') + '</text></svg>';
+    if (img.src.startsWith('data:')) return;
+    img.src = 'data:image/svg+xml,' + encodeURIComponent(svg);
+}
+
 /**
  * Download camera capture
  */
@@ -236,21 +384,28 @@ function downloadCapture() {
  * Restart device
  */
 async function restartDevice() {
-    if (!confirm('Restart device?')) return;
+    if (!confirm(t('DASH_CONFIRM_RESTART'))) return;
 
     try {
         await fetch('/api/restart', { method: 'POST' });
         updateConnectionStatus('disconnected');
-        alert('Device restarting...');
+        alert(t('DASH_RESTARTING'));
     } catch (error) {
         console.error('Restart error:', error);
     }
 }
 
 // Initialize
-document.addEventListener('DOMContentLoaded', () => {
+document.addEventListener('DOMContentLoaded', async () => {
+    // Strings first so nothing renders in the wrong language
+    await loadLanguage(localStorage.getItem('lang'));
+    elements.langSelect.addEventListener('change', () => {
+        localStorage.setItem('lang', elements.langSelect.value);
+        loadLanguage(elements.langSelect.value);
+    });
+
+    // The WebSocket hello carries the full snapshot
     initWebSocket();
-    refreshData();
 
     // Auto-refresh camera every 5 seconds
     cameraRefreshInterval = setInterval(refreshCamera, 5000);
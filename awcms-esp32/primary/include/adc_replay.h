@@ -0,0 +1,235 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * ADC Trace Replay
+ *
+ * Reads recorded raw ADC traces and hands out the sample the live ADC
+ * would have returned at a given time (sample and hold), so a trace can be
+ * fed through readGasSensor() via gasScanSource. Two formats:
+ *
+ *   CSV     "t_ms,adc0[,adc1...]" per line, '#' comments and a header line
+ *           are skipped
+ *   Binary  "AWAD" header (12 bytes), then t_ms (uint32) and one uint16 per
+ *           channel for every sample, little endian
+ *
+ * Timestamps are made relative to the first sample. No Arduino
+ * dependencies; the host runner is bench/replay.cpp.
+ */
+
+#ifndef ADC_REPLAY_H
+#define ADC_REPLAY_H
+
+#include "store_fs.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// ADC Replay Configuration
+// ============================================
+
+#define REPLAY_MAGIC 0x44415741UL // "AWAD"
+#define REPLAY_VERSION 1
+#define REPLAY_MAX_CHANNELS 8
+
+// ============================================
+// ADC Replay Types
+// ============================================
+
+struct ReplayHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t channels;
+  uint32_t reserved;
+};
+
+struct AdcReplay {
+  StoreFile file;
+  bool binary;
+  uint8_t channels; // Columns in the trace
+  uint32_t firstMs; // Raw timestamp of the first sample
+  uint32_t samples; // Read so far
+
+  // Current sample and the one after it
+  uint32_t curMs;
+  uint16_t cur[REPLAY_MAX_CHANNELS];
+  uint32_t nextMs;
+  uint16_t next[REPLAY_MAX_CHANNELS];
+  bool hasNext;
+
+  // CSV read buffer
+  char buf[256];
+  size_t bufLen;
+  size_t bufPos;
+};
+
+// ============================================
+// ADC Replay Functions
+// ============================================
+
+/**
+ * Read one CSV line into line (without the newline), false at end of file
+ */
+bool replayReadLine(AdcReplay &r, char *line, size_t len) {
+  size_t n = 0;
+  while (true) {
+    if (r.bufPos >= r.bufLen) {
+      r.bufLen = r.file.read((uint8_t *)r.buf, sizeof(r.buf));
+      r.bufPos = 0;
+      if (r.bufLen == 0) {
+        line[n] = '\0';
+        return n > 0;
+      }
+    }
+    char c = r.buf[r.bufPos++];
+    if (c == '\n') {
+      line[n] = '\0';
+      return true;
+    }
+    if (c != '\r' && n + 1 < len) {
+      line[n++] = c;
+    }
+  }
+}
+
+/**
+ * Read the next sample from the file, false at end of trace
+ */
+bool replayReadSample(AdcReplay &r, uint32_t &tMs, uint16_t *adc) {
+  if (r.binary) {
+    uint8_t record[4 + 2 * REPLAY_MAX_CHANNELS];
+    size_t size = 4 + 2 * r.channels;
+    if (r.file.read(record, size) != size) {
+      return false;
+    }
+    memcpy(&tMs, record, 4);
+    memcpy(adc, record + 4, 2 * r.channels);
+    return true;
+  }
+
+  char line[128];
+  while (replayReadLine(r, line, sizeof(line))) {
+    char *p = line;
+    char *end;
+    unsigned long t = strtoul(p, &end, 10);
+    if (end == p || *end != ',') {
+      continue; // Comment, header or blank line
+    }
+
+    uint8_t count = 0;
+    while (*end == ',' && count < REPLAY_MAX_CHANNELS) {
+      p = end + 1;
+      long value = strtol(p, &end, 10);
+      if (end == p) {
+        break;
+      }
+      adc[count++] = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+    }
+    if (count == 0) {
+      continue;
+    }
+    if (r.channels == 0) {
+      r.channels = count;
+    }
+    for (uint8_t ch = count; ch < r.channels; ch++) {
+      adc[ch] = adc[count - 1];
+    }
+    tMs = (uint32_t)t;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Fetch the sample after the current one
+ */
+void replayAdvance(AdcReplay &r) {
+  r.curMs = r.nextMs;
+  memcpy(r.cur, r.next, sizeof(r.cur));
+  uint32_t t;
+  r.hasNext = replayReadSample(r, t, r.next);
+  if (r.hasNext) {
+    r.nextMs = t - r.firstMs;
+    r.samples++;
+  }
+}
+
+/**
+ * Open a trace (format detected from the first bytes)
+ * Returns false if the file is missing or holds no samples
+ */
+bool replayOpen(AdcReplay &r, StoreFS &fs, const char *path) {
+  r = AdcReplay();
+  r.file = fs.open(path, "r");
+  if (!r.file.isOpen()) {
+    return false;
+  }
+
+  ReplayHeader header;
+  if (r.file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+      header.magic == REPLAY_MAGIC) {
+    if (header.channels == 0 || header.channels > REPLAY_MAX_CHANNELS) {
+      r.file.close();
+      return false;
+    }
+    r.binary = true;
+    r.channels = header.channels;
+  } else {
+    r.file.seek(0);
+  }
+
+  uint32_t t;
+  if (!replayReadSample(r, t, r.next)) {
+    r.file.close();
+    return false;
+  }
+  r.firstMs = t;
+  r.nextMs = 0;
+  r.samples = 1;
+  replayAdvance(r);
+  return true;
+}
+
+/**
+ * Sample held at tMs (since the first sample) for count channels
+ * Channels beyond the trace repeat its last column
+ */
+void replaySampleAt(AdcReplay &r, uint32_t tMs, uint16_t *raw, size_t count) {
+  while (r.hasNext && r.nextMs <= tMs) {
+    replayAdvance(r);
+  }
+  for (size_t ch = 0; ch < count; ch++) {
+    raw[ch] = r.cur[ch < r.channels ? ch : r.channels - 1];
+  }
+}
+
+/**
+ * Whether every sample has been handed out by tMs
+ */
+bool replayFinished(const AdcReplay &r, uint32_t tMs) {
+  return !r.hasNext && tMs >= r.curMs;
+}
+
+void replayClose(AdcReplay &r) { r.file.close(); }
+
+/**
+ * Start a binary trace
+ */
+bool replayWriteHeader(StoreFile &file, uint8_t channels) {
+  ReplayHeader header = {REPLAY_MAGIC, REPLAY_VERSION, channels, 0};
+  return file.write((const uint8_t *)&header, sizeof(header)) ==
+         sizeof(header);
+}
+
+/**
+ * Append one sample to a binary trace
+ */
+bool replayWriteSample(StoreFile &file, uint32_t tMs, const uint16_t *adc,
+                       uint8_t channels) {
+  uint8_t record[4 + 2 * REPLAY_MAX_CHANNELS];
+  size_t size = 4 + 2 * channels;
+  memcpy(record, &tMs, 4);
+  memcpy(record + 4, adc, 2 * channels);
+  return file.write(record, size) == size;
+}
+
+#endif // ADC_REPLAY_H
@@ -0,0 +1,272 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Gas Anomaly Detector
+ *
+ * Constant-memory streaming detectors run on every sample:
+ * - Rate of rise: least-squares slope over the last ANOMALY_SLOPE_SAMPLES
+ *   readings, kept as running sums (O(1) per sample)
+ * - CUSUM: one-sided cumulative sum of the deviation from an EWMA baseline,
+ *   catches slow leaks that never cross an absolute threshold
+ * No Arduino dependencies, so it builds on the host as well.
+ */
+
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// Anomaly Detector Configuration
+// ============================================
+
+// Samples in the slope window (ring of timestamp/value pairs)
+#ifndef ANOMALY_SLOPE_SAMPLES
+#define ANOMALY_SLOPE_SAMPLES 12
+#endif
+
+// Defaults, tunable at runtime through DeviceConfig
+#ifndef ANOMALY_SLOPE_LIMIT
+#define ANOMALY_SLOPE_LIMIT 5.0f // PPM per second
+#endif
+
+#ifndef ANOMALY_EWMA_ALPHA
+#define ANOMALY_EWMA_ALPHA 0.05f // Baseline smoothing per sample
+#endif
+
+#ifndef ANOMALY_CUSUM_K
+#define ANOMALY_CUSUM_K 0.5f // Allowed drift, in baseline std devs
+#endif
+
+#ifndef ANOMALY_CUSUM_H
+#define ANOMALY_CUSUM_H 8.0f // Alarm level, in baseline std devs
+#endif
+
+#ifndef ANOMALY_SIGMA_FLOOR
+#define ANOMALY_SIGMA_FLOOR 2.0f // Minimum baseline std dev (PPM)
+#endif
+
+#ifndef ANOMALY_WARMUP_SAMPLES
+#define ANOMALY_WARMUP_SAMPLES 20
+#endif
+
+#ifndef ANOMALY_HOLDOFF_MS
+#define ANOMALY_HOLDOFF_MS 60000 // Minimum time between events per detector
+#endif
+
+// Event flags returned by anomalyUpdate()
+#define ANOMALY_NONE 0x00
+#define ANOMALY_RATE_OF_RISE 0x01
+#define ANOMALY_CUSUM 0x02
+
+// ============================================
+// Anomaly Detector Types
+// ============================================
+
+struct AnomalyParams {
+  float slopeLimit; // PPM/s, 0 = rate-of-rise check off
+  float ewmaAlpha;
+  float cusumK;
+  float cusumH; // 0 = CUSUM check off
+  uint32_t holdoffMs;
+};
+
+struct AnomalyDetector {
+  // Slope window; the sums use seconds relative to the newest sample
+  uint32_t tMs[ANOMALY_SLOPE_SAMPLES];
+  float y[ANOMALY_SLOPE_SAMPLES];
+  uint32_t newestMs;
+  uint8_t head;
+  uint8_t filled;
+  float sumT;
+  float sumY;
+  float sumTT;
+  float sumTY;
+  float slope; // PPM/s, valid once the window is full
+
+  // EWMA baseline and CUSUM
+  uint32_t samples;
+  float mean;
+  float var;
+  float cusum; // In baseline std devs
+
+  // Alarm state
+  uint8_t active; // Flags currently latched
+  uint32_t lastEventMs;
+  bool hasEvent;
+};
+
+// ============================================
+// Anomaly Detector Functions
+// ============================================
+
+/**
+ * Compile-time default parameters
+ */
+AnomalyParams anomalyDefaultParams() {
+  AnomalyParams params;
+  params.slopeLimit = ANOMALY_SLOPE_LIMIT;
+  params.ewmaAlpha = ANOMALY_EWMA_ALPHA;
+  params.cusumK = ANOMALY_CUSUM_K;
+  params.cusumH = ANOMALY_CUSUM_H;
+  params.holdoffMs = ANOMALY_HOLDOFF_MS;
+  return params;
+}
+
+/**
+ * Clear all detector state
+ */
+void anomalyReset(AnomalyDetector &det) { memset(&det, 0, sizeof(det)); }
+
+/**
+ * Recompute the slope sums exactly from the ring
+ * Called once per ring wrap to stop float error from accumulating
+ */
+void anomalyResum(AnomalyDetector &det) {
+  det.sumT = det.sumY = det.sumTT = det.sumTY = 0;
+  for (uint8_t i = 0; i < det.filled; i++) {
+    float t = -(float)(det.newestMs - det.tMs[i]) / 1000.0f;
+    det.sumT += t;
+    det.sumY += det.y[i];
+    det.sumTT += t * t;
+    det.sumTY += t * det.y[i];
+  }
+}
+
+/**
+ * Add one sample to the slope window, O(1)
+ */
+void anomalyUpdateSlope(AnomalyDetector &det, float value, uint32_t nowMs) {
+  // Shift the time origin of the sums to the new sample: t' = t - d
+  if (det.filled > 0) {
+    float d = (nowMs - det.newestMs) / 1000.0f;
+    float n = det.filled;
+    det.sumTT += -2.0f * d * det.sumT + n * d * d;
+    det.sumTY -= d * det.sumY;
+    det.sumT -= n * d;
+  }
+  det.newestMs = nowMs;
+
+  // Evict the oldest sample once the window is full
+  if (det.filled == ANOMALY_SLOPE_SAMPLES) {
+    float t0 = -(float)(nowMs - det.tMs[det.head]) / 1000.0f;
+    float y0 = det.y[det.head];
+    det.sumT -= t0;
+    det.sumY -= y0;
+    det.sumTT -= t0 * t0;
+    det.sumTY -= t0 * y0;
+  } else {
+    det.filled++;
+  }
+
+  det.tMs[det.head] = nowMs;
+  det.y[det.head] = value;
+  det.sumY += value;
+  det.head = (det.head + 1) % ANOMALY_SLOPE_SAMPLES;
+
+  if (det.head == 0) {
+    anomalyResum(det);
+  }
+
+  float n = det.filled;
+  float denom = n * det.sumTT - det.sumT * det.sumT;
+  det.slope = (det.filled == ANOMALY_SLOPE_SAMPLES && denom > 1e-6f)
+                  ? (n * det.sumTY - det.sumT * det.sumY) / denom
+                  : 0.0f;
+}
+
+/**
+ * Update EWMA baseline and the upward CUSUM
+ * The baseline is frozen while an alarm is latched so a leak is not learned
+ */
+void anomalyUpdateCusum(AnomalyDetector &det, const AnomalyParams &params,
+                        float value) {
+  det.samples++;
+  if (det.samples == 1) {
+    det.mean = value;
+    det.var = 0.0f;
+    return;
+  }
+
+  float sigma = sqrtf(det.var);
+  if (sigma < ANOMALY_SIGMA_FLOOR) {
+    sigma = ANOMALY_SIGMA_FLOOR;
+  }
+  float z = (value - det.mean) / sigma;
+
+  if (det.samples > ANOMALY_WARMUP_SAMPLES) {
+    det.cusum += z - params.cusumK;
+    if (det.cusum < 0.0f) {
+      det.cusum = 0.0f;
+    }
+    // Bound the sum so recovery after a long alarm stays quick
+    if (params.cusumH > 0 && det.cusum > 4.0f * params.cusumH) {
+      det.cusum = 4.0f * params.cusumH;
+    }
+  }
+
+  if (!(det.active & ANOMALY_CUSUM)) {
+    float delta = value - det.mean;
+    det.mean += params.ewmaAlpha * delta;
+    det.var = (1.0f - params.ewmaAlpha) *
+              (det.var + params.ewmaAlpha * delta * delta);
+  }
+}
+
+/**
+ * Feed one sample, returns newly raised ANOMALY_* flags
+ * A flag re-arms once its condition clears; events are rate limited by
+ * holdoffMs per detector
+ */
+uint8_t anomalyUpdate(AnomalyDetector &det, const AnomalyParams &params,
+                      float value, uint32_t nowMs) {
+  anomalyUpdateSlope(det, value, nowMs);
+  anomalyUpdateCusum(det, params, value);
+
+  uint8_t firing = ANOMALY_NONE;
+  if (params.slopeLimit > 0 && det.slope > params.slopeLimit) {
+    firing |= ANOMALY_RATE_OF_RISE;
+  }
+  if (params.cusumH > 0 && det.cusum > params.cusumH) {
+    firing |= ANOMALY_CUSUM;
+  }
+
+  // Hysteresis: clear at half the trigger level
+  uint8_t clearing = ANOMALY_NONE;
+  if ((det.active & ANOMALY_RATE_OF_RISE) && det.slope < params.slopeLimit / 2) {
+    clearing |= ANOMALY_RATE_OF_RISE;
+  }
+  if ((det.active & ANOMALY_CUSUM) && det.cusum < params.cusumH / 2) {
+    clearing |= ANOMALY_CUSUM;
+  }
+  det.active &= ~clearing;
+
+  uint8_t raised = firing & ~det.active;
+  det.active |= firing;
+
+  if (raised == ANOMALY_NONE) {
+    return ANOMALY_NONE;
+  }
+  if (det.hasEvent && nowMs - det.lastEventMs < params.holdoffMs) {
+    return ANOMALY_NONE;
+  }
+  det.hasEvent = true;
+  det.lastEventMs = nowMs;
+  return raised;
+}
+
+/**
+ * Name of the highest-priority flag in an event
+ */
+const char *anomalyName(uint8_t flags) {
+  if (flags & ANOMALY_RATE_OF_RISE) {
+    return "rate_of_rise";
+  }
+  if (flags & ANOMALY_CUSUM) {
+    return "cusum";
+  }
+  return "none";
+}
+
+#endif // ANOMALY_H
@@ -36,21 +36,9 @@
 // ============================================
 
 /**
- * Check if request has valid Basic Auth credentials
+ * Check an Authorization header value against the configured credentials
  */
-bool isAuthenticated(AsyncWebServerRequest *request) {
-  // Skip auth if disabled
-  if (!AUTH_ENABLED) {
-    return true;
-  }
-
-  // Check for Authorization header
-  if (!request->hasHeader("Authorization")) {
-    return false;
-  }
-
-  String authHeader = request->header("Authorization");
-
+bool checkBasicAuthHeader(const String &authHeader) {
   // Check for Basic auth
   if (!authHeader.startsWith("Basic ")) {
     return false;
@@ -65,6 +53,23 @@ bool isAuthenticated(AsyncWebServerRequest *request) {
   return decoded.equals(expectedAuth);
 }
 
+/**
+ * Check if request has valid Basic Auth credentials
+ */
+bool isAuthenticated(AsyncWebServerRequest *request) {
+  // Skip auth if disabled
+  if (!AUTH_ENABLED) {
+    return true;
+  }
+
+  // Check for Authorization header
+  if (!request->hasHeader("Authorization")) {
+    return false;
+  }
+
+  return checkBasicAuthHeader(request->header("Authorization"));
+}
+
 /**
  * Request authentication from client
  */
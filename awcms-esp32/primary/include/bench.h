@@ -0,0 +1,114 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Benchmark Harness
+ *
+ * Times a callable over N iterations and prints one JSON line per result.
+ * Uses the CPU cycle counter on the device and steady_clock on the host.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BENCH_PRINTF(...) Serial.printf(__VA_ARGS__)
+#define BENCH_TARGET "esp32"
+#else
+#include <chrono>
+#define BENCH_PRINTF(...) printf(__VA_ARGS__)
+#define BENCH_TARGET "host"
+#endif
+
+// ============================================
+// Benchmark Types
+// ============================================
+
+struct BenchResult {
+  const char *name;
+  uint32_t iterations;
+  double nsPerOp;
+  double cyclesPerOp; // 0 when no cycle counter is available
+};
+
+// ============================================
+// Benchmark Functions
+// ============================================
+
+/**
+ * Keep a value alive so the optimizer cannot drop the work producing it
+ */
+template <typename T> void benchKeep(const T &value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+/**
+ * Current timestamp in benchmark ticks
+ */
+uint64_t benchNow() {
+#ifdef ARDUINO
+  return ESP.getCycleCount();
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * Elapsed ticks between two timestamps
+ * The device cycle counter is 32-bit, so keep single runs under ~15 s
+ */
+uint64_t benchElapsed(uint64_t start, uint64_t end) {
+#ifdef ARDUINO
+  return (uint32_t)((uint32_t)end - (uint32_t)start);
+#else
+  return end - start;
+#endif
+}
+
+/**
+ * Print a result as a JSON line
+ */
+void benchReport(const BenchResult &result) {
+  BENCH_PRINTF("{\"bench\":\"%s\",\"target\":\"%s\",\"iterations\":%u,"
+               "\"ns_per_op\":%.1f,\"cycles_per_op\":%.1f}\n",
+               result.name, BENCH_TARGET, (unsigned)result.iterations,
+               result.nsPerOp, result.cyclesPerOp);
+}
+
+/**
+ * Run fn() iterations times after a short warm-up and report the result
+ */
+template <typename Fn>
+BenchResult benchRun(const char *name, uint32_t iterations, Fn fn) {
+  uint32_t warmup = iterations / 10 + 1;
+  for (uint32_t i = 0; i < warmup; i++) {
+    fn();
+  }
+
+  uint64_t start = benchNow();
+  for (uint32_t i = 0; i < iterations; i++) {
+    fn();
+  }
+  uint64_t ticks = benchElapsed(start, benchNow());
+
+  BenchResult result;
+  result.name = name;
+  result.iterations = iterations;
+#ifdef ARDUINO
+  result.cyclesPerOp = (double)ticks / iterations;
+  result.nsPerOp = result.cyclesPerOp * 1000.0 / ESP.getCpuFreqMHz();
+#else
+  result.cyclesPerOp = 0;
+  result.nsPerOp = (double)ticks / iterations;
+#endif
+
+  benchReport(result);
+  return result;
+}
+
+#endif // BENCH_H
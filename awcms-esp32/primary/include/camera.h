@@ -4,6 +4,11 @@
  *
  * OV2640 camera support with MJPEG streaming
  * and snapshot capture.
+ *
+ * A capture task pinned to the app core grabs frames at a steady rate
+ * into a PSRAM triple buffer (triple_buffer.h). HTTP handlers and the
+ * recorder take the newest complete frame from it instead of waiting on
+ * the sensor.
  */
 
 #ifndef CAMERA_H
@@ -11,8 +16,12 @@
 
 #include "config.h"
 #include "esp_camera.h"
+#include "mem_pools.h"
+#include "triple_buffer.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include <memory>
 
 // ============================================
 // ESP32-CAM AI-Thinker Pin Configuration
@@ -35,10 +44,61 @@
 #define HREF_GPIO_NUM 23
 #define PCLK_GPIO_NUM 22
 
+// ============================================
+// Camera Capture Configuration
+// ============================================
+
+#ifndef CAM_CAPTURE_FPS
+#define CAM_CAPTURE_FPS 10
+#endif
+
+// Rate once no consumer has asked for a frame in CAM_IDLE_AFTER ms
+#ifndef CAM_IDLE_FPS
+#define CAM_IDLE_FPS 1
+#endif
+
+#ifndef CAM_IDLE_AFTER
+#define CAM_IDLE_AFTER 30000
+#endif
+
+#ifndef CAM_CAPTURE_PRIORITY
+#define CAM_CAPTURE_PRIORITY 2
+#endif
+
+// ============================================
+// Camera Types
+// ============================================
+
+void releaseFrame(FrameSlot *slot);
+
+// Reference to a buffered frame held by a /capture response until it
+// has been sent
+struct FrameRef {
+  FrameSlot *slot;
+
+  explicit FrameRef(FrameSlot *s) : slot(s) {}
+  ~FrameRef() { releaseFrame(slot); }
+};
+
+struct CameraCaptureStats {
+  uint32_t grabbed;
+  uint32_t failed;   // esp_camera_fb_get() returned nothing
+  uint32_t oversize; // No memory to grow a slot for the frame
+  uint16_t fps;      // Frames published in the last full second
+  uint16_t windowFrames;
+  uint32_t windowStart;
+};
+
 // ============================================
 // Camera Variables
 // ============================================
 bool cameraInitialized = false;
+volatile bool cameraInitPending = false;
+TripleBuffer camFrames;
+CameraCaptureStats camStats = {0, 0, 0, 0, 0, 0};
+FrameConsumer camCaptureConsumer = {"capture", 0, 0, 0, 0, 0, 0};
+FrameConsumer camRecorderConsumer = {"recorder", 0, 0, 0, 0, 0, 0};
+volatile uint32_t camLastDemand = 0;
 
 // ============================================
 // Camera Functions
@@ -76,13 +136,17 @@ bool initCamera() {
     config.frame_size = FRAMESIZE_VGA; // 640x480
     config.jpeg_quality = 10;
     config.fb_count = 2;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
     DEBUG_PRINTLN("PSRAM found, using VGA resolution");
   } else {
     config.frame_size = FRAMESIZE_QVGA; // 320x240
     config.jpeg_quality = 12;
     config.fb_count = 1;
+    config.fb_location = CAMERA_FB_IN_DRAM;
     DEBUG_PRINTLN("No PSRAM, using QVGA resolution");
   }
+  // The capture task copies frames out, so the driver may always refill
+  config.grab_mode = CAMERA_GRAB_LATEST;
 
   // Initialize camera
   esp_err_t err = esp_camera_init(&config);
@@ -124,40 +188,173 @@ bool initCamera() {
 }
 
 /**
- * Capture a single frame
+ * Copy one frame from the driver into a free triple buffer slot
  */
-camera_fb_t *captureFrame() {
-  if (!cameraInitialized) {
-    return NULL;
+void captureIntoBuffer() {
+  camera_fb_t *fb = esp_camera_fb_get();
+  if (!fb) {
+    camStats.failed++;
+    return;
   }
-  return esp_camera_fb_get();
+  uint32_t capturedAt = millis();
+  camStats.grabbed++;
+
+  FrameSlot *slot = tripleBufferClaim(camFrames);
+  if (slot && fb->len > slot->capacity) {
+    // Grow to the largest frame seen so far; the slot is ours until published
+    uint32_t caps = psramFound() ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT;
+    uint8_t *grown = (uint8_t *)heap_caps_realloc(slot->buf, fb->len, caps);
+    if (grown) {
+      slot->buf = grown;
+      slot->capacity = fb->len;
+    } else {
+      camStats.oversize++;
+      slot = NULL;
+    }
+  }
+  if (slot) {
+    memcpy(slot->buf, fb->buf, fb->len);
+    tripleBufferPublish(camFrames, slot, fb->len, capturedAt);
+    camStats.windowFrames++;
+  }
+  esp_camera_fb_return(fb);
 }
 
 /**
- * Return frame buffer to driver
+ * Capture task: grab at CAM_CAPTURE_FPS while frames are wanted,
+ * CAM_IDLE_FPS otherwise
  */
-void releaseFrame(camera_fb_t *fb) {
-  if (fb) {
-    esp_camera_fb_return(fb);
+void cameraCaptureTask(void *param) {
+  TickType_t wake = xTaskGetTickCount();
+  camStats.windowStart = millis();
+  while (true) {
+    bool idle = millis() - camLastDemand > CAM_IDLE_AFTER;
+    uint32_t fps = idle ? CAM_IDLE_FPS : CAM_CAPTURE_FPS;
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(1000 / fps));
+    captureIntoBuffer();
+
+    uint32_t now = millis();
+    if (now - camStats.windowStart >= 1000) {
+      uint32_t elapsed = now - camStats.windowStart;
+      camStats.fps = camStats.windowFrames * 1000 / elapsed;
+      camStats.windowFrames = 0;
+      camStats.windowStart = now;
+    }
   }
 }
 
 /**
- * Get camera status as JSON
+ * Start continuous capture once the sensor is up
  */
-String getCameraStatusJSON() {
-  JsonDocument doc;
+bool startCameraCapture() {
+  camLastDemand = millis();
+  return xTaskCreatePinnedToCore(cameraCaptureTask, "camCapture", 3072, NULL,
+                                 CAM_CAPTURE_PRIORITY, NULL,
+                                 APP_CPU_NUM) == pdPASS;
+}
 
-  doc["initialized"] = cameraInitialized;
-  doc["psram"] = psramFound();
+/**
+ * Initialize camera and report the result
+ */
+void runCameraInit() {
+  tripleBufferInit(camFrames); // Empty before cameraInitialized lets readers in
+  if (initCamera() && !startCameraCapture()) {
+    cameraInitialized = false;
+    DEBUG_PRINTLN("Camera capture task start failed");
+  }
+  if (cameraInitialized) {
+    DEBUG_PRINTLN("Camera ready");
+  } else {
+    DEBUG_PRINTLN("Camera init failed - check connections");
+  }
+  cameraInitPending = false;
+}
+
+/**
+ * Camera init task body, runs once then deletes itself
+ */
+void cameraInitTask(void *param) {
+  runCameraInit();
+  vTaskDelete(NULL);
+}
+
+/**
+ * Initialize the camera in the background so sensor probing and
+ * frame buffer allocation overlap with WiFi bring-up
+ */
+void startCameraInit() {
+  cameraInitPending = true;
+  if (xTaskCreatePinnedToCore(cameraInitTask, "camInit", 4096, NULL, 1, NULL,
+                              APP_CPU_NUM) != pdPASS) {
+    runCameraInit();
+  }
+}
+
+/**
+ * Newest buffered frame, never waits on the sensor
+ * NULL before the first frame; pass the result to releaseFrame()
+ */
+FrameSlot *acquireFrame(FrameConsumer &consumer) {
+  if (!cameraInitialized) {
+    return NULL;
+  }
+  camLastDemand = millis();
+  FrameSlot *slot = tripleBufferAcquire(camFrames);
+  if (slot) {
+    frameConsumerNote(consumer, slot, millis());
+  }
+  return slot;
+}
+
+/**
+ * Drop a reference taken with acquireFrame()
+ */
+void releaseFrame(FrameSlot *slot) { tripleBufferRelease(slot); }
+
+void addFrameConsumerJSON(JsonObject obj, const FrameConsumer &consumer) {
+  obj["frames"] = consumer.frames;
+  obj["skipped"] = consumer.skipped;
+  obj["repeats"] = consumer.repeats;
+  obj["lag_ms_avg"] = (uint32_t)consumer.lagAvg;
+  obj["lag_ms_max"] = consumer.lagMax;
+}
+
+/**
+ * Add camera state to a JSON object
+ */
+void addCameraStatusJSON(JsonObject camera) {
+  camera["initialized"] = cameraInitialized;
+  camera["psram"] = psramFound();
 
   if (cameraInitialized) {
     sensor_t *s = esp_camera_sensor_get();
     if (s) {
-      doc["resolution"] = s->status.framesize;
-      doc["quality"] = s->status.quality;
+      camera["resolution"] = s->status.framesize;
+      camera["quality"] = s->status.quality;
     }
+
+    JsonObject capture = camera["capture"].to<JsonObject>();
+    capture["fps"] = camStats.fps;
+    capture["target_fps"] =
+        millis() - camLastDemand > CAM_IDLE_AFTER ? CAM_IDLE_FPS
+                                                  : CAM_CAPTURE_FPS;
+    capture["grabbed"] = camStats.grabbed;
+    capture["published"] = camFrames.published;
+    capture["dropped"] = camFrames.dropped + camStats.oversize;
+    capture["failed"] = camStats.failed;
+    addFrameConsumerJSON(capture[camCaptureConsumer.name].to<JsonObject>(),
+                         camCaptureConsumer);
+    addFrameConsumerJSON(capture[camRecorderConsumer.name].to<JsonObject>(),
+                         camRecorderConsumer);
   }
+}
+
+/**
+ * Get camera status as JSON
+ */
+String getCameraStatusJSON() {
+  JsonDocument doc(&jsonWebPool);
+  addCameraStatusJSON(doc.to<JsonObject>());
 
   String output;
   serializeJson(doc, output);
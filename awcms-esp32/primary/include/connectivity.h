@@ -0,0 +1,481 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Connectivity Module
+ *
+ * Non-blocking WiFi state machine driven by WiFi events. Reconnects with
+ * jittered exponential backoff and opens a local access point when the
+ * network stays down. The last BSSID, channel and IP lease are cached in
+ * NVS so a reboot skips the full channel scan and DHCP.
+ */
+
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include "config.h"
+#include "loop_wake.h"
+#include "metrics.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <DNSServer.h>
+#include <Preferences.h>
+#include <WiFi.h>
+
+// ============================================
+// Connectivity Configuration
+// ============================================
+
+// Give up on the cached BSSID/channel/IP after this long and rescan (ms)
+#ifndef WIFI_FAST_TIMEOUT
+#define WIFI_FAST_TIMEOUT 3000
+#endif
+
+// Reuse the cached DHCP lease as a static IP on fast connect
+#ifndef WIFI_CACHE_STATIC_IP
+#define WIFI_CACHE_STATIC_IP true
+#endif
+
+// The router does not know we still use the cached address, so it only
+// lasts this many boots and this long connected before DHCP renews it
+#ifndef WIFI_LEASE_MAX_REUSE
+#define WIFI_LEASE_MAX_REUSE 8
+#endif
+
+#ifndef WIFI_LEASE_TTL
+#define WIFI_LEASE_TTL 3600000 // ms
+#endif
+
+// Reconnect backoff, doubled per failed attempt, randomized in [d/2, d] (ms)
+#ifndef WIFI_BACKOFF_MIN
+#define WIFI_BACKOFF_MIN 1000
+#endif
+
+#ifndef WIFI_BACKOFF_MAX
+#define WIFI_BACKOFF_MAX 60000
+#endif
+
+// Open the fallback access point after being offline this long (ms)
+#ifndef WIFI_AP_FALLBACK_DELAY
+#define WIFI_AP_FALLBACK_DELAY 60000
+#endif
+
+// Fallback AP password, 8+ characters ("" = open network)
+#ifndef WIFI_AP_PASSWORD
+#define WIFI_AP_PASSWORD "awcms2024"
+#endif
+
+// While the fallback AP is up, loop() wakes at least this often to
+// answer captive portal DNS queries (ms)
+#ifndef WIFI_AP_DNS_POLL
+#define WIFI_AP_DNS_POLL 10
+#endif
+
+// Time source for history timestamps
+#ifndef NTP_SERVER
+#define NTP_SERVER "pool.ntp.org"
+#endif
+
+#define WIFI_AP_SSID_PREFIX "AWCMS-"
+
+#define WIFI_CACHE_NVS_NAMESPACE "awcms"
+#define WIFI_CACHE_NVS_KEY "wifi"
+#define WIFI_CACHE_SCHEMA_VERSION 2
+
+// ============================================
+// Connectivity Types
+// ============================================
+
+enum ConnState {
+  CONN_CONNECTING, // Attempt in progress
+  CONN_CONNECTED,  // Station has an IP
+  CONN_BACKOFF     // Waiting before the next attempt
+};
+
+// Transitions reported to the caller of updateConnectivity()
+enum ConnEvent {
+  CONN_EVENT_NONE,
+  CONN_EVENT_UP,   // Station got an IP
+  CONN_EVENT_DOWN, // Station lost its connection
+  CONN_EVENT_AP_UP // Fallback access point started
+};
+
+struct WiFiCache {
+  uint16_t schema;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint8_t reuses; // Connects on the cached address since the last DHCP
+};
+
+// ============================================
+// Connectivity Variables
+// ============================================
+WiFiCache wifiCache;
+bool wifiCacheValid = false;
+bool wifiFastAttempt = false;  // Attempt in progress uses the cache
+bool wifiStaticIp = false;     // Current attempt/link uses the cached address
+bool wifiForceDhcp = false;    // Next attempt asks DHCP even when cached
+bool wifiLeaseSuspect = false; // Backend unreachable on the cached address
+
+ConnState connState = CONN_BACKOFF;
+unsigned long connStateSince = 0;
+unsigned long connBackoffDelay = 0;
+unsigned long connOfflineSince = 0;
+uint32_t connFailures = 0;  // Consecutive failed attempts
+uint32_t connReconnects = 0; // Link recoveries since boot
+uint8_t connLastReason = 0;  // Last disconnect reason code
+
+bool apFallbackActive = false;
+DNSServer apDnsServer;
+
+// Set from the WiFi event task, consumed in updateConnectivity()
+volatile bool wifiEvtGotIp = false;
+volatile bool wifiEvtDisconnected = false;
+volatile uint8_t wifiEvtReason = 0;
+
+// ============================================
+// Connectivity Functions
+// ============================================
+
+/**
+ * Load cached BSSID/channel/IP from NVS
+ */
+bool loadWiFiCache() {
+  Preferences prefs;
+  if (!prefs.begin(WIFI_CACHE_NVS_NAMESPACE, true)) {
+    return false;
+  }
+
+  wifiCacheValid =
+      prefs.getBytesLength(WIFI_CACHE_NVS_KEY) == sizeof(wifiCache) &&
+      prefs.getBytes(WIFI_CACHE_NVS_KEY, &wifiCache, sizeof(wifiCache)) ==
+          sizeof(wifiCache) &&
+      wifiCache.schema == WIFI_CACHE_SCHEMA_VERSION && wifiCache.channel > 0;
+  prefs.end();
+  return wifiCacheValid;
+}
+
+/**
+ * Store the current connection in NVS, only when it changed
+ */
+void saveWiFiCache() {
+  WiFiCache current;
+  memset(&current, 0, sizeof(current));
+  current.schema = WIFI_CACHE_SCHEMA_VERSION;
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.channel = WiFi.channel();
+  current.ip = WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.subnet = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP();
+  current.reuses = wifiStaticIp ? wifiCache.reuses + 1 : 0;
+
+  if (wifiCacheValid && memcmp(&current, &wifiCache, sizeof(current)) == 0) {
+    return;
+  }
+
+  Preferences prefs;
+  if (prefs.begin(WIFI_CACHE_NVS_NAMESPACE, false)) {
+    prefs.putBytes(WIFI_CACHE_NVS_KEY, &current, sizeof(current));
+    prefs.end();
+    wifiCache = current;
+    wifiCacheValid = true;
+    DEBUG_PRINTF("WiFi cache saved (channel %d)\n", (int)current.channel);
+  }
+}
+
+/**
+ * Forget the cached connection (AP moved, lease changed, ...)
+ */
+void clearWiFiCache() {
+  Preferences prefs;
+  if (prefs.begin(WIFI_CACHE_NVS_NAMESPACE, false)) {
+    prefs.remove(WIFI_CACHE_NVS_KEY);
+    prefs.end();
+  }
+  wifiCacheValid = false;
+}
+
+/**
+ * WiFi event handler, runs on the WiFi event task
+ */
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    wifiEvtGotIp = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    // Reason 8 (ASSOC_LEAVE) is our own WiFi.disconnect()
+    if (info.wifi_sta_disconnected.reason == 8) {
+      break;
+    }
+    wifiEvtReason = info.wifi_sta_disconnected.reason;
+    wifiEvtDisconnected = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+    wifiEvtDisconnected = true;
+    break;
+  default:
+    return;
+  }
+  wakeLoop(); // loop() acts on the flags
+}
+
+/**
+ * Switch connectivity state
+ */
+void setConnState(ConnState state) {
+  connState = state;
+  connStateSince = millis();
+}
+
+/**
+ * Start one station connect attempt
+ * Tries the cached BSSID/channel/IP first, then a full scan with DHCP.
+ * The cached IP is skipped once its lease is used up.
+ */
+void startWiFiAttempt() {
+  wifiEvtGotIp = false;
+  wifiEvtDisconnected = false;
+  wifiFastAttempt = wifiCacheValid;
+  wifiStaticIp = wifiFastAttempt && WIFI_CACHE_STATIC_IP && !wifiForceDhcp &&
+                 wifiCache.reuses < WIFI_LEASE_MAX_REUSE;
+
+  if (wifiStaticIp) {
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0),
+                IPAddress((uint32_t)0));
+  }
+
+  if (wifiFastAttempt) {
+    DEBUG_PRINTF("Connecting to WiFi: %s (cached channel %d, %s)\n",
+                 WIFI_SSID, (int)wifiCache.channel,
+                 wifiStaticIp ? "cached IP" : "DHCP");
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
+  } else {
+    DEBUG_PRINTF("Connecting to WiFi: %s\n", WIFI_SSID);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  }
+
+  setConnState(CONN_CONNECTING);
+}
+
+/**
+ * Report whether the first backend request on a new link got through
+ * A failure on the cached address may be a lease the router has since
+ * given away, so the link is redone with DHCP
+ */
+void confirmWiFiLease(bool backendReached) {
+  if (wifiStaticIp && !backendReached) {
+    wifiLeaseSuspect = true;
+  }
+}
+
+/**
+ * Schedule the next attempt after a failure
+ * Jittered exponential backoff keeps a fleet from retrying in step
+ * after a shared router reboot
+ */
+void scheduleWiFiRetry() {
+  WiFi.disconnect();
+
+  if (wifiFastAttempt) {
+    // Cached path failed, rescan straight away
+    DEBUG_PRINTLN("Cached WiFi connect failed, scanning");
+    clearWiFiCache();
+    connBackoffDelay = 0;
+  } else {
+    unsigned long ceiling = WIFI_BACKOFF_MIN;
+    for (uint32_t i = 1; i < connFailures && ceiling < WIFI_BACKOFF_MAX; i++) {
+      ceiling *= 2;
+    }
+    if (ceiling > WIFI_BACKOFF_MAX) {
+      ceiling = WIFI_BACKOFF_MAX;
+    }
+    connBackoffDelay = ceiling / 2 + esp_random() % (ceiling / 2 + 1);
+    DEBUG_PRINTF("WiFi retry in %lu ms (attempt %u, reason %u)\n",
+                 connBackoffDelay, (unsigned)connFailures,
+                 (unsigned)connLastReason);
+  }
+
+  setConnState(CONN_BACKOFF);
+}
+
+/**
+ * Open the local access point so the dashboard stays reachable
+ */
+bool startAPFallback() {
+  String ssid = String(WIFI_AP_SSID_PREFIX) + DEVICE_ID;
+  const char *password = strlen(WIFI_AP_PASSWORD) >= 8 ? WIFI_AP_PASSWORD : NULL;
+
+  WiFi.mode(WIFI_AP_STA);
+  if (!WiFi.softAP(ssid.c_str(), password)) {
+    DEBUG_PRINTLN("Fallback AP failed to start");
+    return false;
+  }
+
+  // Answer every DNS query with our own address (captive portal)
+  apDnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
+  apFallbackActive = true;
+
+  DEBUG_PRINTF("Fallback AP %s started, dashboard at http://%s/\n",
+               ssid.c_str(), WiFi.softAPIP().toString().c_str());
+  return true;
+}
+
+/**
+ * Close the fallback access point once the station is back
+ */
+void stopAPFallback() {
+  apDnsServer.stop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+  apFallbackActive = false;
+  DEBUG_PRINTLN("Fallback AP stopped");
+}
+
+/**
+ * Start WiFi in the background, returns immediately
+ */
+void beginWiFi() {
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false); // Reconnects are driven by the state machine
+  WiFi.mode(WIFI_STA);
+  WiFi.onEvent(onWiFiEvent);
+
+  loadWiFiCache();
+  connOfflineSince = millis();
+  startWiFiAttempt();
+}
+
+/**
+ * Drive the connectivity state machine, call from loop()
+ * Never blocks; returns the transition that happened, if any
+ */
+ConnEvent updateConnectivity() {
+  if (apFallbackActive) {
+    apDnsServer.processNextRequest();
+  }
+
+  // Latch events from the WiFi task
+  bool gotIp = wifiEvtGotIp;
+  bool disconnected = wifiEvtDisconnected;
+  wifiEvtGotIp = false;
+  wifiEvtDisconnected = false;
+  if (disconnected) {
+    connLastReason = wifiEvtReason;
+  }
+
+  unsigned long now = millis();
+
+  switch (connState) {
+  case CONN_CONNECTING: {
+    if (gotIp && WiFi.status() == WL_CONNECTED) {
+      if (bootMetrics.wifiConnectedMs != 0) {
+        connReconnects++;
+      } else {
+        markBootMilestone(bootMetrics.wifiConnectedMs);
+        bootMetrics.wifiFastConnect = wifiFastAttempt;
+      }
+
+      DEBUG_PRINT("Connected! IP: ");
+      DEBUG_PRINTLN(WiFi.localIP());
+      saveWiFiCache();
+      if (!wifiStaticIp) {
+        wifiForceDhcp = false;
+      }
+      // The attempt is over; a later drop of this link is not a failed
+      // cached connect and must keep the cache
+      wifiFastAttempt = false;
+
+      connFailures = 0;
+      connOfflineSince = 0;
+      setConnState(CONN_CONNECTED);
+
+      if (apFallbackActive) {
+        stopAPFallback();
+      }
+      return CONN_EVENT_UP;
+    }
+
+    unsigned long timeout = wifiFastAttempt ? WIFI_FAST_TIMEOUT : WIFI_TIMEOUT;
+    if (disconnected || now - connStateSince > timeout) {
+      connFailures++;
+      scheduleWiFiRetry();
+    }
+    break;
+  }
+
+  case CONN_CONNECTED:
+    if (disconnected || WiFi.status() != WL_CONNECTED) {
+      DEBUG_PRINTF("WiFi disconnected (reason %u)\n", (unsigned)connLastReason);
+      connOfflineSince = now;
+      connFailures = 1;
+      scheduleWiFiRetry();
+      return CONN_EVENT_DOWN;
+    }
+    if (wifiStaticIp &&
+        (wifiLeaseSuspect || now - connStateSince >= WIFI_LEASE_TTL)) {
+      DEBUG_PRINTF("Cached IP %s, renewing with DHCP\n",
+                   wifiLeaseSuspect ? "unreachable" : "expired");
+      wifiLeaseSuspect = false;
+      wifiForceDhcp = true;
+      connOfflineSince = now;
+      WiFi.disconnect();
+      startWiFiAttempt();
+      return CONN_EVENT_DOWN;
+    }
+    break;
+
+  case CONN_BACKOFF:
+    if (now - connStateSince >= connBackoffDelay) {
+      startWiFiAttempt();
+    }
+    break;
+  }
+
+  if (!apFallbackActive && connState != CONN_CONNECTED &&
+      now - connOfflineSince >= WIFI_AP_FALLBACK_DELAY && startAPFallback()) {
+    return CONN_EVENT_AP_UP;
+  }
+
+  return CONN_EVENT_NONE;
+}
+
+/**
+ * Check whether the station currently has an IP
+ */
+bool isWiFiConnected() { return connState == CONN_CONNECTED; }
+
+/**
+ * Get connectivity state name
+ */
+const char *getConnStateName() {
+  switch (connState) {
+  case CONN_CONNECTING:
+    return "connecting";
+  case CONN_CONNECTED:
+    return "connected";
+  default:
+    return "backoff";
+  }
+}
+
+/**
+ * Add connectivity state to a metrics JSON object
+ */
+void addConnectivityJSON(JsonObject conn) {
+  conn["state"] = getConnStateName();
+  conn["ap_fallback"] = apFallbackActive;
+  conn["failures"] = connFailures;
+  conn["reconnects"] = connReconnects;
+  conn["last_reason"] = connLastReason;
+  conn["cached_ip"] = wifiStaticIp;
+  conn["offline_ms"] = connOfflineSince ? millis() - connOfflineSince : 0;
+}
+
+#endif // CONNECTIVITY_H
@@ -0,0 +1,348 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Delta Patch Engine
+ *
+ * Rebuilds a firmware image from the running one plus a binary delta,
+ * streaming: the patch is fed in whatever chunks the network delivers and
+ * the target is written out in order, so RAM stays at sizeof(DeltaPatch)
+ * whatever the image size. Patches are made by scripts/make_delta.py.
+ *
+ *   Header     80 bytes (DeltaHeader), covered by the signature
+ *   Signature  uint16 length, then a DER signature of the header
+ *              (SHA-256, ECDSA or RSA), length 0 when unsigned
+ *   Ops until targetSize bytes are written:
+ *     0x01 COPY  varint zigzag(source offset - end of previous copy),
+ *                varint length; bytes from the source image
+ *     0x02 DATA  varint length, then that many literal bytes
+ *
+ * Integers are little endian, varints LEB128. The target's SHA-256 is
+ * checked against the header once the last byte is written. No Arduino
+ * dependencies; the host tool is bench/delta_tool.cpp.
+ */
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include "sha256.h"
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// Delta Patch Configuration
+// ============================================
+
+#define DELTA_MAGIC 0x50445741UL // "AWDP"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 80
+
+#define DELTA_OP_COPY 0x01
+#define DELTA_OP_DATA 0x02
+
+// Largest signature accepted (RSA-2048 is 256 bytes, ECDSA P-256 ~72)
+#ifndef DELTA_SIG_MAX
+#define DELTA_SIG_MAX 256
+#endif
+
+// Source bytes read per step of a COPY
+#ifndef DELTA_COPY_CHUNK
+#define DELTA_COPY_CHUNK 1024
+#endif
+
+// ============================================
+// Delta Patch Types
+// ============================================
+
+struct DeltaHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t sourceSize;
+  uint32_t targetSize;
+  uint8_t sourceSha[SHA256_SIZE];
+  uint8_t targetSha[SHA256_SIZE];
+};
+
+enum DeltaState {
+  DELTA_HEADER,
+  DELTA_SIG_LEN,
+  DELTA_SIG,
+  DELTA_OP,
+  DELTA_ARG,
+  DELTA_DATA,
+  DELTA_DONE,
+  DELTA_FAILED
+};
+
+struct DeltaPatch;
+
+// Read len source bytes at offset
+typedef bool (*DeltaReadFn)(void *ctx, uint32_t offset, uint8_t *buf,
+                            size_t len);
+// Append target bytes
+typedef bool (*DeltaWriteFn)(void *ctx, const uint8_t *buf, size_t len);
+// Header and signature received: NULL to go on, or why the patch is
+// refused (nothing has been written yet)
+typedef const char *(*DeltaHeaderFn)(void *ctx, const DeltaPatch &patch);
+
+struct DeltaPatch {
+  DeltaState state;
+  DeltaHeader header;
+  uint8_t headerRaw[DELTA_HEADER_SIZE]; // As received, for the signature
+  uint16_t sigLen;
+  uint8_t sig[DELTA_SIG_MAX];
+  size_t have; // Bytes collected for the current field
+
+  // Op being decoded
+  uint8_t op;
+  uint8_t argIndex;
+  uint8_t argShift;
+  uint32_t arg;
+  uint32_t args[2];
+  uint32_t remaining; // Literal bytes left in a DATA op
+
+  uint32_t copyEnd; // Source offset after the previous COPY
+  uint32_t received;
+  uint32_t written;
+  Sha256 sha;
+  const char *error;
+
+  DeltaReadFn readSource;
+  DeltaWriteFn writeTarget;
+  DeltaHeaderFn onHeader;
+  void *ctx;
+  uint8_t buf[DELTA_COPY_CHUNK];
+};
+
+// ============================================
+// Delta Patch Functions
+// ============================================
+
+void deltaBegin(DeltaPatch &p, DeltaReadFn readSource, DeltaWriteFn writeTarget,
+                DeltaHeaderFn onHeader, void *ctx) {
+  memset(&p, 0, sizeof(p));
+  p.state = DELTA_HEADER;
+  p.readSource = readSource;
+  p.writeTarget = writeTarget;
+  p.onHeader = onHeader;
+  p.ctx = ctx;
+  sha256Init(p.sha);
+}
+
+bool deltaFail(DeltaPatch &p, const char *error) {
+  p.state = DELTA_FAILED;
+  p.error = error;
+  return false;
+}
+
+/**
+ * Hash and write target bytes
+ */
+bool deltaEmit(DeltaPatch &p, const uint8_t *data, size_t len) {
+  if (len > p.header.targetSize - p.written) {
+    return deltaFail(p, "patch writes past the target size");
+  }
+  sha256Update(p.sha, data, len);
+  if (!p.writeTarget(p.ctx, data, len)) {
+    return deltaFail(p, "target write failed");
+  }
+  p.written += len;
+  return true;
+}
+
+/**
+ * Target complete: check its hash
+ */
+bool deltaFinish(DeltaPatch &p) {
+  uint8_t digest[SHA256_SIZE];
+  sha256Final(p.sha, digest);
+  if (memcmp(digest, p.header.targetSha, SHA256_SIZE) != 0) {
+    return deltaFail(p, "target hash mismatch");
+  }
+  p.state = DELTA_DONE;
+  return true;
+}
+
+/**
+ * Run a fully decoded COPY
+ */
+bool deltaCopy(DeltaPatch &p) {
+  int32_t delta = (int32_t)(p.args[0] >> 1) ^ -(int32_t)(p.args[0] & 1);
+  uint32_t offset = p.copyEnd + delta;
+  uint32_t len = p.args[1];
+  if (offset > p.header.sourceSize || len > p.header.sourceSize - offset) {
+    return deltaFail(p, "copy outside the source image");
+  }
+
+  p.copyEnd = offset + len;
+  while (len > 0) {
+    size_t step = len < DELTA_COPY_CHUNK ? len : DELTA_COPY_CHUNK;
+    if (!p.readSource(p.ctx, offset, p.buf, step)) {
+      return deltaFail(p, "source read failed");
+    }
+    if (!deltaEmit(p, p.buf, step)) {
+      return false;
+    }
+    offset += step;
+    len -= step;
+  }
+  return true;
+}
+
+/**
+ * Next op, or the end of the patch
+ */
+bool deltaNextOp(DeltaPatch &p) {
+  if (p.written == p.header.targetSize) {
+    return deltaFinish(p);
+  }
+  p.state = DELTA_OP;
+  return true;
+}
+
+/**
+ * Header fields are complete
+ */
+bool deltaHeaderReady(DeltaPatch &p) {
+  memcpy(&p.header, p.headerRaw, sizeof(p.header));
+  if (p.header.magic != DELTA_MAGIC) {
+    return deltaFail(p, "not a delta patch");
+  }
+  if (p.header.version != DELTA_VERSION) {
+    return deltaFail(p, "unsupported patch version");
+  }
+  p.have = 0;
+  p.state = DELTA_SIG_LEN;
+  return true;
+}
+
+/**
+ * Feed the next len bytes of the patch
+ * Returns false once the patch failed (see p.error)
+ */
+bool deltaFeed(DeltaPatch &p, const uint8_t *data, size_t len) {
+  p.received += len;
+  while (len > 0) {
+    switch (p.state) {
+    case DELTA_HEADER: {
+      size_t take = DELTA_HEADER_SIZE - p.have;
+      take = take < len ? take : len;
+      memcpy(p.headerRaw + p.have, data, take);
+      p.have += take;
+      data += take;
+      len -= take;
+      if (p.have == DELTA_HEADER_SIZE && !deltaHeaderReady(p)) {
+        return false;
+      }
+      break;
+    }
+
+    case DELTA_SIG_LEN:
+      p.sigLen |= (uint16_t)*data++ << (8 * p.have++);
+      len--;
+      if (p.have == 2) {
+        if (p.sigLen > DELTA_SIG_MAX) {
+          return deltaFail(p, "signature too long");
+        }
+        p.have = 0;
+        p.state = DELTA_SIG;
+      }
+      break;
+
+    case DELTA_SIG: {
+      size_t take = p.sigLen - p.have;
+      take = take < len ? take : len;
+      memcpy(p.sig + p.have, data, take);
+      p.have += take;
+      data += take;
+      len -= take;
+      break;
+    }
+
+    case DELTA_OP:
+      p.op = *data++;
+      len--;
+      if (p.op != DELTA_OP_COPY && p.op != DELTA_OP_DATA) {
+        return deltaFail(p, "unknown op");
+      }
+      p.argIndex = 0;
+      p.argShift = 0;
+      p.arg = 0;
+      p.state = DELTA_ARG;
+      break;
+
+    case DELTA_ARG: {
+      uint8_t byte = *data++;
+      len--;
+      if (p.argShift > 28) {
+        return deltaFail(p, "varint too long");
+      }
+      p.arg |= (uint32_t)(byte & 0x7F) << p.argShift;
+      p.argShift += 7;
+      if (byte & 0x80) {
+        break;
+      }
+
+      p.args[p.argIndex++] = p.arg;
+      p.arg = 0;
+      p.argShift = 0;
+      if (p.op == DELTA_OP_DATA) {
+        p.remaining = p.args[0];
+        p.state = DELTA_DATA;
+        if (p.remaining == 0 && !deltaNextOp(p)) {
+          return false;
+        }
+      } else if (p.argIndex == 2 && (!deltaCopy(p) || !deltaNextOp(p))) {
+        return false;
+      }
+      break;
+    }
+
+    case DELTA_DATA: {
+      size_t take = p.remaining < len ? p.remaining : len;
+      if (!deltaEmit(p, data, take)) {
+        return false;
+      }
+      p.remaining -= take;
+      data += take;
+      len -= take;
+      if (p.remaining == 0 && !deltaNextOp(p)) {
+        return false;
+      }
+      break;
+    }
+
+    case DELTA_DONE:
+      return deltaFail(p, "data after the end of the patch");
+
+    case DELTA_FAILED:
+      return false;
+    }
+
+    // Header and signature in: let the caller check them before any write
+    if (p.state == DELTA_SIG && p.have == p.sigLen) {
+      const char *refused = p.onHeader ? p.onHeader(p.ctx, p) : NULL;
+      if (refused) {
+        return deltaFail(p, refused);
+      }
+      p.have = 0;
+      if (!deltaNextOp(p)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * SHA-256 of the signed header bytes
+ */
+void deltaHeaderHash(const DeltaPatch &p, uint8_t digest[SHA256_SIZE]) {
+  Sha256 sha;
+  sha256Init(sha);
+  sha256Update(sha, p.headerRaw, DELTA_HEADER_SIZE);
+  sha256Final(sha, digest);
+}
+
+bool deltaFinished(const DeltaPatch &p) { return p.state == DELTA_DONE; }
+
+#endif // DELTA_PATCH_H
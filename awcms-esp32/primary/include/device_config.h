@@ -0,0 +1,246 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Runtime Device Configuration
+ *
+ * Intervals, gas thresholds, the upload transport and the default
+ * language that can change without reflashing.
+ * Defaults come from config.h, are overridden by the copy cached in NVS
+ * at boot, and are refreshed from Supabase (devices.config) at runtime.
+ */
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include "anomaly.h"
+#include "config.h"
+#include "i18n.h"
+#include "mem_pools.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+// ============================================
+// Device Config Defaults
+// ============================================
+
+#ifndef CONFIG_REFRESH_INTERVAL
+#define CONFIG_REFRESH_INTERVAL 300000
+#endif
+
+#ifndef GAS_PPM_ELEVATED
+#define GAS_PPM_ELEVATED 200
+#endif
+
+#ifndef GAS_PPM_WARNING
+#define GAS_PPM_WARNING 500
+#endif
+
+#ifndef GAS_PPM_DANGER
+#define GAS_PPM_DANGER 1000
+#endif
+
+// Upload transport, overridable with devices.config "transport"
+#define TRANSPORT_REST 0
+#define TRANSPORT_MQTT 1
+
+#ifndef SYNC_TRANSPORT
+#define SYNC_TRANSPORT TRANSPORT_REST
+#endif
+
+// NVS namespace and key for the cached config
+#define CONFIG_NVS_NAMESPACE "awcms"
+#define CONFIG_NVS_KEY "config"
+
+// Bump when DeviceConfig changes layout, invalidates the NVS copy
+#define CONFIG_SCHEMA_VERSION 4
+
+// ============================================
+// Device Config Types
+// ============================================
+
+struct DeviceConfig {
+  uint16_t schema;
+  uint32_t sensorReadInterval;    // ms
+  uint32_t dataSyncInterval;      // ms
+  uint32_t configRefreshInterval; // ms
+  float ppmElevated;
+  float ppmWarning;
+  float ppmDanger;
+  AnomalyParams anomaly;
+  uint8_t transport;  // TRANSPORT_REST or TRANSPORT_MQTT
+  uint8_t language;   // Index into languages[] (i18n.h)
+  char updatedAt[40]; // devices.updated_at of the applied config, "" = none
+};
+
+// ============================================
+// Device Config Variables
+// ============================================
+DeviceConfig deviceConfig;
+unsigned long lastConfigRefresh = 0;
+
+// ============================================
+// Device Config Functions
+// ============================================
+
+/**
+ * Reset configuration to compile-time defaults
+ */
+void setDefaultDeviceConfig() {
+  memset(&deviceConfig, 0, sizeof(deviceConfig));
+  deviceConfig.schema = CONFIG_SCHEMA_VERSION;
+  deviceConfig.sensorReadInterval = SENSOR_READ_INTERVAL;
+  deviceConfig.dataSyncInterval = DATA_SYNC_INTERVAL;
+  deviceConfig.configRefreshInterval = CONFIG_REFRESH_INTERVAL;
+  deviceConfig.ppmElevated = GAS_PPM_ELEVATED;
+  deviceConfig.ppmWarning = GAS_PPM_WARNING;
+  deviceConfig.ppmDanger = GAS_PPM_DANGER;
+  deviceConfig.anomaly = anomalyDefaultParams();
+  deviceConfig.transport = SYNC_TRANSPORT;
+  int language = findLanguage(DEVICE_LANGUAGE);
+  deviceConfig.language = language >= 0 ? language : 0;
+}
+
+/**
+ * Persist current configuration to NVS
+ */
+bool saveDeviceConfig() {
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, false)) {
+    return false;
+  }
+  size_t written =
+      prefs.putBytes(CONFIG_NVS_KEY, &deviceConfig, sizeof(deviceConfig));
+  prefs.end();
+  return written == sizeof(deviceConfig);
+}
+
+/**
+ * Load configuration at boot: defaults, then the NVS copy if valid
+ */
+void loadDeviceConfig() {
+  setDefaultDeviceConfig();
+
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, true)) {
+    return;
+  }
+
+  DeviceConfig cached;
+  if (prefs.getBytesLength(CONFIG_NVS_KEY) == sizeof(cached) &&
+      prefs.getBytes(CONFIG_NVS_KEY, &cached, sizeof(cached)) == sizeof(cached) &&
+      cached.schema == CONFIG_SCHEMA_VERSION) {
+    cached.updatedAt[sizeof(cached.updatedAt) - 1] = '\0';
+    deviceConfig = cached;
+    DEBUG_PRINTF("Config loaded from NVS (updated_at: %s)\n",
+                 deviceConfig.updatedAt[0] ? deviceConfig.updatedAt : "none");
+  }
+  prefs.end();
+}
+
+/**
+ * Read an interval field, keeping the current value when out of range
+ */
+uint32_t configInterval(JsonVariantConst value, uint32_t current,
+                        uint32_t minMs, uint32_t maxMs) {
+  if (!value.is<uint32_t>()) {
+    return current;
+  }
+  uint32_t ms = value.as<uint32_t>();
+  return (ms >= minMs && ms <= maxMs) ? ms : current;
+}
+
+/**
+ * Apply a devices.config JSON object on top of the current configuration
+ * Unknown keys are ignored, invalid values keep the current setting
+ */
+void applyDeviceConfigJSON(JsonObjectConst config) {
+  deviceConfig.sensorReadInterval =
+      configInterval(config["sensor_read_interval"],
+                     deviceConfig.sensorReadInterval, 100, 3600000);
+  deviceConfig.dataSyncInterval = configInterval(
+      config["data_sync_interval"], deviceConfig.dataSyncInterval, 5000,
+      86400000);
+  deviceConfig.configRefreshInterval =
+      configInterval(config["config_refresh_interval"],
+                     deviceConfig.configRefreshInterval, 10000, 86400000);
+
+  float elevated = config["ppm_elevated"] | deviceConfig.ppmElevated;
+  float warning = config["ppm_warning"] | deviceConfig.ppmWarning;
+  float danger = config["ppm_danger"] | deviceConfig.ppmDanger;
+  if (elevated > 0 && elevated < warning && warning < danger) {
+    deviceConfig.ppmElevated = elevated;
+    deviceConfig.ppmWarning = warning;
+    deviceConfig.ppmDanger = danger;
+  }
+
+  // Anomaly detector tuning, 0 disables a check
+  AnomalyParams &anomaly = deviceConfig.anomaly;
+  float slope = config["anomaly_slope_limit"] | anomaly.slopeLimit;
+  float alpha = config["anomaly_ewma_alpha"] | anomaly.ewmaAlpha;
+  float cusumK = config["anomaly_cusum_k"] | anomaly.cusumK;
+  float cusumH = config["anomaly_cusum_h"] | anomaly.cusumH;
+  if (slope >= 0) {
+    anomaly.slopeLimit = slope;
+  }
+  if (alpha > 0 && alpha < 1) {
+    anomaly.ewmaAlpha = alpha;
+  }
+  if (cusumK >= 0 && cusumH >= 0) {
+    anomaly.cusumK = cusumK;
+    anomaly.cusumH = cusumH;
+  }
+  anomaly.holdoffMs = configInterval(config["anomaly_holdoff"],
+                                     anomaly.holdoffMs, 0, 3600000);
+
+  const char *transport = config["transport"] | "";
+  if (strcmp(transport, "rest") == 0) {
+    deviceConfig.transport = TRANSPORT_REST;
+  } else if (strcmp(transport, "mqtt") == 0) {
+    deviceConfig.transport = TRANSPORT_MQTT;
+  }
+
+  int language = findLanguage(config["language"] | "");
+  if (language >= 0) {
+    deviceConfig.language = language;
+  }
+}
+
+/**
+ * Language for text with no client preference (alerts, API default)
+ */
+uint8_t deviceLanguage() {
+  return deviceConfig.language < LANGUAGE_COUNT ? deviceConfig.language : 0;
+}
+
+/**
+ * Get current configuration as JSON
+ */
+String getDeviceConfigJSON() {
+  JsonDocument doc(&jsonWebPool);
+
+  doc["sensor_read_interval"] = deviceConfig.sensorReadInterval;
+  doc["data_sync_interval"] = deviceConfig.dataSyncInterval;
+  doc["config_refresh_interval"] = deviceConfig.configRefreshInterval;
+  doc["ppm_elevated"] = deviceConfig.ppmElevated;
+  doc["ppm_warning"] = deviceConfig.ppmWarning;
+  doc["ppm_danger"] = deviceConfig.ppmDanger;
+  doc["anomaly_slope_limit"] = deviceConfig.anomaly.slopeLimit;
+  doc["anomaly_ewma_alpha"] = deviceConfig.anomaly.ewmaAlpha;
+  doc["anomaly_cusum_k"] = deviceConfig.anomaly.cusumK;
+  doc["anomaly_cusum_h"] = deviceConfig.anomaly.cusumH;
+  doc["anomaly_holdoff"] = deviceConfig.anomaly.holdoffMs;
+  doc["transport"] =
+      deviceConfig.transport == TRANSPORT_MQTT ? "mqtt" : "rest";
+  doc["language"] = languages[deviceLanguage()].code;
+  if (deviceConfig.updatedAt[0]) {
+    doc["updated_at"] = deviceConfig.updatedAt;
+  } else {
+    doc["updated_at"] = nullptr;
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+#endif // DEVICE_CONFIG_H
@@ -0,0 +1,270 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Duty Cycle
+ *
+ * loop() no longer spins every 10 ms. It works out its next deadline
+ * (sample, sync, config refresh, outbox retry) and blocks on a task
+ * notification until then. The power manager drops the CPU clock and
+ * enters automatic light sleep while every task is blocked, and WiFi
+ * stays associated in modem sleep. Anything that needs loop() earlier
+ * wakes it with dutyWake(): WiFi events, rules posted over HTTP and
+ * finished jobs (through wakeLoop(), loop_wake.h), and the MQ module's
+ * comparator output (GAS_ALARM_PIN). That output samples
+ * right away, so alarms are never later than with the busy loop.
+ */
+
+#ifndef DUTY_CYCLE_H
+#define DUTY_CYCLE_H
+
+#include "config.h"
+#include "gas_sensor.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <hal/gpio_ll.h>
+
+// ============================================
+// Duty Cycle Configuration
+// ============================================
+
+// false = the old fixed 10 ms loop
+#ifndef DUTY_CYCLE_ENABLED
+#define DUTY_CYCLE_ENABLED true
+#endif
+
+// The camera's XCLK stops in light sleep and streaming suffers under
+// modem sleep, so ESP32-CAM builds keep both off unless asked
+#ifndef DUTY_LIGHT_SLEEP
+#ifdef ENABLE_CAMERA
+#define DUTY_LIGHT_SLEEP false
+#else
+#define DUTY_LIGHT_SLEEP true
+#endif
+#endif
+
+#ifndef DUTY_MODEM_SLEEP
+#ifdef ENABLE_CAMERA
+#define DUTY_MODEM_SLEEP false
+#else
+#define DUTY_MODEM_SLEEP true
+#endif
+#endif
+
+#ifndef DUTY_CPU_MIN_MHZ
+#define DUTY_CPU_MIN_MHZ 80
+#endif
+
+// Longest block even with nothing due: bounds polling of the WiFi state
+// machine, history flushes and OTA bookkeeping
+#ifndef DUTY_MAX_SLEEP
+#define DUTY_MAX_SLEEP 1000 // ms
+#endif
+
+#define GAS_ALARM_EDGE                                                         \
+  (GAS_ALARM_ACTIVE_LOW ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE)
+#define GAS_ALARM_LEVEL                                                        \
+  (GAS_ALARM_ACTIVE_LOW ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL)
+
+// ============================================
+// Duty Cycle Types
+// ============================================
+
+struct DutyStats {
+  uint32_t wakeups;      // Total loop() wakeups
+  uint32_t earlyWakeups; // Woken by dutyWake() before the deadline
+  uint32_t alarmWakeups;
+  uint64_t activeUs; // Time loop() spent working
+  uint64_t totalUs;
+  // Last full minute
+  uint32_t windowStart;
+  uint32_t windowWakeups;
+  uint64_t windowActiveUs;
+  uint16_t lastWakeupsPerMin;
+  float lastActivePct;
+};
+
+// ============================================
+// Duty Cycle Variables
+// ============================================
+TaskHandle_t dutyLoopTask = NULL;
+DutyStats dutyStats = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+uint32_t dutyWorkStartUs = 0;
+bool dutyLightSleep = false; // Power manager accepted light sleep
+volatile bool gasAlarmPending = false;
+
+// ============================================
+// Duty Cycle Functions
+// ============================================
+
+/**
+ * Wake loop() before its deadline, from any task
+ */
+void dutyWake() {
+  if (dutyLoopTask) {
+    xTaskNotifyGive(dutyLoopTask);
+  }
+}
+
+void IRAM_ATTR gasAlarmISR() {
+  // Fired by the light sleep level wakeup: back to the edge, or it would
+  // fire for as long as gas is present
+  if (GAS_ALARM_PIN >= 0) {
+    gpio_ll_set_intr_type(&GPIO, (gpio_num_t)GAS_ALARM_PIN, GAS_ALARM_EDGE);
+  }
+  gasAlarmPending = true;
+  BaseType_t woken = pdFALSE;
+  if (dutyLoopTask) {
+    vTaskNotifyGiveFromISR(dutyLoopTask, &woken);
+  }
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/**
+ * Set up power management and wake sources, call at the end of setup()
+ * (runs on the loop task, whose handle is kept for dutyWake())
+ */
+void initDutyCycle() {
+  dutyLoopTask = xTaskGetCurrentTaskHandle();
+  dutyWorkStartUs = micros();
+  dutyStats.windowStart = millis();
+
+  if (GAS_ALARM_PIN >= 0) {
+    pinMode(GAS_ALARM_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(GAS_ALARM_PIN), gasAlarmISR,
+                    GAS_ALARM_ACTIVE_LOW ? FALLING : RISING);
+  }
+  if (!DUTY_CYCLE_ENABLED) {
+    return;
+  }
+
+  WiFi.setSleep(DUTY_MODEM_SLEEP);
+
+  // Needs CONFIG_PM_ENABLE; light sleep also needs tickless idle. Without
+  // them the loop still blocks, just without lowering power as far
+  esp_pm_config_esp32_t pm = {(int)getCpuFrequencyMhz(), DUTY_CPU_MIN_MHZ,
+                              DUTY_LIGHT_SLEEP};
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK && DUTY_LIGHT_SLEEP) {
+    pm.light_sleep_enable = false;
+    err = esp_pm_configure(&pm);
+  }
+  dutyLightSleep = err == ESP_OK && pm.light_sleep_enable;
+  DEBUG_PRINTF("Power management: %s, light sleep %s\n",
+               err == ESP_OK ? "on" : esp_err_to_name(err),
+               dutyLightSleep ? "on" : "off");
+
+  if (GAS_ALARM_PIN >= 0 && dutyLightSleep) {
+    // The pin itself is armed per wait, see dutyArmAlarmWake()
+    esp_sleep_enable_gpio_wakeup();
+  }
+}
+
+/**
+ * Let the comparator wake light sleep while loop() blocks
+ * Edge interrupts do not wake light sleep; a level wakeup does, but it
+ * replaces the edge trigger, so it is only armed while the output is idle
+ * and the edge is restored by gasAlarmISR() or dutyDisarmAlarmWake()
+ */
+bool dutyArmAlarmWake() {
+  if (GAS_ALARM_PIN < 0 || !dutyLightSleep ||
+      digitalRead(GAS_ALARM_PIN) == (GAS_ALARM_ACTIVE_LOW ? LOW : HIGH)) {
+    return false;
+  }
+  gpio_wakeup_enable((gpio_num_t)GAS_ALARM_PIN, GAS_ALARM_LEVEL);
+  return true;
+}
+
+void dutyDisarmAlarmWake() {
+  gpio_wakeup_disable((gpio_num_t)GAS_ALARM_PIN);
+  gpio_set_intr_type((gpio_num_t)GAS_ALARM_PIN, GAS_ALARM_EDGE);
+}
+
+/**
+ * Take the pending comparator alarm, true once per trigger
+ */
+bool takeGasAlarm() {
+  if (!gasAlarmPending) {
+    return false;
+  }
+  gasAlarmPending = false;
+  dutyStats.alarmWakeups++;
+  return true;
+}
+
+/**
+ * Block until deadline (millis()) or dutyWake(), whichever comes first
+ * Call at the end of loop(); accounts the time loop() was busy
+ */
+void dutyWait(unsigned long deadline) {
+  uint32_t now = micros();
+  uint32_t worked = now - dutyWorkStartUs;
+
+  unsigned long nowMs = millis();
+  long wait = (long)(deadline - nowMs);
+  wait = wait < 0 ? 0 : (wait > DUTY_MAX_SLEEP ? DUTY_MAX_SLEEP : wait);
+
+  bool early = false;
+  if (!DUTY_CYCLE_ENABLED) {
+    delay(10);
+  } else if (wait > 0) {
+    bool armed = dutyArmAlarmWake();
+    early = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)) > 0;
+    if (armed) {
+      dutyDisarmAlarmWake();
+    }
+  } else {
+    // Still due: one tick so the idle task runs and feeds the watchdog
+    ulTaskNotifyTake(pdTRUE, 1);
+  }
+
+  uint32_t woke = micros();
+  dutyStats.wakeups++;
+  dutyStats.earlyWakeups += early ? 1 : 0;
+  dutyStats.activeUs += worked;
+  dutyStats.totalUs += woke - dutyWorkStartUs;
+  dutyStats.windowWakeups++;
+  dutyStats.windowActiveUs += worked;
+  dutyWorkStartUs = woke;
+
+  uint32_t windowMs = millis() - dutyStats.windowStart;
+  if (windowMs >= 60000) {
+    dutyStats.lastWakeupsPerMin =
+        dutyStats.windowWakeups * 60000ULL / windowMs;
+    dutyStats.lastActivePct =
+        dutyStats.windowActiveUs / (windowMs * 10.0f);
+    dutyStats.windowStart = millis();
+    dutyStats.windowWakeups = 0;
+    dutyStats.windowActiveUs = 0;
+  }
+}
+
+/**
+ * Earlier of two deadlines (millis() values, wrap-safe)
+ */
+unsigned long dutyEarliest(unsigned long a, unsigned long b) {
+  return (long)(b - a) < 0 ? b : a;
+}
+
+/**
+ * Add loop activity and wake counters to a metrics JSON object
+ */
+void addDutyJSON(JsonObject duty) {
+  duty["enabled"] = DUTY_CYCLE_ENABLED;
+  duty["light_sleep"] = dutyLightSleep;
+  duty["modem_sleep"] = DUTY_CYCLE_ENABLED && DUTY_MODEM_SLEEP;
+  duty["active_pct"] = dutyStats.lastActivePct;
+  duty["wakeups_per_min"] = dutyStats.lastWakeupsPerMin;
+  duty["active_pct_total"] =
+      dutyStats.totalUs ? 100.0f * dutyStats.activeUs / dutyStats.totalUs
+                        : 0.0f;
+  duty["wakeups"] = dutyStats.wakeups;
+  duty["early_wakeups"] = dutyStats.earlyWakeups;
+  duty["alarm_wakeups"] = dutyStats.alarmWakeups;
+}
+
+#endif // DUTY_CYCLE_H
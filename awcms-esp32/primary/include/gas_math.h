@@ -0,0 +1,87 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Gas Sensor Math (MQ Series)
+ *
+ * ADC to voltage, sensor resistance and per-model PPM curves.
+ * No Arduino dependencies, so it builds on the host as well.
+ */
+
+#ifndef GAS_MATH_H
+#define GAS_MATH_H
+
+#include <math.h>
+#include <stdint.h>
+
+// ============================================
+// Gas Math Configuration
+// ============================================
+
+// Load resistance (kOhms) - check your module
+#define RL_VALUE 10.0
+
+// ADC resolution
+#define ADC_RESOLUTION 4095.0
+#define VOLTAGE_REF 3.3
+
+// ============================================
+// Gas Math Functions
+// ============================================
+
+/**
+ * Convert ADC value to voltage
+ */
+float adcToVoltage(int adcValue) {
+  return (adcValue / ADC_RESOLUTION) * VOLTAGE_REF;
+}
+
+/**
+ * Calculate sensor resistance (Rs)
+ */
+float calculateRs(int adcValue) {
+  float voltage = adcToVoltage(adcValue);
+  if (voltage == 0)
+    return 0;
+
+  // Rs = (Vc * RL) / Vout - RL
+  float rs = ((VOLTAGE_REF * RL_VALUE) / voltage) - RL_VALUE;
+  return rs;
+}
+
+/**
+ * MQ sensitivity curve: PPM = A * (Rs/Ro)^B
+ * Constants are template parameters in thousandths, so each sensor model
+ * compiles to its own specialized conversion.
+ */
+template <uint32_t AMilli, int32_t BMilli, uint32_t CleanAirMilli>
+struct MqCurve {
+  static float ppm(float rsRoRatio) {
+    return (AMilli / 1000.0f) * powf(rsRoRatio, BMilli / 1000.0f);
+  }
+
+  // Rs/Ro in clean air, used for calibration
+  static float cleanAirRatio() { return CleanAirMilli / 1000.0f; }
+};
+
+// ============================================
+// Sensor Models
+// ============================================
+
+// MQ-2, LPG curve (datasheet fit)
+struct MQ2 : MqCurve<574250, -2222, 9830> {
+  static const char *model() { return "MQ-2"; }
+  static const char *gas() { return "LPG"; }
+};
+
+// MQ-135, CO2 curve (datasheet fit)
+struct MQ135 : MqCurve<110470, -2862, 3600> {
+  static const char *model() { return "MQ-135"; }
+  static const char *gas() { return "CO2"; }
+};
+
+// MQ-7, CO curve (datasheet fit)
+struct MQ7 : MqCurve<99042, -1518, 27500> {
+  static const char *model() { return "MQ-7"; }
+  static const char *gas() { return "CO"; }
+};
+
+#endif // GAS_MATH_H
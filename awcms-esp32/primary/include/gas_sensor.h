@@ -2,14 +2,20 @@
  * AWCMS ESP32 IoT Firmware
  * Gas Sensor Module (MQ Series)
  *
- * Supports MQ-2, MQ-135, and other MQ series sensors
- * with calibration and PPM calculation.
+ * Supports MQ-2, MQ-135, MQ-7 and other MQ series sensors side by side,
+ * with calibration and PPM calculation per channel.
  */
 
 #ifndef GAS_SENSOR_H
 #define GAS_SENSOR_H
 
+#include "anomaly.h"
 #include "config.h"
+#include "device_config.h"
+#include "gas_math.h"
+#include "mem_pools.h"
+#include "sensor_registry.h"
+#include "window_stats.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
@@ -17,90 +23,143 @@
 // Gas Sensor Configuration
 // ============================================
 
-// Sensor pin (ADC1 pins only: 32, 33, 34, 35, 36, 39)
+// Default sensor pin (ADC1 pins only: 32, 33, 34, 35, 36, 39)
+#ifndef GAS_SENSOR_PIN
 #define GAS_SENSOR_PIN 34
+#endif
 
-// Clean air ratio (Rs/Ro in clean air)
-// MQ-2: ~9.83, MQ-135: ~3.6
-#define CLEAN_AIR_RATIO 9.83
+// MQ module digital output (comparator on the board), -1 = not wired.
+// Wakes loop() for an instant read, see duty_cycle.h
+#ifndef GAS_ALARM_PIN
+#define GAS_ALARM_PIN -1
+#endif
 
-// Load resistance (kOhms) - check your module
-#define RL_VALUE 10.0
+// Most modules pull DO low above the threshold set by their trimmer
+#ifndef GAS_ALARM_ACTIVE_LOW
+#define GAS_ALARM_ACTIVE_LOW true
+#endif
 
-// ADC resolution
-#define ADC_RESOLUTION 4095.0
-#define VOLTAGE_REF 3.3
+// Installed channels, one MqChannel<pin, model> per sensor.
+// Models live in gas_math.h. Example for a three-sensor board:
+//   #define GAS_SENSOR_CHANNELS MqChannel<34, MQ2>, MqChannel<35, MQ135>,
+//                               MqChannel<33, MQ7>
+#ifndef GAS_SENSOR_CHANNELS
+#define GAS_SENSOR_CHANNELS MqChannel<GAS_SENSOR_PIN, MQ2>
+#endif
+
+typedef GasSensorList<GAS_SENSOR_CHANNELS> GasSensors;
+#define GAS_CHANNEL_COUNT ((size_t)GasSensors::COUNT)
+
+// Channel reported in the flat gas_* fields and the dashboard headline
+#define GAS_PRIMARY_CHANNEL 0
 
 // Calibration samples
 #define CALIBRATION_SAMPLES 50
 #define CALIBRATION_DELAY 500
 
+// Source of raw scans: the ADC, or a recorded trace (see adc_replay.h)
+typedef void (*GasScanSource)(uint16_t *raw);
+
 // ============================================
 // Gas Sensor Variables
 // ============================================
-float Ro = 10.0; // Sensor resistance in clean air (calibrated)
-bool sensorCalibrated = false;
+GasChannelState gasChannels[GAS_CHANNEL_COUNT];
+WindowStats gasWindows[GAS_CHANNEL_COUNT]; // Aggregates since the last sync
+AnomalyDetector gasDetectors[GAS_CHANNEL_COUNT];
+uint8_t gasAnomalies[GAS_CHANNEL_COUNT]; // ANOMALY_* raised by the last scan
 unsigned long lastGasRead = 0;
+volatile bool gasCalibrating = false; // loop() skips readings meanwhile
+GasScanSource gasScanSource = NULL;    // NULL = read the ADC
 
-// Current readings
-float gasRaw = 0;
-float gasPPM = 0;
-float gasVoltage = 0;
+// Calibration handed from the job worker to loop()
+float gasCalibrationRo[GAS_CHANNEL_COUNT];
+volatile bool gasCalibrationPending = false;
+portMUX_TYPE gasCalibrationMux = portMUX_INITIALIZER_UNLOCKED;
 
 // ============================================
 // Gas Sensor Functions
 // ============================================
 
 /**
- * Read raw ADC value from gas sensor
+ * Read every channel in one batched ADC scan
  */
-int readGasSensorRaw() { return analogRead(GAS_SENSOR_PIN); }
+void scanGasChannels(uint16_t *raw) {
+  uint32_t sums[GAS_CHANNEL_COUNT] = {0};
+
+  for (int i = 0; i < GAS_ADC_OVERSAMPLE; i++) {
+    GasSensors::scan(sums);
+  }
+
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    raw[ch] = sums[ch] / GAS_ADC_OVERSAMPLE;
+  }
+}
 
 /**
- * Convert ADC value to voltage
+ * Take one scan from the configured source
  */
-float adcToVoltage(int adcValue) {
-  return (adcValue / ADC_RESOLUTION) * VOLTAGE_REF;
+void scanGas(uint16_t *raw) {
+  if (gasScanSource) {
+    gasScanSource(raw);
+  } else {
+    scanGasChannels(raw);
+  }
 }
 
 /**
- * Calculate sensor resistance (Rs)
+ * Convert one scan into channel readings
  */
-float calculateRs(int adcValue) {
-  float voltage = adcToVoltage(adcValue);
-  if (voltage == 0)
-    return 0;
+void processGasScan(const uint16_t *raw) {
+  GasSensors::convert(raw, gasChannels);
+  lastGasRead = millis();
+
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    windowStatsAdd(gasWindows[ch], gasChannels[ch].ppm, lastGasRead,
+                   deviceConfig.ppmWarning);
+    gasAnomalies[ch] =
+        gasChannels[ch].calibrated
+            ? anomalyUpdate(gasDetectors[ch], deviceConfig.anomaly,
+                            gasChannels[ch].ppm, lastGasRead)
+            : ANOMALY_NONE;
+  }
+}
 
-  // Rs = (Vc * RL) / Vout - RL
-  float rs = ((VOLTAGE_REF * RL_VALUE) / voltage) - RL_VALUE;
-  return rs;
+/**
+ * Restart anomaly detection, e.g. after Ro changed
+ */
+void resetGasDetectors() {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    anomalyReset(gasDetectors[ch]);
+    gasAnomalies[ch] = ANOMALY_NONE;
+  }
 }
 
 /**
- * Calculate PPM from Rs/Ro ratio
- * Using simplified formula for MQ-2 (LPG curve)
+ * Start a new aggregation window on every channel
  */
-float calculatePPM(float rsRoRatio) {
-  // MQ-2 LPG curve approximation: PPM = 574.25 * (Rs/Ro)^-2.222
-  // Adjust formula based on your specific gas and sensor
-  float ppm = 574.25 * pow(rsRoRatio, -2.222);
-  return ppm;
+void resetGasWindows() {
+  uint32_t now = millis();
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    windowStatsReset(gasWindows[ch], now);
+  }
 }
 
 /**
- * Calibrate sensor in clean air
- * Should be called after warm-up period (5-10 minutes)
+ * Measure Ro of every sensor in clean air, 0 where it is out of range
+ * Only scans, so it can run on any task; returns false if any failed
  */
-bool calibrateGasSensor() {
-  DEBUG_PRINTLN("Calibrating gas sensor...");
-  DEBUG_PRINTLN("Ensure sensor is in clean air!");
+bool measureGasRo(float *ro) {
+  DEBUG_PRINTLN("Calibrating gas sensors...");
+  DEBUG_PRINTLN("Ensure sensors are in clean air!");
 
-  float rsSum = 0;
+  float rsSum[GAS_CHANNEL_COUNT] = {0};
+  uint16_t raw[GAS_CHANNEL_COUNT];
 
   for (int i = 0; i < CALIBRATION_SAMPLES; i++) {
-    int adcValue = readGasSensorRaw();
-    float rs = calculateRs(adcValue);
-    rsSum += rs;
+    scanGas(raw);
+    for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+      rsSum[ch] += calculateRs(raw[ch]);
+    }
     delay(CALIBRATION_DELAY / CALIBRATION_SAMPLES);
 
     if (i % 10 == 0) {
@@ -108,25 +167,97 @@ bool calibrateGasSensor() {
     }
   }
 
-  float rsAvg = rsSum / CALIBRATION_SAMPLES;
-  Ro = rsAvg / CLEAN_AIR_RATIO;
+  bool allCalibrated = true;
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    ro[ch] = (rsSum[ch] / CALIBRATION_SAMPLES) / GasSensors::cleanAirRatio(ch);
+    if (!(ro[ch] > 0 && ro[ch] < 1000)) {
+      ro[ch] = 0;
+      allCalibrated = false;
+    }
+  }
+  return allCalibrated;
+}
 
-  if (Ro > 0 && Ro < 1000) {
-    sensorCalibrated = true;
-    DEBUG_PRINTF("Calibration complete! Ro = %.2f kOhm\n", Ro);
-    return true;
+/**
+ * Install measured Ro values (0 = keep the old one), on the task that
+ * reads the sensors
+ */
+void applyGasRo(const float *ro) {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    GasChannelState &state = gasChannels[ch];
+    if (ro[ch] > 0) {
+      state.ro = ro[ch];
+      state.calibrated = true;
+      DEBUG_PRINTF("%s calibrated, Ro = %.2f kOhm\n", state.model, ro[ch]);
+    } else {
+      DEBUG_PRINTF("%s calibration failed. Check sensor connection.\n",
+                   state.model);
+    }
   }
 
-  DEBUG_PRINTLN("Calibration failed. Check sensor connection.");
-  return false;
+  // New Ro shifts every PPM value, relearn the baselines
+  resetGasDetectors();
 }
 
 /**
- * Initialize gas sensor
+ * Calibrate all sensors in clean air, on the task that reads them
+ * Should be called after warm-up period (5-10 minutes)
+ */
+bool calibrateGasSensor() {
+  float ro[GAS_CHANNEL_COUNT];
+  bool allCalibrated = measureGasRo(ro);
+  applyGasRo(ro);
+  return allCalibrated;
+}
+
+/**
+ * Job: calibrate off the web server task (see jobs.h)
+ * The worker only measures; loop() installs the result in
+ * applyPendingCalibration(), so channels and detectors stay loop()-owned
+ */
+bool gasCalibrationJob(void *arg) {
+  gasCalibrating = true;
+  float ro[GAS_CHANNEL_COUNT];
+  bool allCalibrated = measureGasRo(ro);
+
+  portENTER_CRITICAL(&gasCalibrationMux);
+  memcpy(gasCalibrationRo, ro, sizeof(gasCalibrationRo));
+  gasCalibrationPending = true;
+  portEXIT_CRITICAL(&gasCalibrationMux);
+  return allCalibrated;
+}
+
+/**
+ * Install a calibration measured by gasCalibrationJob(), resumes readings
+ */
+void applyPendingCalibration() {
+  if (!gasCalibrationPending) {
+    return;
+  }
+
+  float ro[GAS_CHANNEL_COUNT];
+  portENTER_CRITICAL(&gasCalibrationMux);
+  memcpy(ro, gasCalibrationRo, sizeof(ro));
+  gasCalibrationPending = false;
+  portEXIT_CRITICAL(&gasCalibrationMux);
+
+  applyGasRo(ro);
+  gasCalibrating = false;
+}
+
+/**
+ * Initialize gas sensors
  */
 void initGasSensor() {
-  pinMode(GAS_SENSOR_PIN, INPUT);
-  DEBUG_PRINTLN("Gas sensor initialized on GPIO " + String(GAS_SENSOR_PIN));
+  GasSensors::init(gasChannels);
+  resetGasWindows();
+  resetGasDetectors();
+
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    DEBUG_PRINTF("Gas sensor %s (%s) initialized on GPIO %u\n",
+                 gasChannels[ch].model, gasChannels[ch].gas,
+                 gasChannels[ch].pin);
+  }
   DEBUG_PRINTLN("Allow 5-10 min warm-up before calibration.");
 }
 
@@ -134,22 +265,88 @@ void initGasSensor() {
  * Read gas sensor values
  */
 void readGasSensor() {
-  int adcValue = readGasSensorRaw();
-  gasRaw = adcValue;
-  gasVoltage = adcToVoltage(adcValue);
-
-  if (sensorCalibrated && Ro > 0) {
-    float rs = calculateRs(adcValue);
-    float rsRoRatio = rs / Ro;
-    gasPPM = calculatePPM(rsRoRatio);
-
-    // Clamp PPM to reasonable range
-    if (gasPPM < 0)
-      gasPPM = 0;
-    if (gasPPM > 10000)
-      gasPPM = 10000;
-  } else {
-    gasPPM = 0;
+  uint16_t raw[GAS_CHANNEL_COUNT];
+  scanGas(raw);
+  processGasScan(raw);
+}
+
+/**
+ * Gas level indicator for a PPM value
+ */
+const char *getGasLevel(float ppm) {
+  if (ppm > deviceConfig.ppmDanger)
+    return "danger";
+  if (ppm > deviceConfig.ppmWarning)
+    return "warning";
+  if (ppm > deviceConfig.ppmElevated)
+    return "elevated";
+  return "normal";
+}
+
+/**
+ * Check if gas level is dangerous on any channel
+ */
+bool isGasDangerous() {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    if (gasChannels[ch].ppm > deviceConfig.ppmDanger) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Append every channel reading to a JSON array
+ */
+void addGasChannelsJSON(JsonArray channels, bool includeCalibration) {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    const GasChannelState &state = gasChannels[ch];
+    JsonObject obj = channels.add<JsonObject>();
+
+    obj["id"] = ch;
+    obj["model"] = state.model;
+    obj["gas"] = state.gas;
+    obj["ppm"] = state.ppm;
+    obj["raw"] = state.raw;
+    obj["voltage"] = state.voltage;
+    obj["level"] = getGasLevel(state.ppm);
+    obj["calibrated"] = state.calibrated;
+    if (includeCalibration) {
+      obj["pin"] = state.pin;
+      obj["ro"] = state.ro;
+    }
+  }
+}
+
+/**
+ * Add per-channel window summaries (since the last sync) to a JSON object
+ */
+void addGasWindowJSON(JsonObject window) {
+  uint32_t now = millis();
+
+  window["start_ms"] = gasWindows[GAS_PRIMARY_CHANNEL].startMs;
+  window["duration_ms"] =
+      windowStatsDuration(gasWindows[GAS_PRIMARY_CHANNEL], now);
+  window["threshold_ppm"] = deviceConfig.ppmWarning;
+
+  JsonArray channels = window["channels"].to<JsonArray>();
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    const WindowStats &stats = gasWindows[ch];
+    JsonObject obj = channels.add<JsonObject>();
+
+    obj["id"] = ch;
+    obj["count"] = stats.count;
+    if (stats.count == 0) {
+      continue;
+    }
+    obj["min"] = stats.min;
+    obj["max"] = stats.max;
+    obj["mean"] = stats.mean;
+    obj["stddev"] = sqrtf(windowStatsVariance(stats));
+    obj["p50"] = windowStatsQuantile(stats, 0.50f);
+    obj["p95"] = windowStatsQuantile(stats, 0.95f);
+    obj["p99"] = windowStatsQuantile(stats, 0.99f);
+    obj["above_ms"] = windowStatsAboveMs(stats, now);
   }
 }
 
@@ -157,24 +354,59 @@ void readGasSensor() {
  * Get gas sensor data as JSON
  */
 String getGasSensorJSON() {
-  JsonDocument doc;
+  JsonDocument doc(&jsonWebPool);
+  const GasChannelState &primary = gasChannels[GAS_PRIMARY_CHANNEL];
+
+  doc["raw"] = primary.raw;
+  doc["voltage"] = primary.voltage;
+  doc["ppm"] = primary.ppm;
+  doc["calibrated"] = primary.calibrated;
+  doc["ro"] = primary.ro;
+  doc["timestamp"] = millis();
+  doc["level"] = getGasLevel(primary.ppm);
+  addGasChannelsJSON(doc["channels"].to<JsonArray>(), true);
+  addGasWindowJSON(doc["window"].to<JsonObject>());
 
-  doc["raw"] = gasRaw;
-  doc["voltage"] = gasVoltage;
-  doc["ppm"] = gasPPM;
-  doc["calibrated"] = sensorCalibrated;
-  doc["ro"] = Ro;
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+/**
+ * Get every sensor channel as JSON
+ */
+String getSensorsJSON() {
+  JsonDocument doc(&jsonWebPool);
+
+  doc["count"] = GAS_CHANNEL_COUNT;
   doc["timestamp"] = millis();
+  addGasChannelsJSON(doc["channels"].to<JsonArray>(), true);
 
-  // Gas level indicator
-  String level = "normal";
-  if (gasPPM > 1000)
-    level = "danger";
-  else if (gasPPM > 500)
-    level = "warning";
-  else if (gasPPM > 200)
-    level = "elevated";
-  doc["level"] = level;
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+/**
+ * Build WebSocket sensor frame for the latest reading
+ */
+String getGasSensorFrame() {
+  JsonDocument doc(&jsonTickPool);
+  const GasChannelState &primary = gasChannels[GAS_PRIMARY_CHANNEL];
+
+  doc["type"] = "sensor_data";
+  doc["gas_ppm"] = primary.ppm;
+  doc["gas_level"] = getGasLevel(primary.ppm);
+  doc["gas_raw"] = primary.raw;
+  doc["gas_voltage"] = primary.voltage;
+  doc["gas_calibrated"] = primary.calibrated;
+  doc["timestamp"] = millis();
+  addGasChannelsJSON(doc["channels"].to<JsonArray>(), false);
+
+  // Check for danger level
+  if (isGasDangerous()) {
+    doc["alert"] = tr(STR_ALERT_GAS_DANGER, deviceLanguage());
+  }
 
   String output;
   serializeJson(doc, output);
@@ -182,8 +414,52 @@ String getGasSensorJSON() {
 }
 
 /**
- * Check if gas level is dangerous
+ * Build WebSocket anomaly frame for a channel
  */
-bool isGasDangerous() { return gasPPM > 1000; }
+String getGasAnomalyFrame(size_t ch, uint8_t flags) {
+  JsonDocument doc(&jsonTickPool);
+  const GasChannelState &state = gasChannels[ch];
+  const AnomalyDetector &det = gasDetectors[ch];
+
+  doc["type"] = "anomaly";
+  doc["kind"] = anomalyName(flags);
+  doc["channel"] = ch;
+  doc["model"] = state.model;
+  doc["gas"] = state.gas;
+  doc["ppm"] = state.ppm;
+  doc["level"] = getGasLevel(state.ppm);
+  doc["slope"] = det.slope;
+  doc["baseline"] = det.mean;
+  doc["cusum"] = det.cusum;
+  doc["timestamp"] = millis();
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+/**
+ * Build sensor_readings row for Supabase sync
+ * Per-channel readings and window summaries go to the raw_data JSONB column.
+ * Call resetGasWindows() once the row is stored.
+ */
+String getGasSyncPayload() {
+  JsonDocument doc(&jsonLargeArena);
+  const GasChannelState &primary = gasChannels[GAS_PRIMARY_CHANNEL];
+
+  doc["device_id"] = DEVICE_ID;
+  doc["tenant_id"] = TENANT_ID;
+  doc["gas_ppm"] = primary.ppm;
+  doc["gas_level"] = getGasLevel(primary.ppm);
+
+  JsonObject rawData = doc["raw_data"].to<JsonObject>();
+  rawData["uptime_ms"] = millis();
+  addGasChannelsJSON(rawData["channels"].to<JsonArray>(), false);
+  addGasWindowJSON(rawData["window"].to<JsonObject>());
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
 
 #endif // GAS_SENSOR_H
@@ -0,0 +1,489 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Local History
+ *
+ * Readings (one per channel every HIST_INTERVAL), anomalies and rule
+ * events stored as fixed 16-byte records in a ring of SPIFFS files:
+ *
+ *   /hist/00000042.bin  up to HIST_FILE_RECORDS records, oldest file first
+ *
+ * Records are buffered in RAM and written in HIST_BLOCK_RECORDS blocks.
+ * Exports stream CSV or NDJSON straight from the files one block at a time,
+ * so memory use is the same for an hour or a month of data.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "anomaly.h"
+#include "config.h"
+#include "store_fs.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SPIFFS.h>
+#include <time.h>
+
+// ============================================
+// History Configuration
+// ============================================
+
+// Interval between stored readings (ms)
+#ifndef HIST_INTERVAL
+#define HIST_INTERVAL 60000
+#endif
+
+// Records per file (64 KB) and files kept before the oldest is deleted
+#ifndef HIST_FILE_RECORDS
+#define HIST_FILE_RECORDS 4096
+#endif
+
+#ifndef HIST_FILES
+#define HIST_FILES 8
+#endif
+
+// Write partial blocks at least this often (ms)
+#ifndef HIST_FLUSH_INTERVAL
+#define HIST_FLUSH_INTERVAL 600000
+#endif
+
+#define HIST_DIR "/hist"
+#define HIST_BLOCK_RECORDS 32 // 512-byte write and read unit
+
+// Clock considered set (NTP) after this Unix time
+#define HIST_EPOCH_VALID 1600000000UL
+
+// ============================================
+// History Types
+// ============================================
+
+enum HistKind { HIST_READING = 1, HIST_ANOMALY = 2, HIST_RULE = 3 };
+
+enum HistFormat { HIST_FORMAT_CSV, HIST_FORMAT_NDJSON };
+
+struct HistRecord {
+  uint32_t epoch; // Unix seconds, 0 = clock not set yet
+  uint8_t kind;   // HistKind
+  uint8_t channel;
+  uint16_t code; // Raw ADC / ANOMALY_* flags / rule index
+  float ppm;
+  float value; // Voltage / slope (PPM/s) / 1 = fired, 0 = cleared
+};
+
+struct HistFilter {
+  uint32_t from; // Unix seconds, 0 = no lower bound
+  uint32_t to;   // Unix seconds, 0 = no upper bound
+  uint8_t kinds; // Bit (1 << HistKind), 0 = all
+  int16_t channel; // -1 = all
+  HistFormat format;
+};
+
+struct HistoryLog {
+  StoreFS *fs;
+  uint32_t firstFile; // 0 = nothing stored yet
+  uint32_t lastFile;
+  uint32_t lastFileRecords;
+  HistRecord block[HIST_BLOCK_RECORDS];
+  size_t blockFill;
+  uint32_t lastFlushMs;
+  uint32_t stored;
+  uint32_t writeErrors;
+};
+
+// Export state: one block read from flash plus one formatted line
+struct HistExportCursor {
+  HistFilter filter;
+  uint32_t file;       // File being read, 0 = files done
+  uint32_t endFile;    // Files and records present when the export began
+  uint32_t endRecords; // Records to read from endFile
+  uint32_t record;     // Next record in file
+  StoreFile handle;
+  HistRecord block[HIST_BLOCK_RECORDS];
+  size_t blockLen;
+  size_t blockPos;
+  HistRecord tail[HIST_BLOCK_RECORDS]; // Unwritten records at the start
+  size_t tailLen;
+  bool started;
+  bool finished;
+  char pending[160];
+  size_t pendingLen;
+  size_t pendingPos;
+
+  HistExportCursor()
+      : file(0), endFile(0), endRecords(0), record(0), blockLen(0),
+        blockPos(0), tailLen(0), started(false), finished(false),
+        pendingLen(0), pendingPos(0) {}
+  ~HistExportCursor() { handle.close(); }
+};
+
+// ============================================
+// History Variables
+// ============================================
+StoreFS historyFS(SPIFFS);
+HistoryLog historyLog;
+uint32_t lastHistorySample = 0;
+portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================
+// History Functions
+// ============================================
+
+/**
+ * Path of a history file
+ */
+void histFilePath(uint32_t file, char *path, size_t len) {
+  snprintf(path, len, HIST_DIR "/%08lu.bin", (unsigned long)file);
+}
+
+/**
+ * Current Unix time, 0 until the clock has been set
+ */
+uint32_t histNow() {
+  time_t now = time(NULL);
+  return now > (time_t)HIST_EPOCH_VALID ? (uint32_t)now : 0;
+}
+
+/**
+ * Mount SPIFFS and find the stored files
+ */
+bool initHistory() {
+  memset(&historyLog, 0, sizeof(historyLog));
+  historyLog.fs = &historyFS;
+  if (!SPIFFS.begin(true)) {
+    DEBUG_PRINTLN("History disabled: SPIFFS mount failed");
+    historyLog.fs = NULL;
+    return false;
+  }
+  historyFS.mkdir(HIST_DIR);
+
+  uint32_t first = 0;
+  uint32_t last = 0;
+  uint32_t lastSize = 0;
+  historyFS.list(HIST_DIR, [&](const char *name, uint32_t size) {
+    uint32_t file = strtoul(name, NULL, 10);
+    if (file == 0) {
+      return;
+    }
+    if (first == 0 || file < first) {
+      first = file;
+    }
+    if (file > last) {
+      last = file;
+      lastSize = size;
+    }
+  });
+
+  historyLog.firstFile = first;
+  historyLog.lastFile = last;
+  historyLog.lastFileRecords = lastSize / sizeof(HistRecord);
+  historyLog.lastFlushMs = millis();
+  DEBUG_PRINTF("History: files %lu-%lu\n", (unsigned long)first,
+               (unsigned long)last);
+  return true;
+}
+
+/**
+ * Write the buffered records, starting a new file when the current one is
+ * full and deleting the oldest beyond HIST_FILES. Loop task only
+ */
+void flushHistory() {
+  HistoryLog &log = historyLog;
+  log.lastFlushMs = millis();
+  size_t count = log.blockFill;
+  if (!log.fs || count == 0) {
+    return;
+  }
+
+  char path[STORE_PATH_MAX];
+  if (log.lastFile == 0 || log.lastFileRecords + count > HIST_FILE_RECORDS) {
+    uint32_t next = log.lastFile + 1;
+    while (log.firstFile != 0 && next - log.firstFile >= HIST_FILES) {
+      histFilePath(log.firstFile, path, sizeof(path));
+      log.fs->remove(path);
+      portENTER_CRITICAL(&historyMux);
+      log.firstFile++;
+      portEXIT_CRITICAL(&historyMux);
+    }
+    portENTER_CRITICAL(&historyMux);
+    log.lastFile = next;
+    log.lastFileRecords = 0;
+    if (log.firstFile == 0) {
+      log.firstFile = next;
+    }
+    portEXIT_CRITICAL(&historyMux);
+  }
+
+  histFilePath(log.lastFile, path, sizeof(path));
+  StoreFile file = log.fs->open(path, "a");
+  size_t bytes = count * sizeof(HistRecord);
+  bool ok = file.isOpen() &&
+            file.write((const uint8_t *)log.block, bytes) == bytes;
+  file.close();
+
+  // Exports take their snapshot under the same lock, so a record is seen
+  // either in the file or in the block, never both
+  portENTER_CRITICAL(&historyMux);
+  if (ok) {
+    log.lastFileRecords += count;
+    log.stored += count;
+  } else {
+    log.writeErrors++;
+  }
+  log.blockFill = 0;
+  portEXIT_CRITICAL(&historyMux);
+}
+
+/**
+ * Buffer one record, writing the block once it is full. Loop task only
+ */
+void appendHistory(uint8_t kind, uint8_t channel, uint16_t code, float ppm,
+                   float value) {
+  if (!historyLog.fs) {
+    return;
+  }
+  HistRecord record = {histNow(), kind, channel, code, ppm, value};
+
+  portENTER_CRITICAL(&historyMux);
+  historyLog.block[historyLog.blockFill++] = record;
+  bool full = historyLog.blockFill == HIST_BLOCK_RECORDS;
+  portEXIT_CRITICAL(&historyMux);
+
+  if (full) {
+    flushHistory();
+  }
+}
+
+/**
+ * Flush partial blocks that have waited HIST_FLUSH_INTERVAL, loop task
+ */
+void updateHistory() {
+  if (historyLog.blockFill > 0 &&
+      millis() - historyLog.lastFlushMs >= HIST_FLUSH_INTERVAL) {
+    flushHistory();
+  }
+}
+
+/**
+ * Whether a record passes an export filter
+ */
+bool histMatches(const HistFilter &filter, const HistRecord &record) {
+  if (filter.kinds && !(filter.kinds & (1 << record.kind))) {
+    return false;
+  }
+  if (filter.channel >= 0 && record.kind != HIST_RULE &&
+      record.channel != filter.channel) {
+    return false;
+  }
+  if ((filter.from || filter.to) && record.epoch == 0) {
+    return false;
+  }
+  return record.epoch >= filter.from &&
+         (filter.to == 0 || record.epoch <= filter.to);
+}
+
+/**
+ * Start an export of what is stored right now
+ */
+void histExportBegin(HistExportCursor &cursor, const HistFilter &filter) {
+  cursor.filter = filter;
+  portENTER_CRITICAL(&historyMux);
+  cursor.file = historyLog.firstFile;
+  cursor.endFile = historyLog.lastFile;
+  cursor.endRecords = historyLog.lastFileRecords;
+  cursor.tailLen = historyLog.blockFill;
+  memcpy(cursor.tail, historyLog.block, cursor.tailLen * sizeof(HistRecord));
+  portEXIT_CRITICAL(&historyMux);
+}
+
+/**
+ * Open the next file worth reading. Files whose last record is older than
+ * the filter are skipped after one read
+ */
+bool histOpenFile(HistExportCursor &cursor) {
+  char path[STORE_PATH_MAX];
+  while (cursor.file != 0 && cursor.file <= cursor.endFile) {
+    histFilePath(cursor.file, path, sizeof(path));
+    cursor.handle = historyLog.fs->open(path, "r");
+    cursor.record = 0;
+    if (!cursor.handle.isOpen()) {
+      cursor.file++;
+      continue;
+    }
+
+    uint32_t records = cursor.file == cursor.endFile
+                           ? cursor.endRecords
+                           : cursor.handle.size() / sizeof(HistRecord);
+    HistRecord last;
+    if (cursor.filter.from && records > 0 &&
+        cursor.handle.seek((records - 1) * sizeof(HistRecord)) &&
+        cursor.handle.read((uint8_t *)&last, sizeof(last)) == sizeof(last) &&
+        last.epoch != 0 && last.epoch < cursor.filter.from) {
+      cursor.handle.close();
+      cursor.file++;
+      continue;
+    }
+    return cursor.handle.seek(0);
+  }
+  cursor.file = 0;
+  return false;
+}
+
+/**
+ * Next record for the export, false when everything has been read
+ */
+bool histNextRecord(HistExportCursor &cursor, HistRecord &record) {
+  while (cursor.blockPos >= cursor.blockLen) {
+    cursor.blockPos = 0;
+    cursor.blockLen = 0;
+
+    if (cursor.file != 0 && !cursor.handle.isOpen() && !histOpenFile(cursor)) {
+      continue;
+    }
+    if (cursor.file != 0) {
+      uint32_t limit = cursor.file == cursor.endFile ? cursor.endRecords
+                                                     : HIST_FILE_RECORDS;
+      uint32_t want = limit > cursor.record ? limit - cursor.record : 0;
+      if (want > HIST_BLOCK_RECORDS) {
+        want = HIST_BLOCK_RECORDS;
+      }
+      size_t got = want ? cursor.handle.read((uint8_t *)cursor.block,
+                                             want * sizeof(HistRecord))
+                        : 0;
+      cursor.blockLen = got / sizeof(HistRecord);
+      cursor.record += cursor.blockLen;
+      if (cursor.blockLen == 0) {
+        cursor.handle.close();
+        cursor.file = cursor.file == cursor.endFile ? 0 : cursor.file + 1;
+      }
+      continue;
+    }
+
+    // Files done: the records that were still buffered in RAM
+    if (cursor.tailLen == 0) {
+      return false;
+    }
+    memcpy(cursor.block, cursor.tail, cursor.tailLen * sizeof(HistRecord));
+    cursor.blockLen = cursor.tailLen;
+    cursor.tailLen = 0;
+  }
+
+  record = cursor.block[cursor.blockPos++];
+  return true;
+}
+
+/**
+ * Format the time of a record as ISO 8601 UTC, empty if the clock was not set
+ */
+void histFormatTime(uint32_t epoch, char *out, size_t len) {
+  if (epoch == 0) {
+    out[0] = '\0';
+    return;
+  }
+  time_t t = epoch;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(out, len, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+/**
+ * Format the next piece of the export into cursor.pending
+ */
+bool histFormatPiece(HistExportCursor &cursor) {
+  static const char *const kindNames[] = {"", "reading", "anomaly", "rule"};
+  bool csv = cursor.filter.format == HIST_FORMAT_CSV;
+  int written = 0;
+
+  if (!cursor.started) {
+    cursor.started = true;
+    if (!csv) {
+      return true;
+    }
+    written = snprintf(cursor.pending, sizeof(cursor.pending),
+                       "time,type,channel,ppm,value,code\n");
+  } else {
+    HistRecord record;
+    do {
+      if (cursor.finished || !histNextRecord(cursor, record)) {
+        cursor.finished = true;
+        return false;
+      }
+      // Records are in time order, nothing later can match
+      if (cursor.filter.to && record.epoch > cursor.filter.to) {
+        cursor.finished = true;
+        return false;
+      }
+    } while (!histMatches(cursor.filter, record));
+
+    const char *kind = kindNames[record.kind <= HIST_RULE ? record.kind : 0];
+    char code[16];
+    if (record.kind == HIST_ANOMALY) {
+      snprintf(code, sizeof(code), "%s", anomalyName(record.code));
+    } else {
+      snprintf(code, sizeof(code), "%u", (unsigned)record.code);
+    }
+
+    if (csv) {
+      char time[24];
+      histFormatTime(record.epoch, time, sizeof(time));
+      written = snprintf(cursor.pending, sizeof(cursor.pending),
+                         "%s,%s,%u,%.2f,%.3f,%s\n", time, kind,
+                         (unsigned)record.channel, record.ppm, record.value,
+                         code);
+    } else {
+      written = snprintf(cursor.pending, sizeof(cursor.pending),
+                         "{\"ts\":%lu,\"type\":\"%s\",\"channel\":%u,"
+                         "\"ppm\":%.2f,\"value\":%.3f,\"code\":\"%s\"}\n",
+                         (unsigned long)record.epoch, kind,
+                         (unsigned)record.channel, record.ppm, record.value,
+                         code);
+    }
+  }
+
+  cursor.pendingLen = written < (int)sizeof(cursor.pending)
+                          ? written
+                          : sizeof(cursor.pending) - 1;
+  cursor.pendingPos = 0;
+  return true;
+}
+
+/**
+ * Write as much of the export as fits into buffer
+ * Returns bytes written, 0 when the export is complete
+ */
+size_t histExportChunk(HistExportCursor &cursor, char *buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (cursor.pendingPos >= cursor.pendingLen && !histFormatPiece(cursor)) {
+      break;
+    }
+
+    size_t n = cursor.pendingLen - cursor.pendingPos;
+    if (n > maxLen - written) {
+      n = maxLen - written;
+    }
+    memcpy(buffer + written, cursor.pending + cursor.pendingPos, n);
+    cursor.pendingPos += n;
+    written += n;
+  }
+
+  return written;
+}
+
+/**
+ * Add history storage figures to a JSON object
+ */
+void addHistoryJSON(JsonObject history) {
+  history["available"] = historyLog.fs != NULL;
+  history["first_file"] = historyLog.firstFile;
+  history["last_file"] = historyLog.lastFile;
+  history["buffered"] = historyLog.blockFill;
+  history["stored"] = historyLog.stored;
+  history["write_errors"] = historyLog.writeErrors;
+  history["files"] = historyLog.firstFile
+                         ? historyLog.lastFile - historyLog.firstFile + 1
+                         : 0;
+  history["bytes_max"] =
+      (uint32_t)HIST_FILES * HIST_FILE_RECORDS * sizeof(HistRecord);
+}
+
+#endif // HISTORY_H
@@ -0,0 +1,162 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Language Tables
+ *
+ * Every catalog in lang_*.h is compiled in as a table of string pointers
+ * indexed by StringId. Tables and strings are const, so they stay in flash
+ * and a language costs no RAM; which one is used is picked per call
+ * (per HTTP request, or the device default from devices.config). The
+ * dashboard gets the same catalogs as gzip'd JSON bundles that
+ * scripts/build_web.py generates at build time (lang_bundle.h).
+ *
+ * Adding a language: copy lang_en.h to lang_<code>.h, translate it, add
+ * an I18N_CATALOG() line and a languages[] entry below. No Arduino
+ * dependencies.
+ */
+
+#ifndef I18N_H
+#define I18N_H
+
+#include "lang_en.h"
+#include "lang_id.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+// ============================================
+// Language Configuration
+// ============================================
+
+// Default when neither the request nor devices.config picks one
+#ifndef DEVICE_LANGUAGE
+#define DEVICE_LANGUAGE "en"
+#endif
+
+// ============================================
+// Language Types
+// ============================================
+
+// String IDs: STR_<key> for every key of the reference catalog
+enum StringId {
+#define I18N_ID(key, text) STR_##key,
+  LANG_EN_STRINGS(I18N_ID)
+#undef I18N_ID
+  STR_COUNT
+};
+
+struct Language {
+  const char *code; // ISO 639-1, also the lang_<code>.h file name
+  const char *const *strings;
+};
+
+// Bundle served to the dashboard, entries come from lang_bundle.h
+struct LangBundle {
+  const char *code;
+  const uint8_t *gzip;
+  size_t len;
+  const char *etag;
+};
+
+// ============================================
+// Language Tables
+// ============================================
+
+// Keys are only ever pasted, so one named like a config.h macro is safe
+#define I18N_ORDER(key, text) KEY_##key,
+#define I18N_CHECK(key, text)                                                  \
+  static_assert((int)KEY_##key == (int)::STR_##key,                            \
+                #key " missing or out of order");
+#define I18N_TEXT(key, text) text,
+
+// One namespace per catalog: its key order is checked against lang_en.h,
+// then its strings become a flash table
+#define I18N_CATALOG(ns, STRINGS)                                              \
+  namespace ns {                                                               \
+  enum { STRINGS(I18N_ORDER) KEY_COUNT };                                      \
+  STRINGS(I18N_CHECK)                                                          \
+  static_assert((int)KEY_COUNT == (int)STR_COUNT, #ns ": wrong key count");   \
+  const char *const strings[STR_COUNT] PROGMEM = {STRINGS(I18N_TEXT)};         \
+  }
+
+I18N_CATALOG(lang_en, LANG_EN_STRINGS)
+I18N_CATALOG(lang_id, LANG_ID_STRINGS)
+
+const Language languages[] PROGMEM = {
+    {"en", lang_en::strings},
+    {"id", lang_id::strings},
+};
+
+#define LANGUAGE_COUNT (sizeof(languages) / sizeof(languages[0]))
+
+// ============================================
+// Language Functions
+// ============================================
+
+/**
+ * Look up a string, falls back to English for an unknown language index
+ */
+const char *tr(StringId id, uint8_t lang) {
+  if ((unsigned)id >= STR_COUNT) {
+    return "";
+  }
+  const Language &language = languages[lang < LANGUAGE_COUNT ? lang : 0];
+  return language.strings[id];
+}
+
+/**
+ * Index of a language by code ("id", "ID", "id-ID" or "id_ID"), -1 if
+ * not compiled in. len limits how much of code is read.
+ */
+int findLanguage(const char *code, size_t len) {
+  size_t primary = 0;
+  while (primary < len && code[primary] && code[primary] != '-' &&
+         code[primary] != '_') {
+    primary++;
+  }
+  for (size_t i = 0; i < LANGUAGE_COUNT; i++) {
+    if (strlen(languages[i].code) == primary &&
+        strncasecmp(languages[i].code, code, primary) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+int findLanguage(const char *code) { return findLanguage(code, strlen(code)); }
+
+/**
+ * First supported language of an Accept-Language header, in the order the
+ * client listed them (browsers list by preference), fallback if none
+ */
+uint8_t languageFromAccept(const char *header, uint8_t fallback) {
+  const char *p = header;
+  while (*p) {
+    while (*p == ' ' || *p == ',') {
+      p++;
+    }
+    const char *tag = p;
+    while (*p && *p != ',' && *p != ';' && *p != ' ') {
+      p++;
+    }
+    const char *params = p;
+    while (*p && *p != ',') {
+      p++;
+    }
+    // "q=0" means not acceptable
+    const char *q = strstr(params, "q=");
+    bool refused = q && q < p && atof(q + 2) <= 0;
+    int lang = findLanguage(tag, params - tag);
+    if (lang >= 0 && !refused) {
+      return (uint8_t)lang;
+    }
+  }
+  return fallback;
+}
+
+#endif // I18N_H
@@ -0,0 +1,320 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Deferred Job Executor
+ *
+ * Prioritized job queue serviced by a worker task, so slow operations
+ * (calibration, restart) never run on the AsyncTCP task.
+ * Handlers submit a job and reply with 202 + job id (polled via /api/jobs).
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "config.h"
+#include "loop_wake.h"
+#include "mem_pools.h"
+#include "stage_watch.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+// ============================================
+// Job Executor Configuration
+// ============================================
+
+// Job table size, finished jobs stay queryable until their slot is reused
+#ifndef JOB_SLOTS
+#define JOB_SLOTS 12
+#endif
+
+#ifndef JOB_WORKER_STACK
+#define JOB_WORKER_STACK 8192
+#endif
+
+// Below AsyncTCP (3) so handlers stay responsive while a job runs
+#ifndef JOB_WORKER_PRIORITY
+#define JOB_WORKER_PRIORITY 2
+#endif
+
+#define JOB_PRIORITY_HIGH 0
+#define JOB_PRIORITY_NORMAL 1
+
+// ============================================
+// Job Executor Types
+// ============================================
+
+enum JobState { JOB_FREE, JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED };
+
+// Returns true on success; arg is owned by the job function
+typedef bool (*JobFunction)(void *arg);
+
+struct Job {
+  uint32_t id;
+  const char *name; // Must point to a string literal
+  JobFunction fn;
+  void *arg;
+  uint8_t priority;
+  volatile JobState state;
+  uint32_t enqueuedUs;
+  uint32_t startedUs;
+  uint32_t finishedUs;
+};
+
+struct JobStats {
+  uint32_t submitted;
+  uint32_t completed;
+  uint32_t failed;
+  uint32_t rejected; // Queue or job table full
+  uint32_t waitUsMax;
+  uint32_t runUsMax;
+  uint64_t waitUsTotal;
+  uint64_t runUsTotal;
+};
+
+// ============================================
+// Job Executor Variables
+// ============================================
+Job jobs[JOB_SLOTS];
+JobStats jobStats = {0, 0, 0, 0, 0, 0, 0, 0};
+uint32_t jobNextId = 1;
+QueueHandle_t jobQueues[2] = {NULL, NULL}; // Indexed by priority
+TaskHandle_t jobWorker = NULL;
+portMUX_TYPE jobMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================
+// Job Executor Functions
+// ============================================
+
+/**
+ * Run one job and record its timing
+ */
+void runJob(Job *job) {
+  job->startedUs = micros();
+  job->state = JOB_RUNNING;
+
+  bool ok;
+  {
+    STAGE_SCOPE(STAGE_JOB);
+    ok = job->fn(job->arg);
+  }
+
+  uint32_t finished = micros();
+  uint32_t wait = job->startedUs - job->enqueuedUs;
+  uint32_t run = finished - job->startedUs;
+
+  portENTER_CRITICAL(&jobMux);
+  job->finishedUs = finished;
+  job->state = ok ? JOB_DONE : JOB_FAILED;
+  if (ok) {
+    jobStats.completed++;
+  } else {
+    jobStats.failed++;
+  }
+  jobStats.waitUsTotal += wait;
+  jobStats.runUsTotal += run;
+  if (wait > jobStats.waitUsMax) {
+    jobStats.waitUsMax = wait;
+  }
+  if (run > jobStats.runUsMax) {
+    jobStats.runUsMax = run;
+  }
+  portEXIT_CRITICAL(&jobMux);
+
+  // loop() may be waiting on what the job changed (e.g. readings pause
+  // while gasCalibrating is set)
+  wakeLoop();
+}
+
+/**
+ * Worker task: drain high priority first, then one normal job at a time
+ */
+void jobWorkerTask(void *param) {
+  Job *job;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (xQueueReceive(jobQueues[JOB_PRIORITY_HIGH], &job, 0) == pdTRUE ||
+           xQueueReceive(jobQueues[JOB_PRIORITY_NORMAL], &job, 0) == pdTRUE) {
+      runJob(job);
+    }
+  }
+}
+
+/**
+ * Start the worker task
+ */
+bool initJobs() {
+  jobQueues[JOB_PRIORITY_HIGH] = xQueueCreate(JOB_SLOTS, sizeof(Job *));
+  jobQueues[JOB_PRIORITY_NORMAL] = xQueueCreate(JOB_SLOTS, sizeof(Job *));
+  if (!jobQueues[JOB_PRIORITY_HIGH] || !jobQueues[JOB_PRIORITY_NORMAL]) {
+    DEBUG_PRINTLN("Job queue allocation failed");
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(jobWorkerTask, "jobs", JOB_WORKER_STACK, NULL,
+                              JOB_WORKER_PRIORITY, &jobWorker,
+                              APP_CPU_NUM) != pdPASS) {
+    DEBUG_PRINTLN("Job worker start failed");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Queue a job, safe from any task
+ * Returns the job id, or 0 when the executor is busy (caller keeps arg)
+ */
+uint32_t submitJob(const char *name, JobFunction fn, void *arg,
+                   uint8_t priority) {
+  if (!jobWorker) {
+    return 0;
+  }
+
+  // Claim a free slot, else the oldest finished one
+  Job *job = NULL;
+  portENTER_CRITICAL(&jobMux);
+  for (size_t i = 0; i < JOB_SLOTS; i++) {
+    Job &slot = jobs[i];
+    if (slot.state == JOB_FREE) {
+      job = &slot;
+      break;
+    }
+    if ((slot.state == JOB_DONE || slot.state == JOB_FAILED) &&
+        (!job || slot.id < job->id)) {
+      job = &slot;
+    }
+  }
+  if (job) {
+    job->id = jobNextId++;
+    job->name = name;
+    job->fn = fn;
+    job->arg = arg;
+    job->priority = priority;
+    job->state = JOB_QUEUED;
+    job->enqueuedUs = micros();
+    job->startedUs = job->finishedUs = 0;
+    jobStats.submitted++;
+  } else {
+    jobStats.rejected++;
+  }
+  portEXIT_CRITICAL(&jobMux);
+
+  if (!job) {
+    return 0;
+  }
+
+  if (xQueueSend(jobQueues[priority], &job, 0) != pdTRUE) {
+    portENTER_CRITICAL(&jobMux);
+    job->state = JOB_FREE;
+    jobStats.submitted--;
+    jobStats.rejected++;
+    portEXIT_CRITICAL(&jobMux);
+    return 0;
+  }
+
+  xTaskNotifyGive(jobWorker);
+  return job->id;
+}
+
+/**
+ * Whether a job is still waiting or running
+ */
+bool isJobPending(uint32_t id) {
+  for (size_t i = 0; i < JOB_SLOTS; i++) {
+    if (id > 0 && jobs[i].id == id) {
+      return jobs[i].state == JOB_QUEUED || jobs[i].state == JOB_RUNNING;
+    }
+  }
+  return false;
+}
+
+/**
+ * Name of a job state
+ */
+const char *getJobStateName(JobState state) {
+  switch (state) {
+  case JOB_QUEUED:
+    return "queued";
+  case JOB_RUNNING:
+    return "running";
+  case JOB_DONE:
+    return "done";
+  case JOB_FAILED:
+    return "failed";
+  default:
+    return "free";
+  }
+}
+
+/**
+ * Add one job to a JSON object
+ */
+void addJobJSON(JsonObject obj, const Job &job) {
+  obj["id"] = job.id;
+  obj["name"] = job.name;
+  obj["state"] = getJobStateName(job.state);
+  if (job.startedUs) {
+    obj["wait_us"] = job.startedUs - job.enqueuedUs;
+  }
+  if (job.finishedUs) {
+    obj["run_us"] = job.finishedUs - job.startedUs;
+  }
+}
+
+/**
+ * Add queue depth and latency figures to a JSON object
+ */
+void addJobStatsJSON(JsonObject stats) {
+  portENTER_CRITICAL(&jobMux);
+  JobStats snapshot = jobStats;
+  portEXIT_CRITICAL(&jobMux);
+
+  uint32_t finished = snapshot.completed + snapshot.failed;
+  stats["depth"] =
+      jobWorker ? uxQueueMessagesWaiting(jobQueues[JOB_PRIORITY_HIGH]) +
+                      uxQueueMessagesWaiting(jobQueues[JOB_PRIORITY_NORMAL])
+                : 0;
+  stats["submitted"] = snapshot.submitted;
+  stats["completed"] = snapshot.completed;
+  stats["failed"] = snapshot.failed;
+  stats["rejected"] = snapshot.rejected;
+  stats["wait_us_avg"] = finished ? (uint32_t)(snapshot.waitUsTotal / finished) : 0;
+  stats["wait_us_max"] = snapshot.waitUsMax;
+  stats["run_us_avg"] = finished ? (uint32_t)(snapshot.runUsTotal / finished) : 0;
+  stats["run_us_max"] = snapshot.runUsMax;
+}
+
+/**
+ * Get one job (id > 0) or all recent jobs with executor stats as JSON
+ * Returns an empty string when the id is unknown
+ */
+String getJobsJSON(uint32_t id) {
+  JsonDocument doc(&jsonWebPool);
+
+  if (id > 0) {
+    for (size_t i = 0; i < JOB_SLOTS; i++) {
+      if (jobs[i].state != JOB_FREE && jobs[i].id == id) {
+        addJobJSON(doc.to<JsonObject>(), jobs[i]);
+        String output;
+        serializeJson(doc, output);
+        return output;
+      }
+    }
+    return String();
+  }
+
+  addJobStatsJSON(doc["stats"].to<JsonObject>());
+  JsonArray list = doc["jobs"].to<JsonArray>();
+  for (size_t i = 0; i < JOB_SLOTS; i++) {
+    if (jobs[i].state != JOB_FREE) {
+      addJobJSON(list.add<JsonObject>(), jobs[i]);
+    }
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+#endif // JOBS_H
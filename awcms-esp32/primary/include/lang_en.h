@@ -1,83 +1,134 @@
 /**
  * AWCMS ESP32 - English Language Strings
- * 
- * This file contains all user-facing strings in English.
- * To change the device language, modify DEVICE_LANGUAGE in config.h
+ *
+ * Every user-facing string in English. This is the reference catalog:
+ * its keys define the string IDs in i18n.h and every other lang_*.h
+ * lists the same keys in the same order (checked at compile time).
+ * One string literal per entry, scripts/build_web.py parses these.
  */
 
 #ifndef LANG_EN_H
 #define LANG_EN_H
 
-// System Messages
-#define STR_DEVICE_READY "Device Ready"
-#define STR_DEVICE_STARTING "Starting device..."
-#define STR_DEVICE_REBOOTING "Rebooting..."
-#define STR_FIRMWARE_VERSION "Firmware Version"
-
-// WiFi
-#define STR_WIFI_CONNECTING "Connecting to WiFi..."
-#define STR_WIFI_CONNECTED "WiFi Connected"
-#define STR_WIFI_DISCONNECTED "WiFi Disconnected"
-#define STR_WIFI_RECONNECTING "Reconnecting to WiFi..."
-#define STR_WIFI_SSID "Network"
-#define STR_WIFI_SIGNAL "Signal Strength"
-#define STR_WIFI_IP "IP Address"
-
-// Supabase / API
-#define STR_API_CONNECTING "Connecting to server..."
-#define STR_API_CONNECTED "Server connected"
-#define STR_API_DISCONNECTED "Server disconnected"
-#define STR_API_ERROR "Server error"
-#define STR_API_SYNCING "Syncing data..."
-#define STR_API_SYNC_COMPLETE "Sync complete"
-#define STR_API_AUTH_SUCCESS "Authentication successful"
-#define STR_API_AUTH_FAILED "Authentication failed"
-
-// Sensors
-#define STR_SENSOR_READING "Reading sensors..."
-#define STR_SENSOR_TEMPERATURE "Temperature"
-#define STR_SENSOR_HUMIDITY "Humidity"
-#define STR_SENSOR_PRESSURE "Pressure"
-#define STR_SENSOR_LIGHT "Light Level"
-#define STR_SENSOR_MOTION "Motion Detected"
-#define STR_SENSOR_NO_MOTION "No Motion"
-#define STR_SENSOR_ERROR "Sensor Error"
-
-// Camera (ESP32-CAM)
-#define STR_CAMERA_INIT "Initializing camera..."
-#define STR_CAMERA_READY "Camera ready"
-#define STR_CAMERA_ERROR "Camera error"
-#define STR_CAMERA_CAPTURE "Capturing image..."
-#define STR_CAMERA_UPLOADED "Image uploaded"
-
-// Storage
-#define STR_STORAGE_INIT "Initializing storage..."
-#define STR_STORAGE_READY "Storage ready"
-#define STR_STORAGE_ERROR "Storage error"
-#define STR_STORAGE_FULL "Storage full"
-
-// Errors
-#define STR_ERROR_GENERIC "An error occurred"
-#define STR_ERROR_TIMEOUT "Operation timed out"
-#define STR_ERROR_MEMORY "Memory allocation failed"
-#define STR_ERROR_CONFIG "Configuration error"
-
-// Web Interface
-#define STR_WEB_TITLE "AWCMS IoT Device"
-#define STR_WEB_STATUS "Device Status"
-#define STR_WEB_SETTINGS "Settings"
-#define STR_WEB_RESTART "Restart Device"
-#define STR_WEB_UPDATE "Update Firmware"
-#define STR_WEB_SAVE "Save"
-#define STR_WEB_CANCEL "Cancel"
-
-// Status
-#define STR_STATUS_ONLINE "Online"
-#define STR_STATUS_OFFLINE "Offline"
-#define STR_STATUS_IDLE "Idle"
-#define STR_STATUS_BUSY "Busy"
-#define STR_STATUS_OK "OK"
-#define STR_STATUS_WARNING "Warning"
-#define STR_STATUS_ERROR "Error"
+#define LANG_EN_STRINGS(X)                                                    \
+  /* Language */                                                              \
+  X(LANG_NAME, "English")                                                     \
+                                                                              \
+  /* System Messages */                                                       \
+  X(DEVICE_READY, "Device Ready")                                             \
+  X(DEVICE_STARTING, "Starting device...")                                    \
+  X(DEVICE_REBOOTING, "Rebooting...")                                         \
+  X(FIRMWARE_VERSION, "Firmware Version")                                     \
+                                                                              \
+  /* WiFi */                                                                  \
+  X(WIFI_CONNECTING, "Connecting to WiFi...")                                 \
+  X(WIFI_CONNECTED, "WiFi Connected")                                         \
+  X(WIFI_DISCONNECTED, "WiFi Disconnected")                                   \
+  X(WIFI_RECONNECTING, "Reconnecting to WiFi...")                             \
+  X(WIFI_SSID, "Network")                                                     \
+  X(WIFI_SIGNAL, "Signal Strength")                                           \
+  X(WIFI_IP, "IP Address")                                                    \
+                                                                              \
+  /* Supabase / API */                                                        \
+  X(API_CONNECTING, "Connecting to server...")                                \
+  X(API_CONNECTED, "Server connected")                                        \
+  X(API_DISCONNECTED, "Server disconnected")                                  \
+  X(API_ERROR, "Server error")                                                \
+  X(API_SYNCING, "Syncing data...")                                           \
+  X(API_SYNC_COMPLETE, "Sync complete")                                       \
+  X(API_AUTH_SUCCESS, "Authentication successful")                            \
+  X(API_AUTH_FAILED, "Authentication failed")                                 \
+                                                                              \
+  /* Sensors */                                                               \
+  X(SENSOR_READING, "Reading sensors...")                                     \
+  X(SENSOR_TEMPERATURE, "Temperature")                                        \
+  X(SENSOR_HUMIDITY, "Humidity")                                              \
+  X(SENSOR_PRESSURE, "Pressure")                                              \
+  X(SENSOR_LIGHT, "Light Level")                                              \
+  X(SENSOR_MOTION, "Motion Detected")                                         \
+  X(SENSOR_NO_MOTION, "No Motion")                                            \
+  X(SENSOR_ERROR, "Sensor Error")                                             \
+                                                                              \
+  /* Camera (ESP32-CAM) */                                                    \
+  X(CAMERA_INIT, "Initializing camera...")                                    \
+  X(CAMERA_READY, "Camera ready")                                             \
+  X(CAMERA_ERROR, "Camera error")                                             \
+  X(CAMERA_CAPTURE, "Capturing image...")                                     \
+  X(CAMERA_UPLOADED, "Image uploaded")                                        \
+                                                                              \
+  /* Storage */                                                               \
+  X(STORAGE_INIT, "Initializing storage...")                                  \
+  X(STORAGE_READY, "Storage ready")                                           \
+  X(STORAGE_ERROR, "Storage error")                                           \
+  X(STORAGE_FULL, "Storage full")                                             \
+                                                                              \
+  /* Errors */                                                                \
+  X(ERROR_GENERIC, "An error occurred")                                       \
+  X(ERROR_TIMEOUT, "Operation timed out")                                     \
+  X(ERROR_MEMORY, "Memory allocation failed")                                 \
+  X(ERROR_CONFIG, "Configuration error")                                      \
+                                                                              \
+  /* Web Interface */                                                         \
+  X(WEB_TITLE, "AWCMS IoT Device")                                            \
+  X(WEB_STATUS, "Device Status")                                              \
+  X(WEB_SETTINGS, "Settings")                                                 \
+  X(WEB_RESTART, "Restart Device")                                            \
+  X(WEB_UPDATE, "Update Firmware")                                            \
+  X(WEB_SAVE, "Save")                                                         \
+  X(WEB_CANCEL, "Cancel")                                                     \
+                                                                              \
+  /* Status */                                                                \
+  X(STATUS_ONLINE, "Online")                                                  \
+  X(STATUS_OFFLINE, "Offline")                                                \
+  X(STATUS_IDLE, "Idle")                                                      \
+  X(STATUS_BUSY, "Busy")                                                      \
+  X(STATUS_OK, "OK")                                                          \
+  X(STATUS_WARNING, "Warning")                                                \
+  X(STATUS_ERROR, "Error")                                                    \
+                                                                              \
+  /* Gas Alerts */                                                            \
+  X(ALERT_GAS_DANGER, "DANGER: High gas level detected!")                     \
+  X(ALERT_GAS_WARNING, "Gas level warning!")                                  \
+  X(ALERT_RAPID_RISE, "Rapid rise")                                           \
+  X(ALERT_ABNORMAL_TREND, "Abnormal trend")                                   \
+  X(ALERT_ON, "on")                                                           \
+                                                                              \
+  /* Dashboard */                                                             \
+  X(DASH_TITLE, "AWCMS IoT Dashboard")                                        \
+  X(DASH_CONNECTING, "Connecting...")                                         \
+  X(DASH_CONNECTED, "Connected")                                              \
+  X(DASH_DISCONNECTED, "Disconnected")                                        \
+  X(DASH_UNKNOWN, "Unknown")                                                  \
+  X(DASH_GAS_SENSOR, "Gas Sensor")                                            \
+  X(DASH_GAS_LEVEL, "Gas Level")                                              \
+  X(DASH_STATUS, "Status")                                                    \
+  X(DASH_LEVEL_NORMAL, "Normal")                                              \
+  X(DASH_LEVEL_ELEVATED, "Elevated")                                          \
+  X(DASH_LEVEL_WARNING, "Warning")                                            \
+  X(DASH_LEVEL_DANGER, "DANGER")                                              \
+  X(DASH_CALIBRATED, "Calibrated")                                            \
+  X(DASH_NOT_CALIBRATED, "Not calibrated")                                    \
+  X(DASH_CALIBRATING, "Calibrating...")                                       \
+  X(DASH_CALIBRATE, "Calibrate")                                              \
+  X(DASH_CAMERA, "Camera")                                                    \
+  X(DASH_CAMERA_OFFLINE, "Camera Offline")                                    \
+  X(DASH_REFRESH, "Refresh")                                                  \
+  X(DASH_DOWNLOAD, "Download")                                                \
+  X(DASH_DEVICE_INFO, "Device Info")                                          \
+  X(DASH_DEVICE_ID, "Device ID")                                              \
+  X(DASH_WIFI_SIGNAL, "WiFi Signal")                                          \
+  X(DASH_UPTIME, "Uptime")                                                    \
+  X(DASH_ACTIONS, "Actions")                                                  \
+  X(DASH_REFRESH_ALL, "Refresh All")                                          \
+  X(DASH_RESTART, "Restart")                                                  \
+  X(DASH_LAST_UPDATE, "Last update")                                          \
+  X(DASH_LANGUAGE, "Language")                                                \
+  X(DASH_CONFIRM_CALIBRATE, "Calibrate gas sensor?\nMake sure sensor is in clean air.") \
+  X(DASH_DEVICE_BUSY, "Device busy, try again shortly.")                      \
+  X(DASH_CALIBRATION_OK, "Calibration successful!")                           \
+  X(DASH_CALIBRATION_FAILED, "Calibration failed. Check sensor connection.")  \
+  X(DASH_CALIBRATION_ERROR, "Calibration error")                              \
+  X(DASH_CONFIRM_RESTART, "Restart device?")                                  \
+  X(DASH_RESTARTING, "Device restarting...")
 
 #endif // LANG_EN_H
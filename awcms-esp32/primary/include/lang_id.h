@@ -2,82 +2,131 @@
  * AWCMS ESP32 - Indonesian Language Strings
  *
  * File ini berisi semua string yang ditampilkan kepada pengguna dalam Bahasa
- * Indonesia. Untuk mengubah bahasa perangkat, ubah DEVICE_LANGUAGE di config.h
+ * Indonesia. Kunci dan urutannya harus sama dengan lang_en.h.
  */
 
 #ifndef LANG_ID_H
 #define LANG_ID_H
 
-// System Messages
-#define STR_DEVICE_READY "Perangkat Siap"
-#define STR_DEVICE_STARTING "Memulai perangkat..."
-#define STR_DEVICE_REBOOTING "Memulai ulang..."
-#define STR_FIRMWARE_VERSION "Versi Firmware"
-
-// WiFi
-#define STR_WIFI_CONNECTING "Menghubungkan ke WiFi..."
-#define STR_WIFI_CONNECTED "WiFi Terhubung"
-#define STR_WIFI_DISCONNECTED "WiFi Terputus"
-#define STR_WIFI_RECONNECTING "Menghubungkan ulang ke WiFi..."
-#define STR_WIFI_SSID "Jaringan"
-#define STR_WIFI_SIGNAL "Kekuatan Sinyal"
-#define STR_WIFI_IP "Alamat IP"
-
-// Supabase / API
-#define STR_API_CONNECTING "Menghubungkan ke server..."
-#define STR_API_CONNECTED "Server terhubung"
-#define STR_API_DISCONNECTED "Server terputus"
-#define STR_API_ERROR "Kesalahan server"
-#define STR_API_SYNCING "Menyinkronkan data..."
-#define STR_API_SYNC_COMPLETE "Sinkronisasi selesai"
-#define STR_API_AUTH_SUCCESS "Autentikasi berhasil"
-#define STR_API_AUTH_FAILED "Autentikasi gagal"
-
-// Sensors
-#define STR_SENSOR_READING "Membaca sensor..."
-#define STR_SENSOR_TEMPERATURE "Suhu"
-#define STR_SENSOR_HUMIDITY "Kelembaban"
-#define STR_SENSOR_PRESSURE "Tekanan"
-#define STR_SENSOR_LIGHT "Tingkat Cahaya"
-#define STR_SENSOR_MOTION "Gerakan Terdeteksi"
-#define STR_SENSOR_NO_MOTION "Tidak Ada Gerakan"
-#define STR_SENSOR_ERROR "Kesalahan Sensor"
-
-// Camera (ESP32-CAM)
-#define STR_CAMERA_INIT "Menginisialisasi kamera..."
-#define STR_CAMERA_READY "Kamera siap"
-#define STR_CAMERA_ERROR "Kesalahan kamera"
-#define STR_CAMERA_CAPTURE "Mengambil gambar..."
-#define STR_CAMERA_UPLOADED "Gambar diunggah"
-
-// Storage
-#define STR_STORAGE_INIT "Menginisialisasi penyimpanan..."
-#define STR_STORAGE_READY "Penyimpanan siap"
-#define STR_STORAGE_ERROR "Kesalahan penyimpanan"
-#define STR_STORAGE_FULL "Penyimpanan penuh"
-
-// Errors
-#define STR_ERROR_GENERIC "Terjadi kesalahan"
-#define STR_ERROR_TIMEOUT "Operasi habis waktu"
-#define STR_ERROR_MEMORY "Alokasi memori gagal"
-#define STR_ERROR_CONFIG "Kesalahan konfigurasi"
-
-// Web Interface
-#define STR_WEB_TITLE "Perangkat IoT AWCMS"
-#define STR_WEB_STATUS "Status Perangkat"
-#define STR_WEB_SETTINGS "Pengaturan"
-#define STR_WEB_RESTART "Mulai Ulang Perangkat"
-#define STR_WEB_UPDATE "Perbarui Firmware"
-#define STR_WEB_SAVE "Simpan"
-#define STR_WEB_CANCEL "Batal"
-
-// Status
-#define STR_STATUS_ONLINE "Online"
-#define STR_STATUS_OFFLINE "Offline"
-#define STR_STATUS_IDLE "Siaga"
-#define STR_STATUS_BUSY "Sibuk"
-#define STR_STATUS_OK "OK"
-#define STR_STATUS_WARNING "Peringatan"
-#define STR_STATUS_ERROR "Kesalahan"
+#define LANG_ID_STRINGS(X)                                                    \
+  /* Language */                                                              \
+  X(LANG_NAME, "Bahasa Indonesia")                                            \
+                                                                              \
+  /* System Messages */                                                       \
+  X(DEVICE_READY, "Perangkat Siap")                                           \
+  X(DEVICE_STARTING, "Memulai perangkat...")                                  \
+  X(DEVICE_REBOOTING, "Memulai ulang...")                                     \
+  X(FIRMWARE_VERSION, "Versi Firmware")                                       \
+                                                                              \
+  /* WiFi */                                                                  \
+  X(WIFI_CONNECTING, "Menghubungkan ke WiFi...")                              \
+  X(WIFI_CONNECTED, "WiFi Terhubung")                                         \
+  X(WIFI_DISCONNECTED, "WiFi Terputus")                                       \
+  X(WIFI_RECONNECTING, "Menghubungkan ulang ke WiFi...")                      \
+  X(WIFI_SSID, "Jaringan")                                                    \
+  X(WIFI_SIGNAL, "Kekuatan Sinyal")                                           \
+  X(WIFI_IP, "Alamat IP")                                                     \
+                                                                              \
+  /* Supabase / API */                                                        \
+  X(API_CONNECTING, "Menghubungkan ke server...")                             \
+  X(API_CONNECTED, "Server terhubung")                                        \
+  X(API_DISCONNECTED, "Server terputus")                                      \
+  X(API_ERROR, "Kesalahan server")                                            \
+  X(API_SYNCING, "Menyinkronkan data...")                                     \
+  X(API_SYNC_COMPLETE, "Sinkronisasi selesai")                                \
+  X(API_AUTH_SUCCESS, "Autentikasi berhasil")                                 \
+  X(API_AUTH_FAILED, "Autentikasi gagal")                                     \
+                                                                              \
+  /* Sensors */                                                               \
+  X(SENSOR_READING, "Membaca sensor...")                                      \
+  X(SENSOR_TEMPERATURE, "Suhu")                                               \
+  X(SENSOR_HUMIDITY, "Kelembaban")                                            \
+  X(SENSOR_PRESSURE, "Tekanan")                                               \
+  X(SENSOR_LIGHT, "Tingkat Cahaya")                                           \
+  X(SENSOR_MOTION, "Gerakan Terdeteksi")                                      \
+  X(SENSOR_NO_MOTION, "Tidak Ada Gerakan")                                    \
+  X(SENSOR_ERROR, "Kesalahan Sensor")                                         \
+                                                                              \
+  /* Camera (ESP32-CAM) */                                                    \
+  X(CAMERA_INIT, "Menginisialisasi kamera...")                                \
+  X(CAMERA_READY, "Kamera siap")                                              \
+  X(CAMERA_ERROR, "Kesalahan kamera")                                         \
+  X(CAMERA_CAPTURE, "Mengambil gambar...")                                    \
+  X(CAMERA_UPLOADED, "Gambar diunggah")                                       \
+                                                                              \
+  /* Storage */                                                               \
+  X(STORAGE_INIT, "Menginisialisasi penyimpanan...")                          \
+  X(STORAGE_READY, "Penyimpanan siap")                                        \
+  X(STORAGE_ERROR, "Kesalahan penyimpanan")                                   \
+  X(STORAGE_FULL, "Penyimpanan penuh")                                        \
+                                                                              \
+  /* Errors */                                                                \
+  X(ERROR_GENERIC, "Terjadi kesalahan")                                       \
+  X(ERROR_TIMEOUT, "Operasi habis waktu")                                     \
+  X(ERROR_MEMORY, "Alokasi memori gagal")                                     \
+  X(ERROR_CONFIG, "Kesalahan konfigurasi")                                    \
+                                                                              \
+  /* Web Interface */                                                         \
+  X(WEB_TITLE, "Perangkat IoT AWCMS")                                         \
+  X(WEB_STATUS, "Status Perangkat")                                           \
+  X(WEB_SETTINGS, "Pengaturan")                                               \
+  X(WEB_RESTART, "Mulai Ulang Perangkat")                                     \
+  X(WEB_UPDATE, "Perbarui Firmware")                                          \
+  X(WEB_SAVE, "Simpan")                                                       \
+  X(WEB_CANCEL, "Batal")                                                      \
+                                                                              \
+  /* Status */                                                                \
+  X(STATUS_ONLINE, "Online")                                                  \
+  X(STATUS_OFFLINE, "Offline")                                                \
+  X(STATUS_IDLE, "Siaga")                                                     \
+  X(STATUS_BUSY, "Sibuk")                                                     \
+  X(STATUS_OK, "OK")                                                          \
+  X(STATUS_WARNING, "Peringatan")                                             \
+  X(STATUS_ERROR, "Kesalahan")                                                \
+                                                                              \
+  /* Gas Alerts */                                                            \
+  X(ALERT_GAS_DANGER, "BAHAYA: Kadar gas tinggi terdeteksi!")                 \
+  X(ALERT_GAS_WARNING, "Peringatan kadar gas!")                               \
+  X(ALERT_RAPID_RISE, "Kenaikan cepat")                                       \
+  X(ALERT_ABNORMAL_TREND, "Tren tidak normal")                                \
+  X(ALERT_ON, "pada")                                                         \
+                                                                              \
+  /* Dashboard */                                                             \
+  X(DASH_TITLE, "Dasbor IoT AWCMS")                                           \
+  X(DASH_CONNECTING, "Menghubungkan...")                                      \
+  X(DASH_CONNECTED, "Terhubung")                                              \
+  X(DASH_DISCONNECTED, "Terputus")                                            \
+  X(DASH_UNKNOWN, "Tidak diketahui")                                          \
+  X(DASH_GAS_SENSOR, "Sensor Gas")                                            \
+  X(DASH_GAS_LEVEL, "Kadar Gas")                                              \
+  X(DASH_STATUS, "Status")                                                    \
+  X(DASH_LEVEL_NORMAL, "Normal")                                              \
+  X(DASH_LEVEL_ELEVATED, "Meningkat")                                         \
+  X(DASH_LEVEL_WARNING, "Peringatan")                                         \
+  X(DASH_LEVEL_DANGER, "BAHAYA")                                              \
+  X(DASH_CALIBRATED, "Terkalibrasi")                                          \
+  X(DASH_NOT_CALIBRATED, "Belum dikalibrasi")                                 \
+  X(DASH_CALIBRATING, "Mengkalibrasi...")                                     \
+  X(DASH_CALIBRATE, "Kalibrasi")                                              \
+  X(DASH_CAMERA, "Kamera")                                                    \
+  X(DASH_CAMERA_OFFLINE, "Kamera Offline")                                    \
+  X(DASH_REFRESH, "Segarkan")                                                 \
+  X(DASH_DOWNLOAD, "Unduh")                                                   \
+  X(DASH_DEVICE_INFO, "Info Perangkat")                                       \
+  X(DASH_DEVICE_ID, "ID Perangkat")                                           \
+  X(DASH_WIFI_SIGNAL, "Sinyal WiFi")                                          \
+  X(DASH_UPTIME, "Waktu Aktif")                                               \
+  X(DASH_ACTIONS, "Aksi")                                                     \
+  X(DASH_REFRESH_ALL, "Segarkan Semua")                                       \
+  X(DASH_RESTART, "Mulai Ulang")                                              \
+  X(DASH_LAST_UPDATE, "Pembaruan terakhir")                                   \
+  X(DASH_LANGUAGE, "Bahasa")                                                  \
+  X(DASH_CONFIRM_CALIBRATE, "Kalibrasi sensor gas?\nPastikan sensor berada di udara bersih.") \
+  X(DASH_DEVICE_BUSY, "Perangkat sibuk, coba lagi sebentar.")                 \
+  X(DASH_CALIBRATION_OK, "Kalibrasi berhasil!")                               \
+  X(DASH_CALIBRATION_FAILED, "Kalibrasi gagal. Periksa sambungan sensor.")    \
+  X(DASH_CALIBRATION_ERROR, "Kesalahan kalibrasi")                            \
+  X(DASH_CONFIRM_RESTART, "Mulai ulang perangkat?")                           \
+  X(DASH_RESTARTING, "Perangkat memulai ulang...")
 
 #endif // LANG_ID_H
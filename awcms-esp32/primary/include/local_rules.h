@@ -0,0 +1,233 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Local Rules
+ *
+ * Glue between the rule engine (rules.h) and the gas sensor channels:
+ * the running rule set, NVS persistence, hand-off of updates from the
+ * web server and remote config, and status JSON.
+ */
+
+#ifndef LOCAL_RULES_H
+#define LOCAL_RULES_H
+
+#include "config.h"
+#include "gas_sensor.h"
+#include "loop_wake.h"
+#include "mem_pools.h"
+#include "rules.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+#ifdef ENABLE_CAMERA
+#include "camera.h"
+#endif
+
+// ============================================
+// Local Rules Configuration
+// ============================================
+
+#define RULES_NVS_NAMESPACE "awcms"
+#define RULES_NVS_KEY "rules"
+
+// ============================================
+// Local Rules Variables
+// ============================================
+RuleSet activeRules;  // Evaluated on every sample, owned by loop()
+RuleSet rulesScratch; // Compile target for applyRules()
+
+// Update handed over from the web server task, applied in loop()
+char rulesPending[RULES_SOURCE_MAX];
+volatile bool rulesPendingSet = false;
+portMUX_TYPE rulesMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================
+// Local Rules Functions
+// ============================================
+
+/**
+ * Keep relay actions off every pin the firmware already uses, so a bad
+ * rule (saved to NVS and applied again at boot) cannot take one over
+ */
+void reserveRulePins() {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    rulesReservePin(gasChannels[ch].pin);
+  }
+  rulesReservePin(GAS_ALARM_PIN);
+  rulesReservePin(1); // UART0 TX/RX, the serial console
+  rulesReservePin(3);
+#ifdef ENABLE_CAMERA
+  const int cameraPins[] = {PWDN_GPIO_NUM,  RESET_GPIO_NUM, XCLK_GPIO_NUM,
+                            SIOD_GPIO_NUM,  SIOC_GPIO_NUM,  Y9_GPIO_NUM,
+                            Y8_GPIO_NUM,    Y7_GPIO_NUM,    Y6_GPIO_NUM,
+                            Y5_GPIO_NUM,    Y4_GPIO_NUM,    Y3_GPIO_NUM,
+                            Y2_GPIO_NUM,    VSYNC_GPIO_NUM, HREF_GPIO_NUM,
+                            PCLK_GPIO_NUM};
+  for (size_t i = 0; i < sizeof(cameraPins) / sizeof(cameraPins[0]); i++) {
+    rulesReservePin(cameraPins[i]);
+  }
+  // SD card in 1-bit mode (recorder.h): CLK, CMD, D0
+  rulesReservePin(14);
+  rulesReservePin(15);
+  rulesReservePin(2);
+#endif
+}
+
+/**
+ * Drive every relay used by a rule set low
+ */
+void releaseRuleRelays(const RuleSet &set) {
+  for (uint8_t i = 0; i < set.count; i++) {
+    if (set.rules[i].actions & RULE_ACTION_RELAY) {
+      digitalWrite(set.rules[i].relayPin, LOW);
+    }
+  }
+}
+
+/**
+ * Compile and install a rule set, call from loop() only
+ * Running rules are kept when compilation fails
+ */
+bool applyRules(const char *source, RuleError &error, bool persist) {
+  // Unchanged (e.g. config refresh), keep hit counters and rule state
+  if (strcmp(source, activeRules.source) == 0) {
+    error.message = NULL;
+    error.position = 0;
+    return true;
+  }
+
+  if (!rulesCompile(source, rulesScratch, error)) {
+    DEBUG_PRINTF("Rules rejected at %u: %s\n", (unsigned)error.position,
+                 error.message);
+    return false;
+  }
+
+  releaseRuleRelays(activeRules);
+  activeRules = rulesScratch;
+  for (uint8_t i = 0; i < activeRules.count; i++) {
+    if (activeRules.rules[i].actions & RULE_ACTION_RELAY) {
+      pinMode(activeRules.rules[i].relayPin, OUTPUT);
+      digitalWrite(activeRules.rules[i].relayPin, LOW);
+    }
+  }
+
+  if (persist) {
+    Preferences prefs;
+    if (prefs.begin(RULES_NVS_NAMESPACE, false)) {
+      prefs.putString(RULES_NVS_KEY, activeRules.source);
+      prefs.end();
+    }
+  }
+
+  DEBUG_PRINTF("%u rule(s) active\n", activeRules.count);
+  return true;
+}
+
+/**
+ * Load the rule set saved in NVS at boot
+ */
+void loadRules() {
+  reserveRulePins();
+  Preferences prefs;
+  if (!prefs.begin(RULES_NVS_NAMESPACE, true)) {
+    return;
+  }
+  String source = prefs.getString(RULES_NVS_KEY, "");
+  prefs.end();
+
+  RuleError error;
+  if (source.length() > 0) {
+    applyRules(source.c_str(), error, false);
+  }
+}
+
+/**
+ * Hand a validated rule set to loop(), safe from any task
+ */
+void queueRulesUpdate(const char *source) {
+  portENTER_CRITICAL(&rulesMux);
+  strlcpy(rulesPending, source, sizeof(rulesPending));
+  rulesPendingSet = true;
+  portEXIT_CRITICAL(&rulesMux);
+  wakeLoop();
+}
+
+/**
+ * Install a rule set queued by queueRulesUpdate()
+ */
+void applyPendingRules() {
+  if (!rulesPendingSet) {
+    return;
+  }
+
+  static char source[RULES_SOURCE_MAX];
+  portENTER_CRITICAL(&rulesMux);
+  memcpy(source, rulesPending, sizeof(source));
+  rulesPendingSet = false;
+  portEXIT_CRITICAL(&rulesMux);
+
+  RuleError error;
+  applyRules(source, error, true);
+}
+
+/**
+ * Evaluate all rules against the latest gas scan
+ */
+void evaluateGasRules(RuleCallback callback) {
+  RuleSample samples[GAS_CHANNEL_COUNT];
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    samples[ch].field[RULE_FIELD_PPM] = gasChannels[ch].ppm;
+    samples[ch].field[RULE_FIELD_RAW] = gasChannels[ch].raw;
+    samples[ch].field[RULE_FIELD_VOLTAGE] = gasChannels[ch].voltage;
+    samples[ch].field[RULE_FIELD_SLOPE] = gasDetectors[ch].slope;
+  }
+  rulesEvaluate(activeRules, samples, GAS_CHANNEL_COUNT, lastGasRead, callback);
+}
+
+/**
+ * Build WebSocket frame for a rule that fired or cleared
+ */
+String getRuleFrame(const RuleSet &set, uint8_t index, bool active) {
+  JsonDocument doc(&jsonTickPool);
+  char text[RULES_SOURCE_MAX];
+  ruleText(set, index, text, sizeof(text));
+
+  doc["type"] = "rule";
+  doc["rule"] = index;
+  doc["text"] = text;
+  doc["active"] = active;
+  doc["hits"] = set.rules[index].hits;
+  doc["timestamp"] = millis();
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+/**
+ * Get rule source and per-rule counters as JSON
+ */
+String getRulesJSON() {
+  JsonDocument doc(&jsonWebPool);
+  char text[RULES_SOURCE_MAX];
+
+  doc["source"] = activeRules.source;
+  doc["max_rules"] = RULES_MAX;
+  JsonArray rules = doc["rules"].to<JsonArray>();
+  for (uint8_t i = 0; i < activeRules.count; i++) {
+    const Rule &rule = activeRules.rules[i];
+    ruleText(activeRules, i, text, sizeof(text));
+
+    JsonObject obj = rules.add<JsonObject>();
+    obj["id"] = i;
+    obj["text"] = text;
+    obj["hits"] = rule.hits;
+    obj["active"] = rule.active;
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+#endif // LOCAL_RULES_H
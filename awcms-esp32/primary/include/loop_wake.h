@@ -0,0 +1,40 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Loop Wake Hook
+ *
+ * Modules that hand work to loop() (WiFi events, posted rules, finished
+ * jobs) call wakeLoop() so it does not wait for its next deadline.
+ * main.cpp points loopWakeHook at dutyWake(); until then, and on the
+ * host, waking is a no-op. No Arduino dependencies.
+ */
+
+#ifndef LOOP_WAKE_H
+#define LOOP_WAKE_H
+
+#include <stddef.h>
+
+// ============================================
+// Loop Wake Types
+// ============================================
+
+typedef void (*LoopWakeHook)();
+
+// ============================================
+// Loop Wake Variables
+// ============================================
+LoopWakeHook loopWakeHook = NULL; // NULL = loop() only wakes on its deadline
+
+// ============================================
+// Loop Wake Functions
+// ============================================
+
+/**
+ * Wake loop() before its deadline, from any task
+ */
+void wakeLoop() {
+  if (loopWakeHook) {
+    loopWakeHook();
+  }
+}
+
+#endif // LOOP_WAKE_H
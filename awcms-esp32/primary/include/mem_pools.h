@@ -0,0 +1,373 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Memory Pools
+ *
+ * ArduinoJson allocators that keep JSON churn away from the general heap:
+ *
+ *   jsonTickPool  - fixed blocks for per-tick WebSocket frames (loop task)
+ *   jsonWebPool   - fixed blocks for HTTP API responses (AsyncTCP task)
+ *   jsonLargeArena - PSRAM bump arena for sync payloads and config documents
+ *
+ * Pool storage is reserved at boot, so the contiguous internal RAM that
+ * WiFi/TLS needs is not fragmented by short-lived documents. Requests that
+ * do not fit fall back to malloc() and are counted. Also builds on the host
+ * (no PSRAM there, the arena always falls back).
+ */
+
+#ifndef MEM_POOLS_H
+#define MEM_POOLS_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#else
+#include <mutex>
+#endif
+
+// ============================================
+// Memory Pool Configuration
+// ============================================
+
+// Small blocks hold copied strings, large blocks one ArduinoJson slot pool
+#ifndef MEM_POOL_SMALL_BLOCK
+#define MEM_POOL_SMALL_BLOCK 64
+#endif
+
+#ifndef MEM_POOL_LARGE_BLOCK
+#define MEM_POOL_LARGE_BLOCK 2048
+#endif
+
+// Arena size when PSRAM is available (bytes)
+#ifndef MEM_ARENA_PSRAM_SIZE
+#define MEM_ARENA_PSRAM_SIZE 65536
+#endif
+
+// ============================================
+// Memory Pool Types
+// ============================================
+
+struct MemPoolStats {
+  const char *name;
+  uint32_t capacity;    // Bytes reserved (0 = arena not available)
+  uint32_t used;        // Bytes in use, whole blocks for pools
+  uint32_t highWater;   // Peak of used
+  uint32_t allocations; // Served from the pool or arena
+  uint32_t fallbacks;   // Served by malloc() instead
+  uint32_t failures;    // malloc() failed as well
+};
+
+/**
+ * Base class: statistics, locking and the malloc() fallback
+ */
+class TrackedAllocator : public ArduinoJson::Allocator {
+public:
+  MemPoolStats stats;
+
+  explicit TrackedAllocator(const char *name) {
+    memset(&stats, 0, sizeof(stats));
+    stats.name = name;
+  }
+
+protected:
+#ifdef ARDUINO
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+  void lock() { portENTER_CRITICAL(&mux); }
+  void unlock() { portEXIT_CRITICAL(&mux); }
+#else
+  std::mutex mutex;
+  void lock() { mutex.lock(); }
+  void unlock() { mutex.unlock(); }
+#endif
+
+  void *fallback(size_t size) {
+    void *ptr = malloc(size);
+    lock();
+    if (ptr) {
+      stats.fallbacks++;
+    } else {
+      stats.failures++;
+    }
+    unlock();
+    return ptr;
+  }
+
+  void addUsed(uint32_t bytes) {
+    stats.used += bytes;
+    if (stats.used > stats.highWater) {
+      stats.highWater = stats.used;
+    }
+  }
+};
+
+/**
+ * Two size classes of fixed blocks tracked by a free bitmap (max 32 each)
+ */
+template <uint8_t SmallBlocks, uint8_t LargeBlocks>
+class PoolAllocator : public TrackedAllocator {
+public:
+  explicit PoolAllocator(const char *name) : TrackedAllocator(name) {
+    stats.capacity = sizeof(small) + sizeof(large);
+  }
+
+  void *allocate(size_t size) override {
+    void *ptr = NULL;
+    lock();
+    if (size <= MEM_POOL_SMALL_BLOCK) {
+      ptr = take(smallUsed, SmallBlocks, small[0], MEM_POOL_SMALL_BLOCK);
+    }
+    if (!ptr && size <= MEM_POOL_LARGE_BLOCK) {
+      ptr = take(largeUsed, LargeBlocks, large[0], MEM_POOL_LARGE_BLOCK);
+    }
+    unlock();
+    return ptr ? ptr : fallback(size);
+  }
+
+  void deallocate(void *ptr) override {
+    size_t blockSize = blockSizeOf(ptr);
+    if (blockSize == 0) {
+      free(ptr);
+      return;
+    }
+
+    lock();
+    if (blockSize == MEM_POOL_SMALL_BLOCK) {
+      smallUsed &= ~(1UL << indexOf(ptr, small[0], blockSize));
+    } else {
+      largeUsed &= ~(1UL << indexOf(ptr, large[0], blockSize));
+    }
+    stats.used -= blockSize;
+    unlock();
+  }
+
+  void *reallocate(void *ptr, size_t size) override {
+    if (!ptr) {
+      return allocate(size);
+    }
+    size_t blockSize = blockSizeOf(ptr);
+    if (blockSize == 0) {
+      return realloc(ptr, size);
+    }
+    if (size <= blockSize) {
+      return ptr;
+    }
+
+    void *moved = allocate(size);
+    if (moved) {
+      memcpy(moved, ptr, blockSize);
+      deallocate(ptr);
+    }
+    return moved;
+  }
+
+private:
+  uint8_t small[SmallBlocks][MEM_POOL_SMALL_BLOCK] __attribute__((aligned(8)));
+  uint8_t large[LargeBlocks][MEM_POOL_LARGE_BLOCK] __attribute__((aligned(8)));
+  uint32_t smallUsed = 0;
+  uint32_t largeUsed = 0;
+
+  static_assert(SmallBlocks <= 32 && LargeBlocks <= 32,
+                "PoolAllocator bitmaps hold 32 blocks per size class");
+
+  void *take(uint32_t &used, uint8_t count, uint8_t *base, size_t blockSize) {
+    uint32_t freeMask = ~used & (count == 32 ? 0xFFFFFFFFUL : (1UL << count) - 1);
+    if (freeMask == 0) {
+      return NULL;
+    }
+    uint8_t index = __builtin_ctz(freeMask);
+    used |= 1UL << index;
+    stats.allocations++;
+    addUsed(blockSize);
+    return base + index * blockSize;
+  }
+
+  static size_t indexOf(const void *ptr, const uint8_t *base, size_t blockSize) {
+    return ((const uint8_t *)ptr - base) / blockSize;
+  }
+
+  // Block size of a pool pointer, 0 for malloc() pointers
+  size_t blockSizeOf(const void *ptr) const {
+    const uint8_t *p = (const uint8_t *)ptr;
+    if (p >= small[0] && p < small[0] + sizeof(small)) {
+      return MEM_POOL_SMALL_BLOCK;
+    }
+    if (p >= large[0] && p < large[0] + sizeof(large)) {
+      return MEM_POOL_LARGE_BLOCK;
+    }
+    return 0;
+  }
+};
+
+/**
+ * Bump arena, rewound once every allocation in it has been freed
+ * Each block carries an 8-byte size header so it can grow in place
+ */
+class ArenaAllocator : public TrackedAllocator {
+public:
+  explicit ArenaAllocator(const char *name) : TrackedAllocator(name) {}
+
+  /**
+   * Attach backing memory, NULL/0 leaves the arena disabled
+   */
+  void begin(uint8_t *memory, size_t size) {
+    lock();
+    base = memory;
+    stats.capacity = memory ? size : 0;
+    unlock();
+  }
+
+  void *allocate(size_t size) override {
+    size_t need = HEADER + align(size);
+    lock();
+    if (!base || offset + need > stats.capacity) {
+      unlock();
+      return fallback(size);
+    }
+
+    uint8_t *block = base + offset;
+    ((uint32_t *)block)[0] = size;
+    lastOffset = offset;
+    offset += need;
+    live++;
+    stats.allocations++;
+    setUsed();
+    unlock();
+    return block + HEADER;
+  }
+
+  void deallocate(void *ptr) override {
+    if (!owns(ptr)) {
+      free(ptr);
+      return;
+    }
+
+    lock();
+    size_t blockOffset = (uint8_t *)ptr - HEADER - base;
+    if (--live == 0) {
+      offset = 0;
+    } else if (blockOffset == lastOffset) {
+      offset = lastOffset;
+    }
+    lastOffset = NO_BLOCK;
+    setUsed();
+    unlock();
+  }
+
+  void *reallocate(void *ptr, size_t size) override {
+    if (!ptr) {
+      return allocate(size);
+    }
+    if (!owns(ptr)) {
+      return realloc(ptr, size);
+    }
+
+    uint8_t *block = (uint8_t *)ptr - HEADER;
+    size_t blockOffset = block - base;
+    size_t oldSize = ((uint32_t *)block)[0];
+
+    // Newest block: grow or shrink in place
+    lock();
+    if (blockOffset == lastOffset &&
+        blockOffset + HEADER + align(size) <= stats.capacity) {
+      ((uint32_t *)block)[0] = size;
+      offset = blockOffset + HEADER + align(size);
+      setUsed();
+      unlock();
+      return ptr;
+    }
+    unlock();
+
+    if (size <= oldSize) {
+      return ptr;
+    }
+    void *moved = allocate(size);
+    if (moved) {
+      memcpy(moved, ptr, oldSize);
+      deallocate(ptr);
+    }
+    return moved;
+  }
+
+private:
+  static const size_t HEADER = 8;
+  static const size_t NO_BLOCK = (size_t)-1;
+
+  uint8_t *base = NULL;
+  size_t offset = 0;
+  size_t lastOffset = NO_BLOCK;
+  uint32_t live = 0;
+
+  static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+
+  bool owns(const void *ptr) const {
+    const uint8_t *p = (const uint8_t *)ptr;
+    return base && p >= base && p < base + stats.capacity;
+  }
+
+  void setUsed() {
+    stats.used = offset;
+    if (stats.used > stats.highWater) {
+      stats.highWater = stats.used;
+    }
+  }
+};
+
+// ============================================
+// Memory Pool Variables
+// ============================================
+PoolAllocator<16, 2> jsonTickPool("tick");
+PoolAllocator<24, 3> jsonWebPool("web");
+ArenaAllocator jsonLargeArena("large");
+
+TrackedAllocator *const memPools[] = {&jsonTickPool, &jsonWebPool,
+                                      &jsonLargeArena};
+
+// ============================================
+// Memory Pool Functions
+// ============================================
+
+/**
+ * Back the large-document arena with PSRAM when the board has it
+ */
+void initMemPools() {
+#ifdef ARDUINO
+  if (psramFound()) {
+    uint8_t *memory = (uint8_t *)heap_caps_malloc(
+        MEM_ARENA_PSRAM_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    jsonLargeArena.begin(memory, memory ? MEM_ARENA_PSRAM_SIZE : 0);
+  }
+#endif
+}
+
+/**
+ * Add per-pool usage and heap fragmentation figures to a JSON object
+ */
+void addMemoryJSON(JsonObject memory) {
+  JsonArray pools = memory["pools"].to<JsonArray>();
+  for (size_t i = 0; i < sizeof(memPools) / sizeof(memPools[0]); i++) {
+    const MemPoolStats &stats = memPools[i]->stats;
+    JsonObject pool = pools.add<JsonObject>();
+    pool["name"] = stats.name;
+    pool["capacity"] = stats.capacity;
+    pool["used"] = stats.used;
+    pool["high_water"] = stats.highWater;
+    pool["allocations"] = stats.allocations;
+    pool["fallbacks"] = stats.fallbacks;
+    pool["failures"] = stats.failures;
+  }
+
+#ifdef ARDUINO
+  memory["internal_free"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  memory["internal_largest_block"] =
+      heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  memory["internal_min_free"] =
+      heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  memory["psram_free"] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+#endif
+}
+
+#endif // MEM_POOLS_H
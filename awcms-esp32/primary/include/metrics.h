@@ -0,0 +1,57 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Device Metrics
+ *
+ * Boot milestones and counters reported by /api/metrics.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ============================================
+// Metrics Types
+// ============================================
+
+// Milliseconds since boot, 0 = not reached yet
+struct BootMetrics {
+  uint32_t firstReadingMs;
+  uint32_t wifiConnectedMs;
+  uint32_t firstUploadMs;
+  bool wifiFastConnect; // Connected using the cached BSSID/channel/IP
+};
+
+// ============================================
+// Metrics Variables
+// ============================================
+BootMetrics bootMetrics = {0, 0, 0, false};
+
+// ============================================
+// Metrics Functions
+// ============================================
+
+/**
+ * Record a boot milestone the first time it is reached
+ */
+void markBootMilestone(uint32_t &milestone) {
+  if (milestone == 0) {
+    milestone = millis();
+    if (milestone == 0) {
+      milestone = 1;
+    }
+  }
+}
+
+/**
+ * Add boot milestones to a metrics JSON object
+ */
+void addBootMetricsJSON(JsonObject boot) {
+  boot["time_to_first_reading_ms"] = bootMetrics.firstReadingMs;
+  boot["time_to_wifi_ms"] = bootMetrics.wifiConnectedMs;
+  boot["time_to_first_upload_ms"] = bootMetrics.firstUploadMs;
+  boot["wifi_fast_connect"] = bootMetrics.wifiFastConnect;
+}
+
+#endif // METRICS_H
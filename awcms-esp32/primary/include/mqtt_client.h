@@ -0,0 +1,432 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * MQTT Transport
+ *
+ * Alternative to PostgREST inserts for high-rate telemetry: one persistent
+ * MQTT session that publishes outbox rows to
+ * "<MQTT_TOPIC_PREFIX>/<TENANT_ID>/<DEVICE_ID>/<table>" with the same JSON
+ * body. Each row costs a few bytes of framing instead of a TLS handshake
+ * and HTTP headers. Rows leave the outbox only when the broker has them
+ * (PUBACK at QoS 1), so priorities and store-and-forward work as for REST.
+ * A retained ".../status" topic reads "online", or "offline" through the
+ * last will.
+ *
+ * Selected by "transport": "mqtt" in devices.config, or at build time
+ * with SYNC_TRANSPORT=TRANSPORT_MQTT.
+ */
+
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include "config.h"
+#include "device_config.h"
+#include "metrics.h"
+#include "mqtt_codec.h"
+#include "outbox.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+
+// ============================================
+// MQTT Configuration
+// ============================================
+
+// Broker host, empty = MQTT not available
+#ifndef MQTT_HOST
+#define MQTT_HOST ""
+#endif
+
+#ifndef MQTT_TLS
+#define MQTT_TLS false
+#endif
+
+// With TLS, define MQTT_CA_CERT (PEM) to verify the broker
+
+#ifndef MQTT_PORT
+#define MQTT_PORT (MQTT_TLS ? 8883 : 1883)
+#endif
+
+#ifndef MQTT_TOPIC_PREFIX
+#define MQTT_TOPIC_PREFIX "awcms"
+#endif
+
+// QoS for routine rows; high-priority rows (alarms) always use QoS 1
+#ifndef MQTT_QOS
+#define MQTT_QOS 1
+#endif
+
+#ifndef MQTT_KEEPALIVE
+#define MQTT_KEEPALIVE 60 // s
+#endif
+
+// Resend an unacknowledged QoS 1 publish after this long (ms)
+#ifndef MQTT_ACK_TIMEOUT
+#define MQTT_ACK_TIMEOUT 10000
+#endif
+
+// Reconnect backoff, doubled per failure (ms)
+#ifndef MQTT_RECONNECT_MIN
+#define MQTT_RECONNECT_MIN 2000
+#endif
+
+#ifndef MQTT_RECONNECT_MAX
+#define MQTT_RECONNECT_MAX 60000
+#endif
+
+// Resends before the session is dropped and reopened
+#define MQTT_MAX_RETRIES 3
+#define MQTT_TOPIC_MAX 128
+
+// ============================================
+// MQTT Types
+// ============================================
+
+enum MqttState { MQTT_OFFLINE, MQTT_WAIT_CONNACK, MQTT_ONLINE };
+
+struct MqttInflight {
+  bool active;
+  uint32_t seq; // Outbox entry waiting for its PUBACK
+  uint16_t packetId;
+  uint8_t retries;
+  unsigned long sentAt;
+};
+
+struct MqttStats {
+  uint32_t connects;
+  uint32_t failures;
+  uint32_t published;
+  uint32_t acked;
+  uint32_t resent;
+  uint32_t framingBytes; // Bytes sent besides row bodies
+  uint32_t bodyBytes;
+};
+
+// ============================================
+// MQTT Variables
+// ============================================
+#if MQTT_TLS
+WiFiClientSecure mqttNet;
+#else
+WiFiClient mqttNet;
+#endif
+MqttState mqttState = MQTT_OFFLINE;
+MqttReader mqttReader;
+MqttInflight mqttInflight = {false, 0, 0, 0, 0};
+MqttStats mqttStats = {0, 0, 0, 0, 0, 0, 0};
+uint16_t mqttNextId = 1;
+unsigned long mqttLastSend = 0;
+unsigned long mqttStateSince = 0;
+bool mqttBackingOff = false; // Waiting mqttRetryDelay from mqttFailedAt
+unsigned long mqttFailedAt = 0;
+uint32_t mqttRetryDelay = 0;
+uint32_t mqttBackoff = MQTT_RECONNECT_MIN; // Next retry delay
+
+// ============================================
+// MQTT Functions
+// ============================================
+
+/**
+ * True when uploads should go over MQTT (configured and selected)
+ */
+bool mqttSelected() {
+  return MQTT_HOST[0] != '\0' && deviceConfig.transport == TRANSPORT_MQTT;
+}
+
+/**
+ * "<prefix>/<tenant>/<device>/<leaf>"
+ */
+void mqttTopic(const char *leaf, char *out, size_t len) {
+  snprintf(out, len, "%s/%s/%s/%s", MQTT_TOPIC_PREFIX, TENANT_ID, DEVICE_ID,
+           leaf);
+}
+
+bool mqttSend(const uint8_t *buf, size_t len) {
+  if (mqttNet.write(buf, len) != len) {
+    return false;
+  }
+  mqttLastSend = millis();
+  return true;
+}
+
+/**
+ * Drop the session and schedule a reconnect with backoff
+ */
+void mqttDrop(const char *reason) {
+  mqttNet.stop();
+  if (mqttState != MQTT_OFFLINE) {
+    DEBUG_PRINTF("MQTT disconnected: %s\n", reason);
+  }
+  mqttState = MQTT_OFFLINE;
+  mqttInflight.active = false; // The row is still queued, resent later
+  mqttStats.failures++;
+  mqttBackingOff = true;
+  mqttFailedAt = millis();
+  mqttRetryDelay = mqttBackoff;
+  mqttBackoff = mqttBackoff * 2 > MQTT_RECONNECT_MAX ? MQTT_RECONNECT_MAX
+                                                     : mqttBackoff * 2;
+}
+
+/**
+ * Open the TCP/TLS connection and send CONNECT, the CONNACK arrives in
+ * updateMqtt()
+ */
+void mqttOpen() {
+  static uint8_t buf[256];
+  char willTopic[MQTT_TOPIC_MAX];
+  mqttTopic("status", willTopic, sizeof(willTopic));
+
+#if MQTT_TLS && defined(MQTT_CA_CERT)
+  mqttNet.setCACert(MQTT_CA_CERT);
+#elif MQTT_TLS
+  mqttNet.setInsecure();
+#endif
+  if (!mqttNet.connect(MQTT_HOST, MQTT_PORT)) {
+    mqttDrop("connect failed");
+    return;
+  }
+  mqttNet.setNoDelay(true); // Header and body are separate writes
+
+  MqttConnectOptions options = {};
+  options.clientId = DEVICE_ID;
+#ifdef MQTT_USERNAME
+  options.username = MQTT_USERNAME;
+#endif
+#ifdef MQTT_PASSWORD
+  options.password = MQTT_PASSWORD;
+#endif
+  options.keepAliveSec = MQTT_KEEPALIVE;
+  options.willTopic = willTopic;
+  options.willMessage = "offline";
+  options.willRetain = true;
+  options.cleanSession = true;
+
+  size_t len = mqttEncodeConnect(buf, sizeof(buf), options);
+  mqttReaderReset(mqttReader);
+  if (len == 0 || !mqttSend(buf, len)) {
+    mqttDrop("CONNECT not sent");
+    return;
+  }
+  mqttState = MQTT_WAIT_CONNACK;
+  mqttStateSince = millis();
+}
+
+/**
+ * Publish one message, body written straight from the caller's buffer
+ */
+bool mqttPublish(const char *topic, const char *body, size_t len, uint8_t qos,
+                 bool retain, bool dup, uint16_t packetId) {
+  uint8_t header[MQTT_TOPIC_MAX + 16];
+  size_t n = mqttEncodePublishHeader(header, sizeof(header), topic, len, qos,
+                                     retain, dup, packetId);
+  if (n == 0 || !mqttSend(header, n) ||
+      mqttNet.write((const uint8_t *)body, len) != len) {
+    return false;
+  }
+  mqttStats.framingBytes += n;
+  mqttStats.bodyBytes += len;
+  return true;
+}
+
+/**
+ * Handle a complete incoming packet
+ */
+void mqttHandlePacket() {
+  switch (mqttReader.type & 0xF0) {
+  case MQTT_CONNACK: {
+    int code = mqttConnackCode(mqttReader);
+    if (code != 0) {
+      DEBUG_PRINTF("MQTT refused: %d\n", code);
+      mqttDrop("CONNACK refused");
+      return;
+    }
+    char topic[MQTT_TOPIC_MAX];
+    mqttTopic("status", topic, sizeof(topic));
+    mqttPublish(topic, "online", 6, 0, true, false, 0);
+    mqttState = MQTT_ONLINE;
+    mqttStats.connects++;
+    mqttBackingOff = false;
+    mqttBackoff = MQTT_RECONNECT_MIN;
+    DEBUG_PRINTF("MQTT connected to %s:%d\n", MQTT_HOST, MQTT_PORT);
+    break;
+  }
+
+  case MQTT_PUBACK: {
+    uint16_t id = mqttPubackId(mqttReader);
+    if (!mqttInflight.active || id != mqttInflight.packetId) {
+      return;
+    }
+    mqttInflight.active = false;
+    mqttStats.acked++;
+    // The broker has the row, so the image can reach the backend (ota.h)
+    markBootMilestone(bootMetrics.firstUploadMs);
+    // The slot may have been reused while we waited
+    for (size_t i = 0; i < OUTBOX_CAPACITY; i++) {
+      if (outbox[i].used && outbox[i].seq == mqttInflight.seq) {
+        outboxPop(&outbox[i]);
+        break;
+      }
+    }
+    break;
+  }
+
+  default: // PINGRESP and anything unexpected
+    break;
+  }
+}
+
+/**
+ * Close the session cleanly (transport switched back to REST)
+ */
+void stopMqtt() {
+  mqttBackingOff = false;
+  mqttBackoff = MQTT_RECONNECT_MIN;
+  if (mqttState == MQTT_OFFLINE) {
+    return;
+  }
+  uint8_t buf[2];
+  mqttSend(buf, mqttEncodeEmpty(buf, MQTT_DISCONNECT));
+  mqttNet.stop();
+  mqttState = MQTT_OFFLINE;
+  mqttInflight.active = false;
+}
+
+/**
+ * Keep the session up: connect, read acks, ping, resend; call from loop()
+ */
+void updateMqtt() {
+  if (MQTT_HOST[0] == '\0') {
+    return;
+  }
+  unsigned long now = millis();
+  if (mqttState == MQTT_OFFLINE) {
+    // Elapsed time, not a stored deadline, so it never wraps into a long wait
+    if (mqttBackingOff && now - mqttFailedAt >= mqttRetryDelay) {
+      mqttBackingOff = false;
+    }
+    if (!mqttBackingOff) {
+      mqttOpen();
+    }
+    return;
+  }
+  if (!mqttNet.connected()) {
+    mqttDrop("connection lost");
+    return;
+  }
+
+  while (mqttNet.available() > 0) {
+    if (mqttReaderPush(mqttReader, (uint8_t)mqttNet.read())) {
+      mqttHandlePacket();
+      if (mqttState == MQTT_OFFLINE) {
+        return;
+      }
+    }
+  }
+
+  if (mqttState == MQTT_WAIT_CONNACK) {
+    if (now - mqttStateSince > MQTT_ACK_TIMEOUT) {
+      mqttDrop("no CONNACK");
+    }
+    return;
+  }
+
+  if (mqttInflight.active && now - mqttInflight.sentAt > MQTT_ACK_TIMEOUT) {
+    // Unacknowledged: the outbox row goes out again with DUP set
+    if (++mqttInflight.retries > MQTT_MAX_RETRIES) {
+      mqttDrop("no PUBACK");
+      return;
+    }
+    for (size_t i = 0; i < OUTBOX_CAPACITY; i++) {
+      OutboxEntry &entry = outbox[i];
+      if (entry.used && entry.seq == mqttInflight.seq) {
+        char topic[MQTT_TOPIC_MAX];
+        mqttTopic(entry.table, topic, sizeof(topic));
+        mqttPublish(topic, entry.body.c_str(), entry.body.length(), 1, false,
+                    true, mqttInflight.packetId);
+        mqttStats.resent++;
+        break;
+      }
+    }
+    mqttInflight.sentAt = now;
+  }
+
+  if (now - mqttLastSend >= MQTT_KEEPALIVE * 1000UL / 2) {
+    uint8_t buf[2];
+    mqttSend(buf, mqttEncodeEmpty(buf, MQTT_PINGREQ));
+    mqttStats.framingBytes += 2;
+  }
+}
+
+/**
+ * Publish the next outbox row, one in flight at a time like drainOutbox()
+ * Returns true when a row was handed to the broker
+ */
+bool drainOutboxMqtt() {
+  if (mqttState != MQTT_ONLINE || mqttInflight.active) {
+    return false;
+  }
+  OutboxEntry *entry = outboxPeek();
+  if (!entry) {
+    return false;
+  }
+
+  char topic[MQTT_TOPIC_MAX];
+  mqttTopic(entry->table, topic, sizeof(topic));
+  uint8_t qos = entry->priority > OUTBOX_PRIORITY_NORMAL ? 1 : MQTT_QOS;
+  uint16_t packetId = qos ? mqttNextId : 0;
+  if (!mqttPublish(topic, entry->body.c_str(), entry->body.length(), qos,
+                   false, false, packetId)) {
+    mqttDrop("publish failed");
+    return false;
+  }
+  mqttStats.published++;
+
+  if (qos == 0) {
+    outboxPop(entry);
+    return true;
+  }
+  mqttNextId = mqttNextId == 0xFFFF ? 1 : mqttNextId + 1;
+  mqttInflight.active = true;
+  mqttInflight.seq = entry->seq;
+  mqttInflight.packetId = packetId;
+  mqttInflight.retries = 0;
+  mqttInflight.sentAt = millis();
+  return true;
+}
+
+/**
+ * True while a CONNACK or PUBACK is due, loop() polls the socket quickly
+ */
+bool mqttWaiting() {
+  return mqttState == MQTT_WAIT_CONNACK || mqttInflight.active;
+}
+
+const char *getMqttStateName() {
+  switch (mqttState) {
+  case MQTT_WAIT_CONNACK:
+    return "connecting";
+  case MQTT_ONLINE:
+    return "online";
+  default:
+    return "offline";
+  }
+}
+
+/**
+ * Add session state and per-message overhead to a metrics JSON object
+ */
+void addMqttJSON(JsonObject mqtt) {
+  mqtt["state"] = getMqttStateName();
+  mqtt["connects"] = mqttStats.connects;
+  mqtt["failures"] = mqttStats.failures;
+  mqtt["published"] = mqttStats.published;
+  mqtt["acked"] = mqttStats.acked;
+  mqtt["resent"] = mqttStats.resent;
+  mqtt["inflight"] = mqttInflight.active;
+  mqtt["framing_bytes_avg"] =
+      mqttStats.published ? mqttStats.framingBytes / mqttStats.published : 0;
+  mqtt["body_bytes_avg"] =
+      mqttStats.published ? mqttStats.bodyBytes / mqttStats.published : 0;
+}
+
+#endif // MQTT_CLIENT_H
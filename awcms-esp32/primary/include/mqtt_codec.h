@@ -0,0 +1,222 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * MQTT Codec
+ *
+ * The few MQTT 3.1.1 packets a publish-only client needs: CONNECT (with a
+ * retained last will), PUBLISH at QoS 0/1, PINGREQ and DISCONNECT out;
+ * CONNACK, PUBACK and PINGRESP in. Encoders write into caller buffers and
+ * the reader is fed whatever bytes arrive, so nothing here allocates or
+ * touches a socket. No Arduino dependencies; the host client is
+ * bench/mqtt_pub.cpp.
+ */
+
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// MQTT Codec Configuration
+// ============================================
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+// Bytes kept of an incoming packet body (larger bodies are skipped)
+#define MQTT_RX_MAX 8
+
+// ============================================
+// MQTT Codec Types
+// ============================================
+
+struct MqttConnectOptions {
+  const char *clientId;
+  const char *username; // NULL = none
+  const char *password;
+  uint16_t keepAliveSec;
+  const char *willTopic; // NULL = no last will
+  const char *willMessage;
+  bool willRetain;
+  bool cleanSession;
+};
+
+struct MqttReader {
+  uint8_t state; // 0 = type, 1 = length, 2 = body
+  uint8_t type;  // First byte of the packet
+  uint32_t length;
+  uint8_t lengthShift;
+  uint32_t have;
+  uint8_t body[MQTT_RX_MAX];
+};
+
+// ============================================
+// MQTT Codec Functions
+// ============================================
+
+/**
+ * Remaining-length varint, returns bytes written (at most 4)
+ */
+size_t mqttEncodeLength(uint8_t *out, uint32_t len) {
+  size_t n = 0;
+  do {
+    uint8_t byte = len % 128;
+    len /= 128;
+    out[n++] = len ? byte | 0x80 : byte;
+  } while (len && n < 4);
+  return n;
+}
+
+size_t mqttPutString(uint8_t *out, const char *text) {
+  size_t len = strlen(text);
+  out[0] = len >> 8;
+  out[1] = len & 0xFF;
+  memcpy(out + 2, text, len);
+  return len + 2;
+}
+
+/**
+ * CONNECT packet, returns its size or 0 if cap is too small
+ */
+size_t mqttEncodeConnect(uint8_t *buf, size_t cap,
+                         const MqttConnectOptions &options) {
+  size_t body = 10 + 2 + strlen(options.clientId);
+  uint8_t flags = options.cleanSession ? 0x02 : 0;
+  if (options.willTopic) {
+    body += 2 + strlen(options.willTopic) + 2 + strlen(options.willMessage);
+    flags |= 0x04 | (options.willRetain ? 0x20 : 0);
+  }
+  if (options.username) {
+    body += 2 + strlen(options.username);
+    flags |= 0x80;
+  }
+  if (options.username && options.password) {
+    body += 2 + strlen(options.password);
+    flags |= 0x40;
+  }
+  if (body + 5 > cap) {
+    return 0;
+  }
+
+  size_t n = 0;
+  buf[n++] = MQTT_CONNECT;
+  n += mqttEncodeLength(buf + n, body);
+  n += mqttPutString(buf + n, "MQTT");
+  buf[n++] = 4; // Protocol level 3.1.1
+  buf[n++] = flags;
+  buf[n++] = options.keepAliveSec >> 8;
+  buf[n++] = options.keepAliveSec & 0xFF;
+  n += mqttPutString(buf + n, options.clientId);
+  if (options.willTopic) {
+    n += mqttPutString(buf + n, options.willTopic);
+    n += mqttPutString(buf + n, options.willMessage);
+  }
+  if (flags & 0x80) {
+    n += mqttPutString(buf + n, options.username);
+  }
+  if (flags & 0x40) {
+    n += mqttPutString(buf + n, options.password);
+  }
+  return n;
+}
+
+/**
+ * PUBLISH fixed header, topic and packet id; the payload follows as is
+ * so it is never copied. Returns the header size or 0 if cap is too small.
+ */
+size_t mqttEncodePublishHeader(uint8_t *buf, size_t cap, const char *topic,
+                               uint32_t payloadLen, uint8_t qos, bool retain,
+                               bool dup, uint16_t packetId) {
+  size_t topicLen = strlen(topic);
+  uint32_t body = 2 + topicLen + (qos ? 2 : 0) + payloadLen;
+  if (5 + 2 + topicLen + 2 > cap) {
+    return 0;
+  }
+
+  size_t n = 0;
+  buf[n++] = MQTT_PUBLISH | (dup ? 0x08 : 0) | (qos << 1) | (retain ? 1 : 0);
+  n += mqttEncodeLength(buf + n, body);
+  n += mqttPutString(buf + n, topic);
+  if (qos) {
+    buf[n++] = packetId >> 8;
+    buf[n++] = packetId & 0xFF;
+  }
+  return n;
+}
+
+/**
+ * Two-byte packets: PINGREQ, DISCONNECT
+ */
+size_t mqttEncodeEmpty(uint8_t *buf, uint8_t type) {
+  buf[0] = type;
+  buf[1] = 0;
+  return 2;
+}
+
+void mqttReaderReset(MqttReader &r) { memset(&r, 0, sizeof(r)); }
+
+/**
+ * Feed one received byte, true when it completed a packet (r.type,
+ * r.length and the first MQTT_RX_MAX body bytes are then valid)
+ */
+bool mqttReaderPush(MqttReader &r, uint8_t byte) {
+  switch (r.state) {
+  case 0:
+    r.type = byte;
+    r.length = 0;
+    r.lengthShift = 0;
+    r.have = 0;
+    r.state = 1;
+    return false;
+
+  case 1:
+    r.length |= (uint32_t)(byte & 0x7F) << r.lengthShift;
+    r.lengthShift += 7;
+    if (byte & 0x80) {
+      return false;
+    }
+    if (r.length == 0) {
+      r.state = 0;
+      return true;
+    }
+    r.state = 2;
+    return false;
+
+  default:
+    if (r.have < MQTT_RX_MAX) {
+      r.body[r.have] = byte;
+    }
+    if (++r.have < r.length) {
+      return false;
+    }
+    r.state = 0;
+    return true;
+  }
+}
+
+/**
+ * Packet id of a PUBACK, 0 for anything else
+ */
+uint16_t mqttPubackId(const MqttReader &r) {
+  if ((r.type & 0xF0) != MQTT_PUBACK || r.length < 2) {
+    return 0;
+  }
+  return (uint16_t)r.body[0] << 8 | r.body[1];
+}
+
+/**
+ * CONNACK return code (0 = accepted), -1 when r holds no CONNACK
+ */
+int mqttConnackCode(const MqttReader &r) {
+  if ((r.type & 0xF0) != MQTT_CONNACK || r.length < 2) {
+    return -1;
+  }
+  return r.body[1];
+}
+
+#endif // MQTT_CODEC_H
@@ -0,0 +1,533 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Delta OTA Updates
+ *
+ * Fetches "<OTA_URL>/<sha256 of the running image>.awdp", a delta made by
+ * scripts/make_delta.py, and streams it through delta_patch.h straight
+ * into the inactive OTA partition: the source is read from the running
+ * partition, so neither image is ever held in RAM. The header's signature
+ * and source hash are checked before anything is erased, the target hash
+ * after the last byte is written. A 404 means no update for this image.
+ *
+ * The update runs in a low-priority task on the protocol core; loop()
+ * keeps sampling, alarming and syncing, and the reboot waits while gas is
+ * at danger level. The new image must confirm itself (uptime plus one
+ * successful upload) within OTA_BOOT_ATTEMPTS boots, otherwise the device
+ * switches back to the previous partition.
+ */
+
+#ifndef OTA_H
+#define OTA_H
+
+#include "config.h"
+#include "delta_patch.h"
+#include "gas_sensor.h"
+#include "metrics.h"
+#include "outbox.h"
+#include "sha256.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <WiFiClientSecure.h>
+#include <esp_image_format.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mbedtls/pk.h>
+
+// ============================================
+// OTA Configuration
+// ============================================
+
+// Base URL of the patch directory, empty = only POST /api/ota?url=
+#ifndef OTA_URL
+#define OTA_URL ""
+#endif
+
+// Check for a patch this often (ms), 0 = only on request
+#ifndef OTA_CHECK_INTERVAL
+#define OTA_CHECK_INTERVAL 0
+#endif
+
+// PEM public key patches must be signed with (define in config.h).
+// Without one, patches are refused unless OTA_ALLOW_UNSIGNED is true.
+#ifndef OTA_ALLOW_UNSIGNED
+#define OTA_ALLOW_UNSIGNED false
+#endif
+
+// Boots the new image gets to confirm itself before rolling back
+#ifndef OTA_BOOT_ATTEMPTS
+#define OTA_BOOT_ATTEMPTS 3
+#endif
+
+// Uptime before a new image counts as healthy (ms), once it has uploaded
+#ifndef OTA_HEALTHY_MS
+#define OTA_HEALTHY_MS 120000
+#endif
+
+// Give up when the download stalls this long (ms)
+#ifndef OTA_STALL_TIMEOUT
+#define OTA_STALL_TIMEOUT 30000
+#endif
+
+#define OTA_TASK_STACK 8192
+#define OTA_TASK_PRIORITY 1 // Below loop() and the job worker
+#define OTA_READ_CHUNK 1024
+#define OTA_URL_MAX 160
+#define OTA_NVS_NAMESPACE "awcms"
+#define OTA_NVS_KEY "ota"
+
+// ============================================
+// OTA Types
+// ============================================
+
+enum OtaState {
+  OTA_IDLE,
+  OTA_CHECKING,    // Hashing the running image, requesting the patch
+  OTA_DOWNLOADING, // Patch streaming into the inactive partition
+  OTA_REBOOTING,
+  OTA_CURRENT, // No patch for the running image
+  OTA_FAILED
+};
+
+// Survives the reboot into the new image (NVS)
+struct OtaBootRecord {
+  bool pending;
+  uint8_t attempts;
+  char previous[17]; // Partition labels
+  char target[17];
+};
+
+struct OtaStatus {
+  OtaState state;
+  uint32_t received; // Patch bytes
+  uint32_t written;  // Target bytes
+  uint32_t targetSize;
+  uint32_t lastCheckMs;
+  char error[64];
+};
+
+struct OtaContext {
+  const esp_partition_t *running;
+  const esp_partition_t *update;
+  esp_ota_handle_t handle;
+  bool begun;
+};
+
+// ============================================
+// OTA Variables
+// ============================================
+OtaStatus otaStatus = {OTA_IDLE, 0, 0, 0, 0, ""};
+uint8_t otaRunningSha[SHA256_SIZE];
+uint32_t otaRunningSize = 0;
+bool otaPendingVerify = false; // This boot runs an unconfirmed image
+char otaUrl[OTA_URL_MAX] = "";
+TaskHandle_t otaTask = NULL;
+
+// ============================================
+// OTA Functions
+// ============================================
+
+/**
+ * Keep rollback to us: Arduino would otherwise confirm every image at boot
+ */
+extern "C" bool verifyRollbackLater() { return true; }
+
+const char *otaStateName(OtaState state) {
+  switch (state) {
+  case OTA_CHECKING:
+    return "checking";
+  case OTA_DOWNLOADING:
+    return "downloading";
+  case OTA_REBOOTING:
+    return "rebooting";
+  case OTA_CURRENT:
+    return "current";
+  case OTA_FAILED:
+    return "failed";
+  default:
+    return "idle";
+  }
+}
+
+bool loadOtaRecord(OtaBootRecord &record) {
+  memset(&record, 0, sizeof(record));
+  Preferences prefs;
+  if (!prefs.begin(OTA_NVS_NAMESPACE, true)) {
+    return false;
+  }
+  bool ok = prefs.getBytesLength(OTA_NVS_KEY) == sizeof(record) &&
+            prefs.getBytes(OTA_NVS_KEY, &record, sizeof(record)) ==
+                sizeof(record);
+  prefs.end();
+  return ok;
+}
+
+void saveOtaRecord(const OtaBootRecord &record) {
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, false)) {
+    prefs.putBytes(OTA_NVS_KEY, &record, sizeof(record));
+    prefs.end();
+  }
+}
+
+/**
+ * Boot bookkeeping for a freshly installed image, call early in setup()
+ * Rolls back (and reboots) when the image has used up its attempts
+ */
+void checkOtaBoot() {
+  extern bool queueLogEvent(const char *, const char *, uint8_t);
+  OtaBootRecord record;
+  if (!loadOtaRecord(record) || !record.pending) {
+    return;
+  }
+
+  char message[96];
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (strcmp(running->label, record.target) != 0) {
+    // The bootloader (or we, last boot) already went back
+    snprintf(message, sizeof(message),
+             "Update on %s failed to confirm, running %s", record.target,
+             running->label);
+    queueLogEvent("ota", message, OUTBOX_PRIORITY_HIGH);
+    record.pending = false;
+    saveOtaRecord(record);
+    return;
+  }
+
+  record.attempts++;
+  if (record.attempts > OTA_BOOT_ATTEMPTS) {
+    const esp_partition_t *previous = esp_partition_find_first(
+        ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, record.previous);
+    DEBUG_PRINTF("OTA image not confirmed after %u boots, back to %s\n",
+                 (unsigned)OTA_BOOT_ATTEMPTS, record.previous);
+    if (previous && esp_ota_set_boot_partition(previous) == ESP_OK) {
+      saveOtaRecord(record);
+      ESP.restart();
+    }
+  }
+  saveOtaRecord(record);
+  otaPendingVerify = true;
+  DEBUG_PRINTF("OTA image on %s, boot %u of %u before rollback\n",
+               running->label, (unsigned)record.attempts,
+               (unsigned)OTA_BOOT_ATTEMPTS);
+}
+
+/**
+ * The new image works: keep it
+ */
+void confirmOtaImage() {
+  extern bool queueLogEvent(const char *, const char *, uint8_t);
+  OtaBootRecord record;
+  loadOtaRecord(record);
+  record.pending = false;
+  saveOtaRecord(record);
+  esp_ota_mark_app_valid_cancel_rollback();
+  otaPendingVerify = false;
+
+  char message[64];
+  snprintf(message, sizeof(message), "Update on %s confirmed after %u boot(s)",
+           record.target, (unsigned)record.attempts);
+  queueLogEvent("ota", message, OUTBOX_PRIORITY_HIGH);
+  DEBUG_PRINTLN(message);
+}
+
+/**
+ * Confirm a pending image once it has run long enough and reached the
+ * backend, call from loop()
+ */
+void updateOta() {
+  if (otaPendingVerify && millis() >= OTA_HEALTHY_MS &&
+      bootMetrics.firstUploadMs != 0) {
+    confirmOtaImage();
+  }
+}
+
+void otaFail(const char *error) {
+  strlcpy(otaStatus.error, error, sizeof(otaStatus.error));
+  otaStatus.state = OTA_FAILED;
+  DEBUG_PRINTF("OTA failed: %s\n", error);
+}
+
+/**
+ * SHA-256 of the running image, as make_delta.py hashes firmware.bin
+ */
+bool hashRunningImage(const esp_partition_t *running) {
+  esp_partition_pos_t pos = {running->address, running->size};
+  esp_image_metadata_t meta;
+  if (esp_image_get_metadata(&pos, &meta) != ESP_OK) {
+    return false;
+  }
+
+  static uint8_t buf[OTA_READ_CHUNK];
+  Sha256 sha;
+  sha256Init(sha);
+  for (uint32_t offset = 0; offset < meta.image_len; offset += sizeof(buf)) {
+    uint32_t len = meta.image_len - offset;
+    len = len < sizeof(buf) ? len : sizeof(buf);
+    if (esp_partition_read(running, offset, buf, len) != ESP_OK) {
+      return false;
+    }
+    sha256Update(sha, buf, len);
+  }
+  sha256Final(sha, otaRunningSha);
+  otaRunningSize = meta.image_len;
+  return true;
+}
+
+/**
+ * Check the header signature against OTA_PUBLIC_KEY
+ */
+bool verifyOtaSignature(const DeltaPatch &patch) {
+#ifdef OTA_PUBLIC_KEY
+  if (patch.sigLen == 0) {
+    return false;
+  }
+  uint8_t digest[SHA256_SIZE];
+  deltaHeaderHash(patch, digest);
+
+  mbedtls_pk_context pk;
+  mbedtls_pk_init(&pk);
+  bool ok = mbedtls_pk_parse_public_key(
+                &pk, (const unsigned char *)OTA_PUBLIC_KEY,
+                strlen(OTA_PUBLIC_KEY) + 1) == 0 &&
+            mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, sizeof(digest),
+                              patch.sig, patch.sigLen) == 0;
+  mbedtls_pk_free(&pk);
+  return ok;
+#else
+  return OTA_ALLOW_UNSIGNED;
+#endif
+}
+
+bool otaReadSource(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+  OtaContext *ota = (OtaContext *)ctx;
+  return esp_partition_read(ota->running, offset, buf, len) == ESP_OK;
+}
+
+bool otaWriteTarget(void *ctx, const uint8_t *buf, size_t len) {
+  OtaContext *ota = (OtaContext *)ctx;
+  otaStatus.written += len;
+  return esp_ota_write(ota->handle, buf, len) == ESP_OK;
+}
+
+/**
+ * Header in: all checks pass before the inactive partition is touched
+ */
+const char *otaCheckHeader(void *ctx, const DeltaPatch &patch) {
+  OtaContext *ota = (OtaContext *)ctx;
+  if (patch.header.sourceSize != otaRunningSize ||
+      memcmp(patch.header.sourceSha, otaRunningSha, SHA256_SIZE) != 0) {
+    return "patch is for a different image";
+  }
+  if (!verifyOtaSignature(patch)) {
+    return "bad or missing signature";
+  }
+  if (patch.header.targetSize > ota->update->size) {
+    return "image larger than the partition";
+  }
+
+  otaStatus.targetSize = patch.header.targetSize;
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+  // Erase sector by sector as data arrives, no long flash stall up front
+  esp_err_t err =
+      esp_ota_begin(ota->update, OTA_WITH_SEQUENTIAL_WRITES, &ota->handle);
+#else
+  esp_err_t err =
+      esp_ota_begin(ota->update, patch.header.targetSize, &ota->handle);
+#endif
+  if (err != ESP_OK) {
+    return "cannot open the update partition";
+  }
+  ota->begun = true;
+  return NULL;
+}
+
+/**
+ * Download and apply the patch for the running image
+ * Returns true when the new image is ready to boot
+ */
+bool runOtaUpdate(const char *baseUrl) {
+  static DeltaPatch patch;
+  static uint8_t buf[OTA_READ_CHUNK];
+  OtaContext ota = {esp_ota_get_running_partition(),
+                    esp_ota_get_next_update_partition(NULL), 0, false};
+
+  otaStatus.state = OTA_CHECKING;
+  otaStatus.received = otaStatus.written = otaStatus.targetSize = 0;
+  otaStatus.error[0] = '\0';
+  otaStatus.lastCheckMs = millis();
+  if (!ota.update) {
+    otaFail("no update partition");
+    return false;
+  }
+  if (otaRunningSize == 0 && !hashRunningImage(ota.running)) {
+    otaFail("cannot read the running image");
+    return false;
+  }
+
+  char hex[2 * SHA256_SIZE + 1];
+  sha256Hex(otaRunningSha, hex);
+  String url = String(baseUrl) + "/" + hex + ".awdp";
+
+  // TLS is not checked, the patch signature is what is trusted
+  WiFiClientSecure secure;
+  WiFiClient plain;
+  HTTPClient http;
+  bool https = url.startsWith("https");
+  if (https) {
+    secure.setInsecure();
+  }
+  if (!http.begin(https ? (WiFiClient &)secure : plain, url)) {
+    otaFail("bad URL");
+    return false;
+  }
+
+  int code = http.GET();
+  if (code == 404) {
+    http.end();
+    otaStatus.state = OTA_CURRENT;
+    DEBUG_PRINTLN("OTA: no patch for the running image");
+    return false;
+  }
+  if (code != 200) {
+    http.end();
+    char error[24];
+    snprintf(error, sizeof(error), "HTTP %d", code);
+    otaFail(error);
+    return false;
+  }
+
+  DEBUG_PRINTF("OTA: applying %s\n", url.c_str());
+  otaStatus.state = OTA_DOWNLOADING;
+  deltaBegin(patch, otaReadSource, otaWriteTarget, otaCheckHeader, &ota);
+
+  WiFiClient *stream = http.getStreamPtr();
+  unsigned long lastData = millis();
+  while (!deltaFinished(patch) && patch.state != DELTA_FAILED) {
+    size_t available = stream->available();
+    if (available == 0) {
+      if (!http.connected() || millis() - lastData > OTA_STALL_TIMEOUT) {
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    size_t n = stream->readBytes(buf, available < sizeof(buf) ? available
+                                                             : sizeof(buf));
+    lastData = millis();
+    deltaFeed(patch, buf, n);
+    otaStatus.received = patch.received;
+    vTaskDelay(1); // Let lower-priority work run between chunks
+  }
+  http.end();
+
+  if (!deltaFinished(patch)) {
+    if (ota.begun) {
+      esp_ota_abort(ota.handle);
+    }
+    otaFail(patch.error ? patch.error : "download interrupted");
+    return false;
+  }
+  if (esp_ota_end(ota.handle) != ESP_OK ||
+      esp_ota_set_boot_partition(ota.update) != ESP_OK) {
+    otaFail("new image failed validation");
+    return false;
+  }
+
+  OtaBootRecord record = {true, 0, "", ""};
+  strlcpy(record.previous, ota.running->label, sizeof(record.previous));
+  strlcpy(record.target, ota.update->label, sizeof(record.target));
+  saveOtaRecord(record);
+  return true;
+}
+
+/**
+ * Update task: waits for a request (or the check interval), then runs
+ */
+void otaTaskLoop(void *param) {
+  extern bool queueLogEvent(const char *, const char *, uint8_t);
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, OTA_CHECK_INTERVAL
+                                 ? pdMS_TO_TICKS(OTA_CHECK_INTERVAL)
+                                 : portMAX_DELAY);
+    if (otaUrl[0] == '\0' || WiFi.status() != WL_CONNECTED) {
+      continue;
+    }
+    if (!runOtaUpdate(otaUrl)) {
+      continue;
+    }
+
+    char message[96];
+    snprintf(message, sizeof(message), "Update applied (%u patch bytes), "
+             "rebooting into %s",
+             (unsigned)otaStatus.received,
+             esp_ota_get_next_update_partition(NULL)->label);
+    queueLogEvent("ota", message, OUTBOX_PRIORITY_HIGH);
+    DEBUG_PRINTLN(message);
+
+    // Never reboot in the middle of an alarm; give the outbox a moment
+    otaStatus.state = OTA_REBOOTING;
+    do {
+      vTaskDelay(pdMS_TO_TICKS(5000));
+    } while (isGasDangerous());
+    ESP.restart();
+  }
+}
+
+/**
+ * Boot checks and the update task
+ */
+bool initOta() {
+  checkOtaBoot();
+  strlcpy(otaUrl, OTA_URL, sizeof(otaUrl));
+  if (xTaskCreatePinnedToCore(otaTaskLoop, "ota", OTA_TASK_STACK, NULL,
+                              OTA_TASK_PRIORITY, &otaTask,
+                              PRO_CPU_NUM) != pdPASS) {
+    DEBUG_PRINTLN("OTA task start failed");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Ask the update task to check now, optionally from another base URL
+ * Returns false while offline, without a URL or when an update is running
+ */
+bool requestOtaCheck(const char *url) {
+  if (!otaTask || WiFi.status() != WL_CONNECTED ||
+      otaStatus.state == OTA_CHECKING || otaStatus.state == OTA_DOWNLOADING ||
+      otaStatus.state == OTA_REBOOTING) {
+    return false;
+  }
+  if (url && url[0]) {
+    strlcpy(otaUrl, url, sizeof(otaUrl));
+  }
+  if (otaUrl[0] == '\0') {
+    return false;
+  }
+  xTaskNotifyGive(otaTask);
+  return true;
+}
+
+/**
+ * Add update state to a JSON object
+ */
+void addOtaJSON(JsonObject obj) {
+  char hex[2 * SHA256_SIZE + 1] = "";
+  if (otaRunningSize) {
+    sha256Hex(otaRunningSha, hex);
+  }
+  obj["state"] = otaStateName(otaStatus.state);
+  obj["partition"] = esp_ota_get_running_partition()->label;
+  obj["running_sha256"] = hex;
+  obj["pending_verify"] = otaPendingVerify;
+  obj["received"] = otaStatus.received;
+  obj["written"] = otaStatus.written;
+  obj["target_bytes"] = otaStatus.targetSize;
+  obj["error"] = otaStatus.error;
+}
+
+#endif // OTA_H
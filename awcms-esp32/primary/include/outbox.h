@@ -0,0 +1,152 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Upload Outbox
+ *
+ * Small fixed-size queue of rows waiting for upload. Entries are sent
+ * highest priority first, oldest first within a priority, and survive
+ * network outages until the slot is needed for something more important.
+ */
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include "config.h"
+#include <Arduino.h>
+
+// ============================================
+// Outbox Configuration
+// ============================================
+
+#ifndef OUTBOX_CAPACITY
+#define OUTBOX_CAPACITY 16
+#endif
+
+// Wait after a failed upload before trying again (ms)
+#ifndef OUTBOX_RETRY_INTERVAL
+#define OUTBOX_RETRY_INTERVAL 5000
+#endif
+
+#define OUTBOX_PRIORITY_NORMAL 0
+#define OUTBOX_PRIORITY_HIGH 1
+
+// ============================================
+// Outbox Types
+// ============================================
+
+struct OutboxEntry {
+  bool used;
+  uint8_t priority;
+  uint32_t seq;      // Insertion order
+  const char *table; // Must point to a string literal
+  String body;
+};
+
+// ============================================
+// Outbox Variables
+// ============================================
+OutboxEntry outbox[OUTBOX_CAPACITY];
+uint32_t outboxSeq = 0;
+uint32_t outboxSent = 0;
+uint32_t outboxDropped = 0;
+bool outboxBackingOff = false; // Last upload failed, wait before the next
+unsigned long outboxFailedAt = 0;
+
+// ============================================
+// Outbox Functions
+// ============================================
+
+/**
+ * Number of queued entries
+ */
+size_t outboxDepth() {
+  size_t depth = 0;
+  for (size_t i = 0; i < OUTBOX_CAPACITY; i++) {
+    if (outbox[i].used) {
+      depth++;
+    }
+  }
+  return depth;
+}
+
+/**
+ * Queue a row for upload
+ * When full, the oldest entry of the lowest priority not above the new one
+ * is dropped; returns false if the new row was dropped instead
+ */
+bool outboxPush(const char *table, const String &body, uint8_t priority) {
+  OutboxEntry *slot = NULL;
+
+  for (size_t i = 0; i < OUTBOX_CAPACITY; i++) {
+    OutboxEntry &entry = outbox[i];
+    if (!entry.used) {
+      slot = &entry;
+      break;
+    }
+    if (entry.priority <= priority &&
+        (!slot || entry.priority < slot->priority ||
+         (entry.priority == slot->priority && entry.seq < slot->seq))) {
+      slot = &entry;
+    }
+  }
+
+  if (!slot) {
+    outboxDropped++;
+    return false;
+  }
+  if (slot->used) {
+    outboxDropped++;
+  }
+
+  slot->used = true;
+  slot->priority = priority;
+  slot->seq = outboxSeq++;
+  slot->table = table;
+  slot->body = body;
+  return true;
+}
+
+/**
+ * Next entry to send, NULL when empty
+ */
+OutboxEntry *outboxPeek() {
+  OutboxEntry *next = NULL;
+  for (size_t i = 0; i < OUTBOX_CAPACITY; i++) {
+    OutboxEntry &entry = outbox[i];
+    if (entry.used &&
+        (!next || entry.priority > next->priority ||
+         (entry.priority == next->priority && entry.seq < next->seq))) {
+      next = &entry;
+    }
+  }
+  return next;
+}
+
+/**
+ * Remove an entry after it was uploaded
+ */
+void outboxPop(OutboxEntry *entry) {
+  entry->used = false;
+  entry->body = String();
+  outboxSent++;
+}
+
+/**
+ * Note a failed upload, the next one waits OUTBOX_RETRY_INTERVAL
+ */
+void outboxBackoff() {
+  outboxBackingOff = true;
+  outboxFailedAt = millis();
+}
+
+/**
+ * True while backing off after a failed upload
+ * Elapsed time, not a stored deadline, so it never wraps into a long wait
+ */
+bool outboxWaiting() {
+  if (outboxBackingOff && millis() - outboxFailedAt >= OUTBOX_RETRY_INTERVAL) {
+    outboxBackingOff = false;
+  }
+  return outboxBackingOff;
+}
+
+#endif // OUTBOX_H
@@ -0,0 +1,247 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Request Admission Control
+ *
+ * Token-bucket rate limits per client IP and route class, a global cap on
+ * concurrent expensive requests and low-heap shedding. Rejected requests
+ * get a fast 429/503 with Retry-After so a noisy client cannot starve
+ * sensor work. All state is touched from the AsyncTCP task only.
+ */
+
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include "config.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+// ============================================
+// Admission Configuration
+// ============================================
+
+#ifndef RATE_LIMIT_ENABLED
+#define RATE_LIMIT_ENABLED true
+#endif
+
+// Clients tracked at once, the least recently seen is evicted
+#ifndef RATE_CLIENTS
+#define RATE_CLIENTS 16
+#endif
+
+// Concurrent expensive requests (capture, control) across all clients
+#ifndef RATE_MAX_EXPENSIVE
+#define RATE_MAX_EXPENSIVE 2
+#endif
+
+// Concurrent streaming downloads (history export, recording files), kept
+// apart so slow downloads cannot hold the capture/control slots
+#ifndef RATE_MAX_EXPORTS
+#define RATE_MAX_EXPORTS 2
+#endif
+
+// Expensive requests are shed below this much free heap (bytes)
+#ifndef RATE_MIN_FREE_HEAP
+#define RATE_MIN_FREE_HEAP 32768
+#endif
+
+#ifndef RATE_WS_MAX_CLIENTS
+#define RATE_WS_MAX_CLIENTS 4
+#endif
+
+// Route classes
+#define RATE_CLASS_API 0     // JSON reads
+#define RATE_CLASS_CAPTURE 1 // Camera frames, trace export
+#define RATE_CLASS_CONTROL 2 // Calibration, restart, rule updates
+#define RATE_CLASS_WS 3      // WebSocket connects
+#define RATE_CLASS_EXPORT 4  // History export, recording files
+#define RATE_CLASS_COUNT 5
+
+// Concurrency pools, a request holds a slot until its response is sent
+#define RATE_POOL_NONE 0xFF
+#define RATE_POOL_EXPENSIVE 0
+#define RATE_POOL_EXPORT 1
+#define RATE_POOL_COUNT 2
+
+// ============================================
+// Admission Types
+// ============================================
+
+struct RateClass {
+  const char *name;
+  float perSec; // Refill rate
+  float burst;  // Bucket size
+  uint8_t pool; // RATE_POOL_*
+};
+
+struct RateClient {
+  uint32_t ip; // 0 = free slot
+  unsigned long lastSeen;
+  float tokens[RATE_CLASS_COUNT];
+  unsigned long refillAt[RATE_CLASS_COUNT];
+};
+
+struct RateStats {
+  uint32_t admitted;
+  uint32_t limited[RATE_CLASS_COUNT]; // 429 / WebSocket refused per class
+  uint32_t shed;                      // 503: pool full or low heap
+  uint32_t evictions;
+};
+
+// ============================================
+// Admission Variables
+// ============================================
+const RateClass rateClasses[RATE_CLASS_COUNT] = {
+    {"api", 5.0f, 20.0f, RATE_POOL_NONE},
+    {"capture", 1.0f, 3.0f, RATE_POOL_EXPENSIVE},
+    {"control", 0.2f, 3.0f, RATE_POOL_EXPENSIVE},
+    {"ws", 0.2f, 3.0f, RATE_POOL_NONE},
+    {"export", 1.0f, 3.0f, RATE_POOL_EXPORT},
+};
+
+const uint8_t ratePoolMax[RATE_POOL_COUNT] = {RATE_MAX_EXPENSIVE,
+                                              RATE_MAX_EXPORTS};
+
+RateClient rateClients[RATE_CLIENTS];
+RateStats rateStats = {0, {0, 0, 0, 0, 0}, 0, 0};
+uint8_t ratePoolActive[RATE_POOL_COUNT] = {0, 0};
+
+// ============================================
+// Admission Functions
+// ============================================
+
+/**
+ * Find the bucket set for a client, claiming the least recent slot if new
+ */
+RateClient &rateClientFor(uint32_t ip, unsigned long now) {
+  RateClient *slot = &rateClients[0];
+  for (size_t i = 0; i < RATE_CLIENTS; i++) {
+    RateClient &client = rateClients[i];
+    if (client.ip == ip) {
+      client.lastSeen = now;
+      return client;
+    }
+    if (slot->ip != 0 && (client.ip == 0 || client.lastSeen < slot->lastSeen)) {
+      slot = &client;
+    }
+  }
+
+  if (slot->ip != 0) {
+    rateStats.evictions++;
+  }
+  slot->ip = ip;
+  slot->lastSeen = now;
+  for (uint8_t cls = 0; cls < RATE_CLASS_COUNT; cls++) {
+    slot->tokens[cls] = rateClasses[cls].burst;
+    slot->refillAt[cls] = now;
+  }
+  return *slot;
+}
+
+/**
+ * Take one token from a client's bucket
+ * Returns 0 when allowed, otherwise seconds until a token is available
+ */
+uint32_t rateCheck(uint32_t ip, uint8_t cls) {
+  unsigned long now = millis();
+  RateClient &client = rateClientFor(ip, now);
+  const RateClass &rate = rateClasses[cls];
+
+  float tokens = client.tokens[cls] +
+                 (now - client.refillAt[cls]) * rate.perSec / 1000.0f;
+  client.tokens[cls] = tokens < rate.burst ? tokens : rate.burst;
+  client.refillAt[cls] = now;
+
+  if (client.tokens[cls] >= 1.0f) {
+    client.tokens[cls] -= 1.0f;
+    return 0;
+  }
+
+  rateStats.limited[cls]++;
+  return (uint32_t)((1.0f - client.tokens[cls]) / rate.perSec) + 1;
+}
+
+/**
+ * Reject a request with a Retry-After hint
+ */
+void sendRetryAfter(AsyncWebServerRequest *request, int code,
+                    uint32_t seconds) {
+  AsyncWebServerResponse *response = request->beginResponse(
+      code, "application/json",
+      code == 429 ? "{\"error\":\"rate limited\"}" : "{\"error\":\"busy\"}");
+  response->addHeader("Retry-After", String(seconds));
+  request->send(response);
+}
+
+/**
+ * Admission middleware - call first in every API handler
+ * Returns true if admitted, false if a 429/503 response was sent
+ */
+bool admitRequest(AsyncWebServerRequest *request, uint8_t cls) {
+  if (!RATE_LIMIT_ENABLED) {
+    return true;
+  }
+
+  uint32_t retryAfter = rateCheck(request->client()->remoteIP(), cls);
+  if (retryAfter > 0) {
+    sendRetryAfter(request, 429, retryAfter);
+    return false;
+  }
+
+  uint8_t pool = rateClasses[cls].pool;
+  if (pool != RATE_POOL_NONE) {
+    if (ratePoolActive[pool] >= ratePoolMax[pool] ||
+        ESP.getFreeHeap() < RATE_MIN_FREE_HEAP) {
+      rateStats.shed++;
+      sendRetryAfter(request, 503, 1);
+      return false;
+    }
+
+    // Held until the connection closes, i.e. the response is fully sent
+    ratePoolActive[pool]++;
+    request->onDisconnect([pool]() { ratePoolActive[pool]--; });
+  }
+
+  rateStats.admitted++;
+  return true;
+}
+
+/**
+ * Admission for a new WebSocket client, closes it when refused
+ */
+bool admitWebSocket(AsyncWebSocketClient *client, size_t clients) {
+  if (!RATE_LIMIT_ENABLED) {
+    return true;
+  }
+
+  if (clients > RATE_WS_MAX_CLIENTS) {
+    rateStats.shed++;
+    client->close(1013, "Too many clients");
+    return false;
+  }
+  if (rateCheck(client->remoteIP(), RATE_CLASS_WS) > 0) {
+    client->close(1013, "Rate limited");
+    return false;
+  }
+
+  rateStats.admitted++;
+  return true;
+}
+
+/**
+ * Add admission counters to a JSON object
+ */
+void addAdmissionJSON(JsonObject admission) {
+  admission["admitted"] = rateStats.admitted;
+  admission["shed"] = rateStats.shed;
+  admission["expensive_active"] = ratePoolActive[RATE_POOL_EXPENSIVE];
+  admission["exports_active"] = ratePoolActive[RATE_POOL_EXPORT];
+  admission["client_evictions"] = rateStats.evictions;
+
+  JsonObject limited = admission["limited"].to<JsonObject>();
+  for (uint8_t cls = 0; cls < RATE_CLASS_COUNT; cls++) {
+    limited[rateClasses[cls].name] = rateStats.limited[cls];
+  }
+}
+
+#endif // RATE_LIMIT_H
@@ -0,0 +1,317 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Recording Segment Format
+ *
+ * A recording is a series of segments, each a pair of files:
+ *
+ *   /rec/seg_00042.mjpg  JPEG frames back to back (plays as MJPEG)
+ *   /rec/seg_00042.idx   16-byte header, then one 16-byte entry per frame
+ *                        (time since segment start, offset, length)
+ *
+ * Index entries are fixed size and in time order, so a frame is found by
+ * binary search and served with one ranged read. Frame data is written in
+ * whole REC_BLOCK_SIZE blocks, index entries in batches of up to 32. No
+ * Arduino dependencies, so tools/tests can use it on the host (see
+ * store_fs.h).
+ */
+
+#ifndef REC_FORMAT_H
+#define REC_FORMAT_H
+
+#include "store_fs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Recording Format Configuration
+// ============================================
+
+// Frame data write size, a multiple of the SD sector size
+#ifndef REC_BLOCK_SIZE
+#define REC_BLOCK_SIZE 32768
+#endif
+
+#define REC_DIR "/rec"
+#define REC_MAGIC 0x58495741UL // "AWIX"
+#define REC_VERSION 1
+#define REC_INDEX_BLOCK_ENTRIES 32 // 512 bytes
+
+// ============================================
+// Recording Format Types
+// ============================================
+
+struct RecIndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t entrySize;
+  uint32_t segment;
+  uint32_t startEpoch; // Wall clock seconds at start, 0 = unknown
+};
+
+struct RecIndexEntry {
+  uint32_t tMs;    // Since segment start
+  uint32_t offset; // Into the .mjpg file
+  uint32_t length;
+  uint32_t reserved;
+};
+
+struct RecSegmentWriter {
+  uint32_t segment;
+  uint32_t startMs;
+  StoreFile data;
+  StoreFile index;
+  bool open;
+
+  uint8_t *block; // REC_BLOCK_SIZE bytes, supplied by the caller
+  size_t blockFill;
+  uint32_t dataBytes; // Logical size including the unwritten block
+
+  RecIndexEntry entries[REC_INDEX_BLOCK_ENTRIES];
+  size_t entryFill;
+  uint32_t frames;
+  bool failed; // A write came up short
+};
+
+// ============================================
+// Recording Format Functions
+// ============================================
+
+/**
+ * Path of a segment file, ext is "mjpg" or "idx"
+ */
+void recSegmentPath(uint32_t segment, const char *ext, char *path, size_t len) {
+  snprintf(path, len, REC_DIR "/seg_%05lu.%s", (unsigned long)segment, ext);
+}
+
+/**
+ * Segment number of an index file name, 0 if it is not one
+ */
+uint32_t recSegmentFromName(const char *name) {
+  unsigned long segment;
+  char ext[8];
+  if (sscanf(name, "seg_%lu.%7s", &segment, ext) == 2 &&
+      strcmp(ext, "idx") == 0) {
+    return (uint32_t)segment;
+  }
+  return 0;
+}
+
+/**
+ * Start a new segment
+ */
+bool recOpenSegment(RecSegmentWriter &w, StoreFS &fs, uint32_t segment,
+                    uint32_t nowMs, uint32_t epoch, uint8_t *block) {
+  char path[STORE_PATH_MAX];
+  fs.mkdir(REC_DIR);
+
+  recSegmentPath(segment, "mjpg", path, sizeof(path));
+  w.data = fs.open(path, "w");
+  recSegmentPath(segment, "idx", path, sizeof(path));
+  w.index = fs.open(path, "w");
+  if (!w.data.isOpen() || !w.index.isOpen()) {
+    w.data.close();
+    w.index.close();
+    w.open = false;
+    return false;
+  }
+
+  RecIndexHeader header = {REC_MAGIC, REC_VERSION, sizeof(RecIndexEntry),
+                           segment, epoch};
+  w.segment = segment;
+  w.startMs = nowMs;
+  w.block = block;
+  w.blockFill = 0;
+  w.dataBytes = 0;
+  w.entryFill = 0;
+  w.frames = 0;
+  w.failed = w.index.write((const uint8_t *)&header, sizeof(header)) !=
+             sizeof(header);
+  w.open = true;
+  return !w.failed;
+}
+
+/**
+ * Write the frame data buffered so far, even if the block is not full
+ */
+void recFlushBlock(RecSegmentWriter &w) {
+  if (w.blockFill > 0 && w.data.write(w.block, w.blockFill) != w.blockFill) {
+    w.failed = true;
+  }
+  w.blockFill = 0;
+}
+
+/**
+ * Write out buffered index entries whose frame data is already stored, so
+ * a crash never leaves an entry pointing past the end of the data file
+ */
+void recFlushIndex(RecSegmentWriter &w) {
+  uint32_t stored = w.dataBytes - w.blockFill;
+  size_t done = 0;
+  while (done < w.entryFill &&
+         w.entries[done].offset + w.entries[done].length <= stored) {
+    done++;
+  }
+
+  size_t bytes = done * sizeof(RecIndexEntry);
+  if (bytes > 0) {
+    if (w.index.write((const uint8_t *)w.entries, bytes) != bytes) {
+      w.failed = true;
+    }
+    // Commit both sizes so readers on other handles see the new frames
+    w.data.flush();
+    w.index.flush();
+  }
+  w.entryFill -= done;
+  memmove(w.entries, w.entries + done, w.entryFill * sizeof(RecIndexEntry));
+}
+
+/**
+ * Append one JPEG frame taken at nowMs
+ */
+bool recAppendFrame(RecSegmentWriter &w, const uint8_t *jpeg, size_t len,
+                    uint32_t nowMs) {
+  if (!w.open) {
+    return false;
+  }
+
+  RecIndexEntry &entry = w.entries[w.entryFill++];
+  entry.tMs = nowMs - w.startMs;
+  entry.offset = w.dataBytes;
+  entry.length = len;
+  entry.reserved = 0;
+
+  while (len > 0) {
+    size_t n = REC_BLOCK_SIZE - w.blockFill;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(w.block + w.blockFill, jpeg, n);
+    w.blockFill += n;
+    w.dataBytes += n;
+    jpeg += n;
+    len -= n;
+
+    if (w.blockFill == REC_BLOCK_SIZE) {
+      recFlushBlock(w);
+    }
+  }
+  w.frames++;
+
+  if (w.entryFill == REC_INDEX_BLOCK_ENTRIES) {
+    recFlushIndex(w);
+  }
+  if (w.entryFill == REC_INDEX_BLOCK_ENTRIES) {
+    // A whole index block of tiny frames inside one data block
+    recFlushBlock(w);
+    recFlushIndex(w);
+  }
+  return !w.failed;
+}
+
+/**
+ * Write the partial block and remaining entries, then close the segment
+ */
+void recCloseSegment(RecSegmentWriter &w) {
+  if (!w.open) {
+    return;
+  }
+  recFlushBlock(w);
+  recFlushIndex(w);
+  w.data.close();
+  w.index.close();
+  w.open = false;
+}
+
+/**
+ * Read and check an index header, returns the number of entries
+ * or -1 if the file is not a segment index
+ */
+long recIndexCount(StoreFile &index, RecIndexHeader &header) {
+  if (!index.seek(0) ||
+      index.read((uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+      header.magic != REC_MAGIC || header.entrySize != sizeof(RecIndexEntry)) {
+    return -1;
+  }
+  return (index.size() - sizeof(header)) / sizeof(RecIndexEntry);
+}
+
+/**
+ * Read entry i of an index
+ */
+bool recIndexRead(StoreFile &index, uint32_t i, RecIndexEntry &entry) {
+  return index.seek(sizeof(RecIndexHeader) + i * sizeof(RecIndexEntry)) &&
+         index.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+}
+
+/**
+ * Binary search for the last frame at or before tMs (first frame if tMs
+ * is earlier), O(log frames) reads. Returns the entry number or -1
+ */
+long recIndexSeek(StoreFile &index, long count, uint32_t tMs,
+                  RecIndexEntry &entry) {
+  if (count <= 0) {
+    return -1;
+  }
+
+  long lo = 0;
+  long hi = count - 1;
+  while (lo < hi) {
+    long mid = (lo + hi + 1) / 2;
+    if (!recIndexRead(index, mid, entry)) {
+      return -1;
+    }
+    if (entry.tMs <= tMs) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return recIndexRead(index, lo, entry) ? lo : -1;
+}
+
+/**
+ * Parse an HTTP Range header ("bytes=a-b", "bytes=a-", "bytes=-n") against
+ * a file size. Only single ranges are supported. Returns false when the
+ * range is malformed or not satisfiable
+ */
+bool recParseRange(const char *range, uint32_t size, uint32_t &start,
+                   uint32_t &end) {
+  if (strncmp(range, "bytes=", 6) != 0 || size == 0) {
+    return false;
+  }
+  const char *p = range + 6;
+  char *q;
+
+  if (*p == '-') {
+    unsigned long suffix = strtoul(p + 1, &q, 10);
+    if (q == p + 1 || *q != '\0' || suffix == 0) {
+      return false;
+    }
+    start = suffix >= size ? 0 : size - suffix;
+    end = size - 1;
+    return true;
+  }
+
+  unsigned long first = strtoul(p, &q, 10);
+  if (q == p || *q != '-') {
+    return false;
+  }
+  p = q + 1;
+  unsigned long last = size - 1;
+  if (*p != '\0') {
+    last = strtoul(p, &q, 10);
+    if (q == p || *q != '\0') {
+      return false;
+    }
+  }
+  if (first >= size || last < first) {
+    return false;
+  }
+  start = first;
+  end = last < size ? last : size - 1;
+  return true;
+}
+
+#endif // REC_FORMAT_H
@@ -0,0 +1,490 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * SD Card Recorder (ESP32-CAM)
+ *
+ * Time-lapse frames, plus faster event bursts triggered by anomalies and
+ * "record" rules, appended to segment files on the SD card (format in
+ * rec_format.h). A capture task copies the newest buffered frame to PSRAM
+ * and releases it straight away; a low-priority writer task on the other
+ * core does the card I/O in whole blocks. When the writer falls behind,
+ * recorder frames are dropped and counted - /capture and sensor sampling
+ * never wait for the card.
+ *
+ * Segments are served with HTTP Range support, and single frames are looked
+ * up through the index without reading the data file.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "camera.h"
+#include "config.h"
+#include "mem_pools.h"
+#include "rec_format.h"
+#include "store_fs.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <SD_MMC.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <memory>
+
+// ============================================
+// Recorder Configuration
+// ============================================
+
+// Time-lapse frame interval (ms), 0 = record events only
+#ifndef REC_TIMELAPSE_INTERVAL
+#define REC_TIMELAPSE_INTERVAL 10000
+#endif
+
+// Frame interval during an event burst (ms)
+#ifndef REC_EVENT_INTERVAL
+#define REC_EVENT_INTERVAL 200
+#endif
+
+// Burst length for anomalies and "record" rules (ms)
+#ifndef REC_EVENT_DURATION
+#define REC_EVENT_DURATION 30000
+#endif
+
+// Longest burst POST /api/recordings/event may ask for (ms)
+#ifndef REC_EVENT_MAX
+#define REC_EVENT_MAX (4 * REC_EVENT_DURATION)
+#endif
+
+// Start a new segment after this long (ms)
+#ifndef REC_SEGMENT_MS
+#define REC_SEGMENT_MS 600000
+#endif
+
+// Oldest segments are deleted beyond this count or card usage
+#ifndef REC_MAX_SEGMENTS
+#define REC_MAX_SEGMENTS 144
+#endif
+
+#ifndef REC_MAX_USAGE_PCT
+#define REC_MAX_USAGE_PCT 90
+#endif
+
+// Frames buffered in PSRAM between the capture and writer tasks
+#ifndef REC_QUEUE_FRAMES
+#define REC_QUEUE_FRAMES 8
+#endif
+
+// Below the job worker and loop, card writes only use idle time
+#define REC_CAPTURE_PRIORITY 1
+#define REC_WRITER_PRIORITY 1
+
+// Segments listed by /api/recordings by default, and at most (each one
+// opens its index on the web server task)
+#define REC_LIST_DEFAULT 24
+#define REC_LIST_MAX 48
+
+// ============================================
+// Recorder Types
+// ============================================
+
+struct RecFrame {
+  uint8_t *jpeg; // PSRAM copy, freed by the writer
+  size_t len;
+  uint32_t tMs;
+};
+
+struct RecorderStats {
+  uint32_t framesCaptured;
+  uint32_t framesWritten;
+  uint32_t framesDropped; // Queue full or no PSRAM for the copy
+  uint32_t writeErrors;
+  uint32_t segmentsDeleted;
+  uint32_t writeUsMax;
+  uint64_t bytesWritten;
+};
+
+// Read handle shared with a response filler, closed with the last reference
+struct RecReadHandle {
+  StoreFile file;
+
+  explicit RecReadHandle(StoreFile file) : file(file) {}
+  ~RecReadHandle() { file.close(); }
+};
+
+// ============================================
+// Recorder Variables
+// ============================================
+StoreFS recStore(SD_MMC);
+bool recorderAvailable = false;
+volatile uint32_t recEventUntil = 0;
+QueueHandle_t recQueue = NULL;
+RecSegmentWriter recWriter;
+uint32_t recFirstSegment = 0; // Oldest segment on the card, 0 = none
+uint32_t recNextSegment = 1;
+RecorderStats recStats = {0, 0, 0, 0, 0, 0, 0};
+
+// ============================================
+// Recorder Functions
+// ============================================
+
+/**
+ * Record at the event rate for the next durationMs, safe from any task
+ */
+void recordEvent(uint32_t durationMs) {
+  uint32_t until = millis() + durationMs;
+  if ((int32_t)(until - recEventUntil) > 0) {
+    recEventUntil = until;
+  }
+}
+
+/**
+ * Whether an event burst is running
+ */
+bool isRecordingEvent() { return (int32_t)(recEventUntil - millis()) > 0; }
+
+/**
+ * Find the oldest and newest segments already on the card
+ */
+void scanRecordings() {
+  uint32_t first = 0;
+  uint32_t last = 0;
+  recStore.list(REC_DIR, [&first, &last](const char *name, uint32_t size) {
+    uint32_t segment = recSegmentFromName(name);
+    if (segment == 0) {
+      return;
+    }
+    if (first == 0 || segment < first) {
+      first = segment;
+    }
+    if (segment > last) {
+      last = segment;
+    }
+  });
+  recFirstSegment = first;
+  recNextSegment = last + 1;
+}
+
+/**
+ * Card usage in percent
+ */
+uint8_t recCardUsage() {
+  uint64_t total = SD_MMC.totalBytes();
+  return total ? (uint8_t)(SD_MMC.usedBytes() * 100 / total) : 0;
+}
+
+/**
+ * Delete the oldest segments until there is room for one more
+ */
+void pruneRecordings() {
+  char path[STORE_PATH_MAX];
+  while (recFirstSegment != 0 && recFirstSegment < recNextSegment &&
+         (recNextSegment - recFirstSegment >= REC_MAX_SEGMENTS ||
+          recCardUsage() >= REC_MAX_USAGE_PCT)) {
+    recSegmentPath(recFirstSegment, "mjpg", path, sizeof(path));
+    recStore.remove(path);
+    recSegmentPath(recFirstSegment, "idx", path, sizeof(path));
+    recStore.remove(path);
+    recFirstSegment++;
+    recStats.segmentsDeleted++;
+  }
+  if (recFirstSegment >= recNextSegment) {
+    recFirstSegment = 0;
+  }
+}
+
+/**
+ * Close the current segment and open the next one at nowMs
+ */
+bool rotateSegment(uint32_t nowMs) {
+  recCloseSegment(recWriter);
+  pruneRecordings();
+
+  time_t now = time(NULL);
+  uint32_t epoch = now > 1600000000 ? (uint32_t)now : 0;
+  if (!recOpenSegment(recWriter, recStore, recNextSegment, nowMs, epoch,
+                      recWriter.block)) {
+    DEBUG_PRINTF("Recorder: cannot open segment %lu\n",
+                 (unsigned long)recNextSegment);
+    return false;
+  }
+  if (recFirstSegment == 0) {
+    recFirstSegment = recNextSegment;
+  }
+  recNextSegment++;
+  return true;
+}
+
+/**
+ * Capture task: take frames at the current rate, copy them to PSRAM and
+ * release the buffered frame before anything touches the card
+ */
+void recCaptureTask(void *param) {
+  uint32_t next = millis();
+  uint32_t lastSeq = 0;
+  while (true) {
+    uint32_t now = millis();
+    uint32_t interval =
+        isRecordingEvent() ? REC_EVENT_INTERVAL : REC_TIMELAPSE_INTERVAL;
+    if (!cameraInitialized || interval == 0) {
+      vTaskDelay(pdMS_TO_TICKS(100));
+      continue;
+    }
+    // Sleep in short steps so a new event is picked up quickly
+    if ((int32_t)(next - now) > 0) {
+      uint32_t wait = next - now;
+      vTaskDelay(pdMS_TO_TICKS(wait < 100 ? wait : 100));
+      continue;
+    }
+    next = now + interval;
+
+    // Newest buffered frame, so the tick never waits for the sensor
+    FrameSlot *slot = acquireFrame(camRecorderConsumer);
+    if (!slot || slot->seq == lastSeq) {
+      releaseFrame(slot); // Nothing new since the last tick
+      continue;
+    }
+    lastSeq = slot->seq;
+    RecFrame frame = {(uint8_t *)heap_caps_malloc(slot->len, MALLOC_CAP_SPIRAM),
+                      slot->len, slot->capturedAt};
+    if (frame.jpeg) {
+      memcpy(frame.jpeg, slot->buf, slot->len);
+    }
+    releaseFrame(slot);
+
+    recStats.framesCaptured++;
+    if (!frame.jpeg || xQueueSend(recQueue, &frame, 0) != pdTRUE) {
+      heap_caps_free(frame.jpeg);
+      recStats.framesDropped++;
+    }
+  }
+}
+
+/**
+ * Writer task: append queued frames, rotating segments by age
+ */
+void recWriterTask(void *param) {
+  RecFrame frame;
+  while (true) {
+    if (xQueueReceive(recQueue, &frame, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    uint32_t started = micros();
+    if (!recWriter.open || recWriter.failed ||
+        frame.tMs - recWriter.startMs >= REC_SEGMENT_MS) {
+      rotateSegment(frame.tMs);
+    }
+    if (recAppendFrame(recWriter, frame.jpeg, frame.len, frame.tMs)) {
+      recStats.framesWritten++;
+      recStats.bytesWritten += frame.len;
+    } else {
+      recStats.writeErrors++;
+    }
+    heap_caps_free(frame.jpeg);
+
+    uint32_t took = micros() - started;
+    if (took > recStats.writeUsMax) {
+      recStats.writeUsMax = took;
+    }
+  }
+}
+
+/**
+ * Mount the SD card and start the recorder tasks
+ * Needs PSRAM for the write block and frame copies
+ */
+bool initRecorder() {
+  if (!psramFound()) {
+    DEBUG_PRINTLN("Recorder disabled: no PSRAM");
+    return false;
+  }
+  // 1-bit mode leaves GPIO 4 (flash LED) and 12/13 free
+  if (!SD_MMC.begin("/sdcard", true) || SD_MMC.cardType() == CARD_NONE) {
+    DEBUG_PRINTLN("Recorder disabled: no SD card");
+    return false;
+  }
+
+  recWriter.open = false;
+  recWriter.block = (uint8_t *)heap_caps_malloc(
+      REC_BLOCK_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  recQueue = xQueueCreate(REC_QUEUE_FRAMES, sizeof(RecFrame));
+  if (!recWriter.block || !recQueue) {
+    DEBUG_PRINTLN("Recorder buffer allocation failed");
+    return false;
+  }
+
+  recStore.mkdir(REC_DIR);
+  scanRecordings();
+
+  if (xTaskCreatePinnedToCore(recWriterTask, "recWrite", 4096, NULL,
+                              REC_WRITER_PRIORITY, NULL,
+                              PRO_CPU_NUM) != pdPASS ||
+      xTaskCreatePinnedToCore(recCaptureTask, "recCapture", 3072, NULL,
+                              REC_CAPTURE_PRIORITY, NULL,
+                              APP_CPU_NUM) != pdPASS) {
+    DEBUG_PRINTLN("Recorder task start failed");
+    return false;
+  }
+
+  recorderAvailable = true;
+  DEBUG_PRINTF("Recorder ready, next segment %lu\n",
+               (unsigned long)recNextSegment);
+  return true;
+}
+
+/**
+ * Add recorder state and counters to a JSON object
+ */
+void addRecorderJSON(JsonObject rec) {
+  rec["available"] = recorderAvailable;
+  if (!recorderAvailable) {
+    return;
+  }
+  rec["event"] = isRecordingEvent();
+  rec["segment"] = recWriter.open ? recWriter.segment : 0;
+  rec["first_segment"] = recFirstSegment;
+  rec["card_usage_pct"] = recCardUsage();
+  rec["queued"] = uxQueueMessagesWaiting(recQueue);
+  rec["frames_captured"] = recStats.framesCaptured;
+  rec["frames_written"] = recStats.framesWritten;
+  rec["frames_dropped"] = recStats.framesDropped;
+  rec["write_errors"] = recStats.writeErrors;
+  rec["segments_deleted"] = recStats.segmentsDeleted;
+  rec["bytes_written"] = recStats.bytesWritten;
+  rec["write_us_max"] = recStats.writeUsMax;
+}
+
+/**
+ * Get recorder state and the newest segments (limit entries) as JSON
+ */
+String getRecordingsJSON(uint32_t limit) {
+  JsonDocument doc(&jsonWebPool);
+  addRecorderJSON(doc["recorder"].to<JsonObject>());
+  JsonArray segments = doc["segments"].to<JsonArray>();
+
+  char path[STORE_PATH_MAX];
+  for (uint32_t segment = recNextSegment - 1;
+       recFirstSegment != 0 && segment >= recFirstSegment && limit > 0;
+       segment--, limit--) {
+    recSegmentPath(segment, "idx", path, sizeof(path));
+    StoreFile index = recStore.open(path, "r");
+    if (!index.isOpen()) {
+      continue;
+    }
+
+    RecIndexHeader header;
+    RecIndexEntry last = {0, 0, 0, 0};
+    long count = recIndexCount(index, header);
+    if (count > 0) {
+      recIndexRead(index, count - 1, last);
+    }
+    index.close();
+
+    JsonObject obj = segments.add<JsonObject>();
+    obj["segment"] = segment;
+    obj["frames"] = count < 0 ? 0 : count;
+    obj["duration_ms"] = last.tMs;
+    obj["bytes"] = last.offset + last.length;
+    obj["start_epoch"] = count < 0 ? 0 : header.startEpoch;
+    obj["recording"] = recWriter.open && recWriter.segment == segment;
+  }
+
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
+
+/**
+ * Serve part of a recording file (offset/length, length 0 = whole file)
+ * with HTTP Range support. Reads happen as the response drains, so memory
+ * use does not depend on the file size
+ */
+void sendRecordingRange(AsyncWebServerRequest *request, const char *path,
+                        const char *contentType, uint32_t offset,
+                        uint32_t length) {
+  std::shared_ptr<RecReadHandle> handle(
+      new (std::nothrow) RecReadHandle(recStore.open(path, "r")));
+  if (!handle || !handle->file.isOpen()) {
+    request->send(404, "text/plain", "Recording not found");
+    return;
+  }
+
+  uint32_t size = length ? length : handle->file.size();
+  uint32_t start = 0;
+  uint32_t end = size ? size - 1 : 0;
+  bool partial = request->hasHeader("Range");
+  if (partial &&
+      !recParseRange(request->getHeader("Range")->value().c_str(), size, start,
+                     end)) {
+    AsyncWebServerResponse *response =
+        request->beginResponse(416, "text/plain", "Range Not Satisfiable");
+    response->addHeader("Content-Range", "bytes */" + String(size));
+    request->send(response);
+    return;
+  }
+
+  uint32_t base = offset + start;
+  uint32_t len = size ? end - start + 1 : 0;
+  AsyncWebServerResponse *response = request->beginResponse(
+      contentType, len,
+      [handle, base, len](uint8_t *buffer, size_t maxLen,
+                          size_t index) -> size_t {
+        if (index >= len || !handle->file.seek(base + index)) {
+          return 0;
+        }
+        if (maxLen > len - index) {
+          maxLen = len - index;
+        }
+        return handle->file.read(buffer, maxLen);
+      });
+  response->addHeader("Accept-Ranges", "bytes");
+  if (partial) {
+    response->setCode(206);
+    response->addHeader("Content-Range", "bytes " + String(start) + "-" +
+                                             String(end) + "/" + String(size));
+  }
+  request->send(response);
+}
+
+/**
+ * Serve a whole segment file, ext is "mjpg" or "idx"
+ */
+void sendRecordingFile(AsyncWebServerRequest *request, uint32_t segment,
+                       const String &ext) {
+  char path[STORE_PATH_MAX];
+  recSegmentPath(segment, ext.c_str(), path, sizeof(path));
+  sendRecordingRange(request, path,
+                     ext == "idx" ? "application/octet-stream"
+                                  : "video/x-motion-jpeg",
+                     0, 0);
+}
+
+/**
+ * Serve the frame of a segment shown at tMs (since segment start),
+ * located by binary search in the index
+ */
+void sendRecordingFrame(AsyncWebServerRequest *request, uint32_t segment,
+                        uint32_t tMs) {
+  char path[STORE_PATH_MAX];
+  recSegmentPath(segment, "idx", path, sizeof(path));
+  StoreFile index = recStore.open(path, "r");
+  if (!index.isOpen()) {
+    request->send(404, "text/plain", "Recording not found");
+    return;
+  }
+
+  RecIndexHeader header;
+  RecIndexEntry entry;
+  long found = recIndexSeek(index, recIndexCount(index, header), tMs, entry);
+  index.close();
+  if (found < 0) {
+    request->send(404, "text/plain", "No frames in segment");
+    return;
+  }
+
+  recSegmentPath(segment, "mjpg", path, sizeof(path));
+  sendRecordingRange(request, path, "image/jpeg", entry.offset, entry.length);
+}
+
+#endif // RECORDER_H
@@ -0,0 +1,471 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Rule Engine
+ *
+ * Local alarm rules, one per line (or separated by ';'):
+ *
+ *   ch0.ppm > 300 for 10s -> ws,log,relay:13
+ *   ch1.slope >= 2.5 -> ws
+ *   any.ppm > 1000 -> ws,log,snapshot
+ *
+ * Rules are compiled into a fixed table of predicates and evaluated against
+ * every sample in bounded time without touching the heap. A rule fires once
+ * its condition has held for the "for" duration and clears when it stops
+ * holding. No Arduino dependencies, so it builds on the host as well.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================
+// Rule Engine Configuration
+// ============================================
+
+#ifndef RULES_MAX
+#define RULES_MAX 16
+#endif
+
+// Rule source text kept for reporting and persistence
+#ifndef RULES_SOURCE_MAX
+#define RULES_SOURCE_MAX 768
+#endif
+
+// Longest "for" duration (ms)
+#define RULE_HOLD_MAX 86400000UL // 24 h
+
+// Channel index meaning "any channel"
+#define RULE_CHANNEL_ANY 0xFF
+
+// Sample fields a rule can test
+#define RULE_FIELD_PPM 0
+#define RULE_FIELD_RAW 1
+#define RULE_FIELD_VOLTAGE 2
+#define RULE_FIELD_SLOPE 3
+#define RULE_FIELD_COUNT 4
+
+// Comparison operators
+#define RULE_OP_GT 0
+#define RULE_OP_GE 1
+#define RULE_OP_LT 2
+#define RULE_OP_LE 3
+#define RULE_OP_EQ 4
+#define RULE_OP_NE 5
+
+// Action flags
+#define RULE_ACTION_WS 0x01       // Push a rule frame on /ws
+#define RULE_ACTION_LOG 0x02      // Queue a device_logs event
+#define RULE_ACTION_SNAPSHOT 0x04 // Queue a sensor_readings row right away
+#define RULE_ACTION_RELAY 0x08    // Drive a GPIO high while the rule is active
+#define RULE_ACTION_RECORD 0x10   // Start a camera recording burst
+
+// Relay outputs: GPIO 34-39 are input-only, 6-11 drive the SPI flash
+#define RULE_RELAY_PIN_MAX 33
+#define RULE_PINS_FLASH (0x3FULL << 6)
+
+// ============================================
+// Rule Engine Types
+// ============================================
+
+// One sample per channel, filled by the caller
+struct RuleSample {
+  float field[RULE_FIELD_COUNT];
+};
+
+struct Rule {
+  // Compiled predicate
+  uint8_t channel; // Channel index or RULE_CHANNEL_ANY
+  uint8_t field;
+  uint8_t op;
+  uint8_t actions;
+  int8_t relayPin; // -1 = none
+  float value;
+  uint32_t holdMs;
+
+  // Source text (offset/length into RuleSet::source)
+  uint16_t srcOffset;
+  uint16_t srcLength;
+
+  // Runtime state
+  bool matching;       // Condition currently true
+  bool active;         // Fired and not yet cleared
+  uint32_t matchSince; // When the condition became true
+  uint32_t hits;       // Times fired
+};
+
+struct RuleSet {
+  Rule rules[RULES_MAX];
+  uint8_t count;
+  char source[RULES_SOURCE_MAX];
+};
+
+// Called for every rule that fires (active = true) or clears (false)
+typedef void (*RuleCallback)(const RuleSet &set, uint8_t index, bool active);
+
+// Compile error, position is a byte offset into the source
+struct RuleError {
+  const char *message;
+  size_t position;
+};
+
+// ============================================
+// Rule Engine Variables
+// ============================================
+
+// GPIOs a relay action may not drive, bit n = GPIO n
+uint64_t rulesReservedPins = RULE_PINS_FLASH;
+
+// ============================================
+// Rule Compiler
+// ============================================
+
+/**
+ * Keep relay actions off a pin the firmware uses itself (call before
+ * compiling, negative pins are ignored)
+ */
+void rulesReservePin(int pin) {
+  if (pin >= 0 && pin < 64) {
+    rulesReservedPins |= 1ULL << pin;
+  }
+}
+
+/**
+ * Whether a relay action may drive this GPIO
+ */
+bool ruleRelayPinAllowed(long pin) {
+  return pin >= 0 && pin <= RULE_RELAY_PIN_MAX &&
+         !((rulesReservedPins >> pin) & 1);
+}
+
+/**
+ * Skip spaces and tabs (not line breaks, they end a rule)
+ */
+const char *ruleSkipSpaces(const char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\r') {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * Match a keyword at p, returns the position after it or NULL
+ */
+const char *ruleMatch(const char *p, const char *word) {
+  size_t len = strlen(word);
+  return strncmp(p, word, len) == 0 ? p + len : NULL;
+}
+
+/**
+ * Parse "chN." or "any." followed by a field name
+ */
+const char *ruleParseOperand(const char *p, Rule &rule) {
+  const char *q;
+  if ((q = ruleMatch(p, "any."))) {
+    rule.channel = RULE_CHANNEL_ANY;
+  } else if ((q = ruleMatch(p, "ch")) && isdigit((unsigned char)*q)) {
+    char *end;
+    long ch = strtol(q, &end, 10);
+    if (ch < 0 || ch >= RULE_CHANNEL_ANY || *end != '.') {
+      return NULL;
+    }
+    rule.channel = (uint8_t)ch;
+    q = end + 1;
+  } else {
+    return NULL;
+  }
+
+  static const char *const fields[RULE_FIELD_COUNT] = {"ppm", "raw", "voltage",
+                                                       "slope"};
+  for (uint8_t i = 0; i < RULE_FIELD_COUNT; i++) {
+    const char *r = ruleMatch(q, fields[i]);
+    if (r && !isalnum((unsigned char)*r)) {
+      rule.field = i;
+      return r;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Parse a comparison operator
+ */
+const char *ruleParseOp(const char *p, Rule &rule) {
+  static const char *const ops[] = {">=", "<=", "==", "!=", ">", "<"};
+  static const uint8_t codes[] = {RULE_OP_GE, RULE_OP_LE, RULE_OP_EQ,
+                                  RULE_OP_NE, RULE_OP_GT, RULE_OP_LT};
+  for (size_t i = 0; i < sizeof(codes); i++) {
+    const char *q = ruleMatch(p, ops[i]);
+    if (q) {
+      rule.op = codes[i];
+      return q;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Parse a duration such as 500ms, 10s or 2m, at most RULE_HOLD_MAX
+ */
+const char *ruleParseDuration(const char *p, uint32_t &ms) {
+  char *end;
+  double value = strtod(p, &end);
+  if (end == p || value < 0) {
+    return NULL;
+  }
+
+  const char *q;
+  double scale;
+  if ((q = ruleMatch(end, "ms"))) {
+    scale = 1.0;
+  } else if ((q = ruleMatch(end, "s"))) {
+    scale = 1000.0;
+  } else if ((q = ruleMatch(end, "m"))) {
+    scale = 60000.0;
+  } else {
+    return NULL;
+  }
+  // Checked before the cast, which is undefined out of range (NaN fails too)
+  double total = value * scale;
+  if (!(total <= RULE_HOLD_MAX)) {
+    return NULL;
+  }
+  ms = (uint32_t)total;
+  return q;
+}
+
+/**
+ * Parse a comma-separated action list
+ */
+const char *ruleParseActions(const char *p, Rule &rule) {
+  while (true) {
+    p = ruleSkipSpaces(p);
+    const char *q;
+    if ((q = ruleMatch(p, "ws"))) {
+      rule.actions |= RULE_ACTION_WS;
+    } else if ((q = ruleMatch(p, "log"))) {
+      rule.actions |= RULE_ACTION_LOG;
+    } else if ((q = ruleMatch(p, "snapshot"))) {
+      rule.actions |= RULE_ACTION_SNAPSHOT;
+    } else if ((q = ruleMatch(p, "record"))) {
+      rule.actions |= RULE_ACTION_RECORD;
+    } else if ((q = ruleMatch(p, "relay:"))) {
+      char *end;
+      long pin = strtol(q, &end, 10);
+      if (end == q || !ruleRelayPinAllowed(pin)) {
+        return NULL;
+      }
+      rule.actions |= RULE_ACTION_RELAY;
+      rule.relayPin = (int8_t)pin;
+      q = end;
+    } else {
+      return NULL;
+    }
+    p = ruleSkipSpaces(q);
+    if (*p != ',') {
+      return p;
+    }
+    p++;
+  }
+}
+
+/**
+ * Compile one rule starting at p (already trimmed, non-empty)
+ */
+const char *ruleCompileOne(const char *p, Rule &rule, RuleError &error) {
+  memset(&rule, 0, sizeof(rule));
+  rule.relayPin = -1;
+
+  const char *q = ruleParseOperand(p, rule);
+  if (!q) {
+    error.message = "expected chN.<field> or any.<field>";
+    return p;
+  }
+
+  p = ruleSkipSpaces(q);
+  if (!(q = ruleParseOp(p, rule))) {
+    error.message = "expected comparison operator";
+    return p;
+  }
+
+  p = ruleSkipSpaces(q);
+  char *end;
+  rule.value = strtof(p, &end);
+  if (end == p) {
+    error.message = "expected number";
+    return p;
+  }
+
+  p = ruleSkipSpaces(end);
+  if ((q = ruleMatch(p, "for")) != NULL && !isalnum((unsigned char)*q)) {
+    p = ruleSkipSpaces(q);
+    if (!(q = ruleParseDuration(p, rule.holdMs))) {
+      error.message = "expected duration (ms, s or m, up to 24 h)";
+      return p;
+    }
+    p = ruleSkipSpaces(q);
+  }
+
+  if (!(q = ruleMatch(p, "->"))) {
+    error.message = "expected ->";
+    return p;
+  }
+
+  p = q;
+  if (!(q = ruleParseActions(p, rule))) {
+    error.message = "expected ws, log, snapshot, record or relay:<gpio> "
+                    "(a free output pin, not 6-11 or 34-39)";
+    return ruleSkipSpaces(p);
+  }
+
+  error.message = NULL;
+  return q;
+}
+
+/**
+ * Compile rule source into a set
+ * Compile into a scratch set and copy it over the running one on success,
+ * so a bad update keeps the running rules. Returns false and fills error
+ * on failure.
+ */
+bool rulesCompile(const char *source, RuleSet &compiled, RuleError &error) {
+  memset(&compiled, 0, sizeof(compiled));
+
+  size_t len = strlen(source);
+  if (len >= RULES_SOURCE_MAX) {
+    error.message = "rules too long";
+    error.position = RULES_SOURCE_MAX - 1;
+    return false;
+  }
+  memcpy(compiled.source, source, len + 1);
+
+  const char *p = compiled.source;
+  while (*p) {
+    p = ruleSkipSpaces(p);
+    if (*p == '\n' || *p == ';') {
+      p++;
+      continue;
+    }
+    if (*p == '\0') {
+      break;
+    }
+    if (*p == '#') {
+      while (*p && *p != '\n') {
+        p++;
+      }
+      continue;
+    }
+
+    if (compiled.count >= RULES_MAX) {
+      error.message = "too many rules";
+      error.position = p - compiled.source;
+      return false;
+    }
+
+    Rule &rule = compiled.rules[compiled.count];
+    const char *start = p;
+    p = ruleCompileOne(p, rule, error);
+    if (error.message) {
+      error.position = p - compiled.source;
+      return false;
+    }
+
+    p = ruleSkipSpaces(p);
+    if (*p != '\0' && *p != '\n' && *p != ';') {
+      error.message = "unexpected text after rule";
+      error.position = p - compiled.source;
+      return false;
+    }
+
+    const char *end = p;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+      end--;
+    }
+    rule.srcOffset = (uint16_t)(start - compiled.source);
+    rule.srcLength = (uint16_t)(end - start);
+    compiled.count++;
+  }
+
+  error.message = NULL;
+  error.position = 0;
+  return true;
+}
+
+/**
+ * Copy a rule's source text into buf
+ */
+void ruleText(const RuleSet &set, uint8_t index, char *buf, size_t len) {
+  const Rule &rule = set.rules[index];
+  size_t n = rule.srcLength < len - 1 ? rule.srcLength : len - 1;
+  memcpy(buf, set.source + rule.srcOffset, n);
+  buf[n] = '\0';
+}
+
+// ============================================
+// Rule Evaluation
+// ============================================
+
+/**
+ * Apply a comparison
+ */
+bool ruleCompare(uint8_t op, float lhs, float rhs) {
+  switch (op) {
+  case RULE_OP_GT:
+    return lhs > rhs;
+  case RULE_OP_GE:
+    return lhs >= rhs;
+  case RULE_OP_LT:
+    return lhs < rhs;
+  case RULE_OP_LE:
+    return lhs <= rhs;
+  case RULE_OP_EQ:
+    return lhs == rhs;
+  default:
+    return lhs != rhs;
+  }
+}
+
+/**
+ * Evaluate every rule against one sample set
+ * Cost is O(rules x channels) with no allocation
+ */
+void rulesEvaluate(RuleSet &set, const RuleSample *samples, size_t channels,
+                   uint32_t nowMs, RuleCallback callback) {
+  for (uint8_t i = 0; i < set.count; i++) {
+    Rule &rule = set.rules[i];
+
+    bool match = false;
+    if (rule.channel == RULE_CHANNEL_ANY) {
+      for (size_t ch = 0; ch < channels && !match; ch++) {
+        match = ruleCompare(rule.op, samples[ch].field[rule.field], rule.value);
+      }
+    } else if (rule.channel < channels) {
+      match = ruleCompare(rule.op, samples[rule.channel].field[rule.field],
+                          rule.value);
+    }
+
+    if (match && !rule.matching) {
+      rule.matchSince = nowMs;
+    }
+    rule.matching = match;
+
+    if (match && !rule.active && nowMs - rule.matchSince >= rule.holdMs) {
+      rule.active = true;
+      rule.hits++;
+      if (callback) {
+        callback(set, i, true);
+      }
+    } else if (!match && rule.active) {
+      rule.active = false;
+      if (callback) {
+        callback(set, i, false);
+      }
+    }
+  }
+}
+
+#endif // RULES_H
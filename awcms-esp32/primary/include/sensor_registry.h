@@ -0,0 +1,124 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Gas Sensor Registry
+ *
+ * Compile-time list of MQ channels. Each channel is a MqChannel<pin, model>
+ * type, so the sample path is fully inlined with no virtual dispatch, and all
+ * channels are read in one batched ADC scan.
+ */
+
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include "gas_math.h"
+#include <Arduino.h>
+
+// ============================================
+// Registry Configuration
+// ============================================
+
+// ADC reads per channel per scan, averaged to reduce noise
+#ifndef GAS_ADC_OVERSAMPLE
+#define GAS_ADC_OVERSAMPLE 4
+#endif
+
+// Upper clamp for converted readings
+#define GAS_PPM_MAX 10000.0f
+
+// ============================================
+// Registry Types
+// ============================================
+
+// Runtime state of one channel
+struct GasChannelState {
+  const char *model;
+  const char *gas;
+  uint8_t pin;
+  float ro; // Sensor resistance in clean air (calibrated)
+  bool calibrated;
+  float raw;
+  float voltage;
+  float ppm;
+};
+
+/**
+ * One MQ sensor on an ADC1 pin
+ */
+template <uint8_t Pin, typename Model> struct MqChannel {
+  typedef Model ModelType;
+
+  static void init(GasChannelState &state) {
+    pinMode(Pin, INPUT);
+    state.model = Model::model();
+    state.gas = Model::gas();
+    state.pin = Pin;
+    state.ro = 10.0;
+    state.calibrated = false;
+    state.raw = 0;
+    state.voltage = 0;
+    state.ppm = 0;
+  }
+
+  static uint16_t read() { return analogRead(Pin); }
+
+  static void convert(uint16_t adcValue, GasChannelState &state) {
+    state.raw = adcValue;
+    state.voltage = adcToVoltage(adcValue);
+
+    if (state.calibrated && state.ro > 0) {
+      float ppm = Model::ppm(calculateRs(adcValue) / state.ro);
+
+      // Clamp PPM to reasonable range
+      if (ppm < 0)
+        ppm = 0;
+      if (ppm > GAS_PPM_MAX)
+        ppm = GAS_PPM_MAX;
+      state.ppm = ppm;
+    } else {
+      state.ppm = 0;
+    }
+  }
+};
+
+/**
+ * Channel list, expanded recursively at compile time
+ */
+template <typename... Channels> struct GasSensorList;
+
+template <> struct GasSensorList<> {
+  static const size_t COUNT = 0;
+
+  static void init(GasChannelState *) {}
+  static void scan(uint32_t *) {}
+  static void convert(const uint16_t *, GasChannelState *) {}
+  static float cleanAirRatio(size_t) { return 1.0f; }
+};
+
+template <typename Head, typename... Tail>
+struct GasSensorList<Head, Tail...> {
+  typedef GasSensorList<Tail...> Rest;
+  static const size_t COUNT = 1 + Rest::COUNT;
+
+  static void init(GasChannelState *states) {
+    Head::init(states[0]);
+    Rest::init(states + 1);
+  }
+
+  // Accumulate one reading per channel into sums
+  static void scan(uint32_t *sums) {
+    sums[0] += Head::read();
+    Rest::scan(sums + 1);
+  }
+
+  static void convert(const uint16_t *raw, GasChannelState *states) {
+    Head::convert(raw[0], states[0]);
+    Rest::convert(raw + 1, states + 1);
+  }
+
+  static float cleanAirRatio(size_t index) {
+    return index == 0 ? Head::ModelType::cleanAirRatio()
+                      : Rest::cleanAirRatio(index - 1);
+  }
+};
+
+#endif // SENSOR_REGISTRY_H
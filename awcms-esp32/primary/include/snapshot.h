@@ -0,0 +1,82 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Dashboard Snapshot
+ *
+ * Everything the dashboard shows - device status, WiFi, every sensor
+ * channel, camera and alarm state - built in one pass into one document.
+ * Served by /api/snapshot and sent as the WebSocket hello, so a page load
+ * costs one request.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "camera.h"
+#include "config.h"
+#include "connectivity.h"
+#include "gas_sensor.h"
+#include "local_rules.h"
+#include "webserver.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ============================================
+// Snapshot Functions
+// ============================================
+
+/**
+ * Add current alarm state: danger flag, worst level, latched anomalies
+ * and active rules
+ */
+void addAlarmJSON(JsonObject alarm) {
+  float worst = 0;
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    if (gasChannels[ch].ppm > worst) {
+      worst = gasChannels[ch].ppm;
+    }
+  }
+  alarm["dangerous"] = isGasDangerous();
+  alarm["level"] = getGasLevel(worst);
+
+  JsonArray anomalies = alarm["anomalies"].to<JsonArray>();
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    if (gasDetectors[ch].active != ANOMALY_NONE) {
+      JsonObject obj = anomalies.add<JsonObject>();
+      obj["channel"] = ch;
+      obj["kind"] = anomalyName(gasDetectors[ch].active);
+    }
+  }
+
+  JsonArray rules = alarm["rules"].to<JsonArray>();
+  for (uint8_t i = 0; i < activeRules.count; i++) {
+    if (activeRules.rules[i].active) {
+      rules.add(i);
+    }
+  }
+}
+
+/**
+ * Fill a document with the complete dashboard state
+ */
+void buildSnapshot(JsonDocument &doc) {
+  const GasChannelState &primary = gasChannels[GAS_PRIMARY_CHANNEL];
+
+  doc["type"] = "snapshot";
+  doc["timestamp"] = millis();
+  addDeviceStatusJSON(doc["status"].to<JsonObject>());
+
+  JsonObject wifi = doc["wifi"].to<JsonObject>();
+  addWiFiInfoJSON(wifi);
+  wifi["state"] = getConnStateName();
+
+  JsonObject gas = doc["gas"].to<JsonObject>();
+  gas["ppm"] = primary.ppm;
+  gas["level"] = getGasLevel(primary.ppm);
+  gas["calibrated"] = primary.calibrated;
+  addGasChannelsJSON(gas["channels"].to<JsonArray>(), false);
+
+  addCameraStatusJSON(doc["camera"].to<JsonObject>());
+  addAlarmJSON(doc["alarm"].to<JsonObject>());
+}
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,457 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Stage Budgets and Stall Watchdog
+ *
+ * loop(), web handlers and the job worker wrap their slow stages in
+ * STAGE_SCOPE(). A supervisor task on the protocol core checks every
+ * active stage against its time budget. On an overrun it records the
+ * stage, how far over it ran, heap state and the stack high-water marks
+ * of the main tasks. The record is kept in RTC memory (survives watchdog
+ * and panic resets) and copied to NVS (survives power loss), then
+ * reported as a "stall" event on the next boot. A stage that hangs for
+ * STAGE_HANG_MS restarts the device with the record in place.
+ */
+
+#ifndef STAGE_WATCH_H
+#define STAGE_WATCH_H
+
+#include "config.h"
+#include "outbox.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <stddef.h>
+
+// ============================================
+// Stage Watch Configuration
+// ============================================
+
+#ifndef STAGE_WATCH_ENABLED
+#define STAGE_WATCH_ENABLED true
+#endif
+
+// Budgets per stage (ms)
+#ifndef STAGE_BUDGET_NETWORK
+#define STAGE_BUDGET_NETWORK 20000 // Supabase login, config, startup event
+#endif
+
+#ifndef STAGE_BUDGET_SENSOR
+#define STAGE_BUDGET_SENSOR 500
+#endif
+
+#ifndef STAGE_BUDGET_BROADCAST
+#define STAGE_BUDGET_BROADCAST 200
+#endif
+
+#ifndef STAGE_BUDGET_UPLOAD
+#define STAGE_BUDGET_UPLOAD 10000 // One TLS request
+#endif
+
+#ifndef STAGE_BUDGET_WEB
+#define STAGE_BUDGET_WEB 500
+#endif
+
+#ifndef STAGE_BUDGET_JOB
+#define STAGE_BUDGET_JOB 15000
+#endif
+
+// Gap between loop() iterations outside any stage
+#ifndef STAGE_BUDGET_LOOP
+#define STAGE_BUDGET_LOOP 1000
+#endif
+
+// A stage running this long is treated as hung: restart (0 = never)
+#ifndef STAGE_HANG_MS
+#define STAGE_HANG_MS 120000
+#endif
+
+#ifndef STAGE_CHECK_INTERVAL
+#define STAGE_CHECK_INTERVAL 100 // ms
+#endif
+
+// At most one NVS write per this long, the RTC copy is always current
+#ifndef STAGE_NVS_INTERVAL
+#define STAGE_NVS_INTERVAL 600000
+#endif
+
+#define STAGE_NVS_NAMESPACE "awcms"
+#define STAGE_NVS_KEY "stall"
+#define STAGE_RECORD_MAGIC 0x4C415453 // "STAL"
+#define STAGE_TASKS 3
+
+// ============================================
+// Stage Watch Macros
+// ============================================
+
+#define STAGE_CONCAT_INNER(a, b) a##b
+#define STAGE_CONCAT(a, b) STAGE_CONCAT_INNER(a, b)
+
+#if STAGE_WATCH_ENABLED
+#define STAGE_SCOPE(stage)                                                     \
+  StageScope STAGE_CONCAT(stageScope_, __LINE__)(stage)
+#else
+#define STAGE_SCOPE(stage)
+#endif
+
+// ============================================
+// Stage Watch Types
+// ============================================
+
+enum StageId {
+  STAGE_LOOP, // One loop() pass, charged only outside the stages below
+  STAGE_NETWORK,
+  STAGE_SENSOR,
+  STAGE_BROADCAST,
+  STAGE_OUTBOX,
+  STAGE_SYNC,
+  STAGE_CONFIG,
+  STAGE_WEB,
+  STAGE_JOB,
+  STAGE_COUNT
+};
+
+struct StageInfo {
+  const char *name;
+  uint32_t budgetMs;
+  bool inLoop; // Runs on the loop task (covers STAGE_LOOP while active)
+};
+
+struct StageState {
+  volatile uint32_t startedAt; // millis(), 0 = idle
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t worstMs;
+  volatile uint32_t overrunEndMs; // Length of a finished overrun, 0 = none
+  bool flagged;                   // This run already counted as an overrun
+};
+
+// Kept in RTC memory across resets; same layout in NVS
+struct StallRecord {
+  uint32_t magic;
+  uint8_t stage;
+  uint8_t ended; // The stage finished after overrunning
+  uint32_t budgetMs;
+  uint32_t elapsedMs;
+  uint32_t uptimeMs;
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestBlock;
+  uint32_t stackFree[STAGE_TASKS]; // Bytes never used, 0 = task not found
+  uint32_t checksum;
+};
+
+// ============================================
+// Stage Watch Variables
+// ============================================
+const StageInfo stageInfo[STAGE_COUNT] = {
+    {"loop", STAGE_BUDGET_LOOP, true},
+    {"network", STAGE_BUDGET_NETWORK, true},
+    {"sensor", STAGE_BUDGET_SENSOR, true},
+    {"broadcast", STAGE_BUDGET_BROADCAST, true},
+    {"outbox", STAGE_BUDGET_UPLOAD, true},
+    {"sync", STAGE_BUDGET_UPLOAD, true},
+    {"config", STAGE_BUDGET_UPLOAD, true},
+    {"web", STAGE_BUDGET_WEB, false},
+    {"job", STAGE_BUDGET_JOB, false},
+};
+
+// Tasks whose stack headroom goes into the record
+const char *const stageTaskNames[STAGE_TASKS] = {"loopTask", "async_tcp",
+                                                 "jobs"};
+
+StageState stageStates[STAGE_COUNT];
+volatile uint32_t stageLoopResumed = 0; // Last end of a stage inside loop()
+RTC_NOINIT_ATTR StallRecord stallRtc;
+StallRecord stallPrevious; // From the last boot, reported once online
+bool stallPreviousValid = false;
+esp_reset_reason_t stallResetReason = ESP_RST_UNKNOWN;
+uint32_t stallLastNvsWrite = 0;
+bool stallNvsDirty = false;
+
+// ============================================
+// Stage Watch Functions
+// ============================================
+
+uint32_t stallChecksum(const StallRecord &record) {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < offsetof(StallRecord, checksum); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+bool stallValid(const StallRecord &record) {
+  return record.magic == STAGE_RECORD_MAGIC &&
+         record.stage < STAGE_COUNT &&
+         record.checksum == stallChecksum(record);
+}
+
+/**
+ * Time a running stage has used; loop() is only charged for the time
+ * outside its own stages
+ */
+uint32_t stageElapsed(uint8_t stage, uint32_t startedAt, uint32_t now) {
+  uint32_t resumed = stageLoopResumed;
+  if (stage == STAGE_LOOP && resumed != 0 &&
+      (int32_t)(resumed - startedAt) > 0) {
+    startedAt = resumed;
+  }
+  return now - startedAt;
+}
+
+/**
+ * Mark a stage as running / finished (use STAGE_SCOPE())
+ */
+void stageBegin(uint8_t stage) {
+  StageState &state = stageStates[stage];
+  state.flagged = false;
+  state.startedAt = millis() | 1;
+}
+
+void stageEnd(uint8_t stage) {
+  StageState &state = stageStates[stage];
+  uint32_t now = millis();
+  uint32_t elapsed = now - state.startedAt;
+  if (state.flagged) {
+    // The supervisor completes the record
+    state.overrunEndMs = stageElapsed(stage, state.startedAt, now);
+  }
+  state.startedAt = 0;
+  state.runs++;
+  if (elapsed > state.worstMs) {
+    state.worstMs = elapsed;
+  }
+  if (stage != STAGE_LOOP && stageInfo[stage].inLoop) {
+    stageLoopResumed = millis() | 1;
+  }
+}
+
+class StageScope {
+public:
+  explicit StageScope(uint8_t stage) : stage_(stage) { stageBegin(stage); }
+  ~StageScope() { stageEnd(stage_); }
+
+private:
+  uint8_t stage_;
+};
+
+/**
+ * Call at the top of loop(); the loop stage runs until stageLoopIdle()
+ */
+void stageLoopTick() { stageBegin(STAGE_LOOP); }
+
+/**
+ * Call before loop() waits for its next deadline, waiting is not a stall
+ */
+void stageLoopIdle() { stageEnd(STAGE_LOOP); }
+
+/**
+ * Fill the RTC record for an overrunning stage; the record keeps whichever
+ * overrun went furthest past its budget
+ */
+void stageRecord(uint8_t stage, uint32_t elapsed) {
+  if (stallValid(stallRtc) && stallRtc.elapsedMs - stallRtc.budgetMs >=
+                                  elapsed - stageInfo[stage].budgetMs) {
+    return;
+  }
+  StallRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = STAGE_RECORD_MAGIC;
+  record.stage = stage;
+  record.budgetMs = stageInfo[stage].budgetMs;
+  record.elapsedMs = elapsed;
+  record.uptimeMs = millis();
+  record.freeHeap = ESP.getFreeHeap();
+  record.minFreeHeap = ESP.getMinFreeHeap();
+  record.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  for (size_t i = 0; i < STAGE_TASKS; i++) {
+    TaskHandle_t task = xTaskGetHandle(stageTaskNames[i]);
+    record.stackFree[i] = task ? uxTaskGetStackHighWaterMark(task) : 0;
+  }
+  record.checksum = stallChecksum(record);
+  stallRtc = record;
+  stallNvsDirty = true;
+}
+
+void stageSaveNvs() {
+  Preferences prefs;
+  if (prefs.begin(STAGE_NVS_NAMESPACE, false)) {
+    prefs.putBytes(STAGE_NVS_KEY, &stallRtc, sizeof(stallRtc));
+    prefs.end();
+  }
+  stallLastNvsWrite = millis();
+  stallNvsDirty = false;
+}
+
+/**
+ * One supervisor pass over every active stage
+ */
+void stageCheck() {
+  uint32_t now = millis();
+  bool loopBusy = false;
+  for (uint8_t i = STAGE_LOOP + 1; i < STAGE_COUNT; i++) {
+    if (stageInfo[i].inLoop && stageStates[i].startedAt != 0) {
+      loopBusy = true;
+    }
+  }
+
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    StageState &state = stageStates[i];
+    uint32_t ended = state.overrunEndMs;
+    if (ended != 0) {
+      state.overrunEndMs = 0;
+      if (stallValid(stallRtc) && stallRtc.stage == i &&
+          ended >= stallRtc.elapsedMs) {
+        stallRtc.elapsedMs = ended;
+        stallRtc.ended = 1;
+        stallRtc.checksum = stallChecksum(stallRtc);
+        stallNvsDirty = true;
+      }
+    }
+
+    uint32_t startedAt = state.startedAt;
+    if (startedAt == 0 || (i == STAGE_LOOP && loopBusy)) {
+      continue;
+    }
+    uint32_t elapsed = stageElapsed(i, startedAt, now);
+    if (elapsed <= stageInfo[i].budgetMs) {
+      continue;
+    }
+    if (!state.flagged) {
+      state.flagged = true;
+      state.overruns++;
+      DEBUG_PRINTF("Stage %s over budget (%lu ms)\n", stageInfo[i].name,
+                   (unsigned long)stageInfo[i].budgetMs);
+    }
+    stageRecord(i, elapsed);
+
+    if (STAGE_HANG_MS > 0 && elapsed > STAGE_HANG_MS) {
+      DEBUG_PRINTF("Stage %s hung for %lu ms, restarting\n",
+                   stageInfo[i].name, (unsigned long)elapsed);
+      stageSaveNvs();
+      ESP.restart();
+    }
+  }
+
+  if (stallNvsDirty && (stallLastNvsWrite == 0 ||
+                        now - stallLastNvsWrite >= STAGE_NVS_INTERVAL)) {
+    stageSaveNvs();
+  }
+}
+
+void stageWatchTask(void *param) {
+  while (true) {
+    vTaskDelay(pdMS_TO_TICKS(STAGE_CHECK_INTERVAL));
+    stageCheck();
+  }
+}
+
+const char *resetReasonName(esp_reset_reason_t reason) {
+  switch (reason) {
+  case ESP_RST_POWERON:
+    return "power-on";
+  case ESP_RST_SW:
+    return "restart";
+  case ESP_RST_PANIC:
+    return "panic";
+  case ESP_RST_INT_WDT:
+    return "interrupt watchdog";
+  case ESP_RST_TASK_WDT:
+    return "task watchdog";
+  case ESP_RST_WDT:
+    return "watchdog";
+  case ESP_RST_BROWNOUT:
+    return "brownout";
+  case ESP_RST_DEEPSLEEP:
+    return "deep sleep";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * Pick up the record left by the last boot and start the supervisor,
+ * call early in setup()
+ */
+void initStageWatch() {
+  stallResetReason = esp_reset_reason();
+  Preferences prefs;
+  StallRecord stored;
+  bool storedValid = false;
+  if (prefs.begin(STAGE_NVS_NAMESPACE, false)) {
+    storedValid = prefs.getBytes(STAGE_NVS_KEY, &stored, sizeof(stored)) ==
+                      sizeof(stored) &&
+                  stallValid(stored);
+    if (storedValid) {
+      prefs.remove(STAGE_NVS_KEY);
+    }
+    prefs.end();
+  }
+
+  // RTC memory is garbage after power-on; it is newer than NVS otherwise
+  if (stallResetReason != ESP_RST_POWERON && stallValid(stallRtc)) {
+    stallPrevious = stallRtc;
+    stallPreviousValid = true;
+  } else if (storedValid) {
+    stallPrevious = stored;
+    stallPreviousValid = true;
+  }
+  memset(&stallRtc, 0, sizeof(stallRtc));
+
+  if (!STAGE_WATCH_ENABLED) {
+    return;
+  }
+  if (xTaskCreatePinnedToCore(stageWatchTask, "stageWatch", 3072, NULL, 2,
+                              NULL, PRO_CPU_NUM) != pdPASS) {
+    DEBUG_PRINTLN("Stage watch task start failed");
+  }
+}
+
+/**
+ * Queue the last boot's worst overrun as a "stall" event, once
+ */
+void reportPreviousStall() {
+  extern bool queueLogEvent(const char *, const char *, uint8_t);
+  if (!stallPreviousValid) {
+    return;
+  }
+  stallPreviousValid = false;
+
+  const StallRecord &r = stallPrevious;
+  char message[256];
+  snprintf(message, sizeof(message),
+           "Stage %s ran %lu ms (budget %lu) at uptime %lu s, %s; "
+           "last reset: %s; heap %lu free, %lu min, %lu largest; "
+           "stack free loopTask %lu, async_tcp %lu, jobs %lu",
+           stageInfo[r.stage].name, (unsigned long)r.elapsedMs,
+           (unsigned long)r.budgetMs, (unsigned long)(r.uptimeMs / 1000),
+           r.ended ? "then finished" : "still running",
+           resetReasonName(stallResetReason), (unsigned long)r.freeHeap,
+           (unsigned long)r.minFreeHeap, (unsigned long)r.largestBlock,
+           (unsigned long)r.stackFree[0], (unsigned long)r.stackFree[1],
+           (unsigned long)r.stackFree[2]);
+  queueLogEvent("stall", message, OUTBOX_PRIORITY_HIGH);
+  DEBUG_PRINTLN(message);
+}
+
+/**
+ * Add per-stage budgets and overrun counters to a metrics JSON object
+ */
+void addStageJSON(JsonObject stages) {
+  stages["reset_reason"] = resetReasonName(stallResetReason);
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const StageState &state = stageStates[i];
+    JsonObject stage = stages[stageInfo[i].name].to<JsonObject>();
+    stage["budget_ms"] = stageInfo[i].budgetMs;
+    stage["runs"] = state.runs;
+    stage["overruns"] = state.overruns;
+    stage["worst_ms"] = state.worstMs;
+    stage["running_ms"] =
+        state.startedAt != 0 ? millis() - state.startedAt : 0;
+  }
+}
+
+#endif // STAGE_WATCH_H
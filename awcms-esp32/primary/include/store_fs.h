@@ -0,0 +1,171 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Storage File Layer
+ *
+ * Minimal file API shared by the on-device stores (SD card, SPIFFS) and
+ * their host builds. On the device StoreFS wraps an fs::FS; on the host it
+ * is backed by a plain directory, so file formats can be written, read and
+ * checked with host tools.
+ */
+
+#ifndef STORE_FS_H
+#define STORE_FS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <FS.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// ============================================
+// Storage Configuration
+// ============================================
+
+#define STORE_PATH_MAX 64
+
+// ============================================
+// Storage Types
+// ============================================
+
+#ifdef ARDUINO
+
+class StoreFile {
+public:
+  StoreFile() {}
+  explicit StoreFile(fs::File file) : file(file) {}
+
+  bool isOpen() { return (bool)file; }
+  size_t read(uint8_t *buf, size_t len) { return file.read(buf, len); }
+  size_t write(const uint8_t *buf, size_t len) { return file.write(buf, len); }
+  bool seek(uint32_t pos) { return file.seek(pos, fs::SeekSet); }
+  uint32_t size() { return file.size(); }
+  void flush() { file.flush(); }
+  void close() { file.close(); }
+
+private:
+  fs::File file;
+};
+
+class StoreFS {
+public:
+  explicit StoreFS(fs::FS &fs) : fs(fs) {}
+
+  /**
+   * Open a file, mode is "r", "w" or "a"
+   */
+  StoreFile open(const char *path, const char *mode) {
+    return StoreFile(fs.open(path, mode));
+  }
+  bool remove(const char *path) { return fs.remove(path); }
+  bool mkdir(const char *path) { return fs.exists(path) || fs.mkdir(path); }
+
+  /**
+   * Call callback(name, size) for every file in a directory
+   */
+  template <typename Callback> void list(const char *dir, Callback callback) {
+    fs::File root = fs.open(dir);
+    if (!root || !root.isDirectory()) {
+      return;
+    }
+    for (fs::File entry = root.openNextFile(); entry;
+         entry = root.openNextFile()) {
+      if (!entry.isDirectory()) {
+        // name() is the base name on current cores, the full path on old ones
+        const char *name = strrchr(entry.name(), '/');
+        callback(name ? name + 1 : entry.name(), (uint32_t)entry.size());
+      }
+    }
+  }
+
+private:
+  fs::FS &fs;
+};
+
+#else
+
+class StoreFile {
+public:
+  StoreFile() : file(NULL) {}
+  explicit StoreFile(FILE *file) : file(file) {}
+
+  bool isOpen() { return file != NULL; }
+  size_t read(uint8_t *buf, size_t len) { return fread(buf, 1, len, file); }
+  size_t write(const uint8_t *buf, size_t len) {
+    return fwrite(buf, 1, len, file);
+  }
+  bool seek(uint32_t pos) { return fseek(file, pos, SEEK_SET) == 0; }
+  uint32_t size() {
+    long pos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    fseek(file, pos, SEEK_SET);
+    return (uint32_t)end;
+  }
+  void flush() { fflush(file); }
+  void close() {
+    if (file) {
+      fclose(file);
+      file = NULL;
+    }
+  }
+
+private:
+  FILE *file;
+};
+
+class StoreFS {
+public:
+  explicit StoreFS(const char *root) : root(root) {}
+
+  StoreFile open(const char *path, const char *mode) {
+    char full[STORE_PATH_MAX * 4];
+    char fmode[3] = {mode[0], 'b', '\0'};
+    snprintf(full, sizeof(full), "%s%s", root, path);
+    return StoreFile(fopen(full, fmode));
+  }
+  bool remove(const char *path) {
+    char full[STORE_PATH_MAX * 4];
+    snprintf(full, sizeof(full), "%s%s", root, path);
+    return ::remove(full) == 0;
+  }
+  bool mkdir(const char *path) {
+    char full[STORE_PATH_MAX * 4];
+    snprintf(full, sizeof(full), "%s%s", root, path);
+    return ::mkdir(full, 0755) == 0 || isDirectory(full);
+  }
+
+  template <typename Callback> void list(const char *dir, Callback callback) {
+    char full[STORE_PATH_MAX * 4];
+    snprintf(full, sizeof(full), "%s%s", root, dir);
+    DIR *d = opendir(full);
+    if (!d) {
+      return;
+    }
+    while (struct dirent *entry = readdir(d)) {
+      char path[sizeof(full) + sizeof(entry->d_name) + 1];
+      struct stat st;
+      snprintf(path, sizeof(path), "%s/%s", full, entry->d_name);
+      if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        callback(entry->d_name, (uint32_t)st.st_size);
+      }
+    }
+    closedir(d);
+  }
+
+private:
+  const char *root;
+
+  static bool isDirectory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+  }
+};
+
+#endif
+
+#endif // STORE_FS_H
@@ -9,9 +9,15 @@
 #define SUPABASE_CLIENT_H
 
 #include "config.h"
+#include "device_config.h"
+#include "mem_pools.h"
+#include "outbox.h"
+#include "rules.h"
+#include "sync_schedule.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <ESPSupabase.h>
+#include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 
 // Supabase client instance
@@ -30,11 +36,44 @@ bool initSupabase() {
   return true;
 }
 
+/**
+ * Insert one row through the REST endpoint
+ * Same request as supabase.insert(), but keeps the Retry-After and rate
+ * hint headers that the library drops. Returns the HTTP status.
+ */
+int insertRow(const char *table, const String &body, SyncReply &reply) {
+  static const char *headers[] = {"Retry-After", SYNC_HINT_HEADER};
+  reply.code = -1;
+  reply.retryAfterMs = 0;
+  reply.hintMs = 0;
+
+  WiFiClientSecure client;
+  client.setInsecure();
+  HTTPClient http;
+  if (!http.begin(client, String(SUPABASE_URL) + "/rest/v1/" + table)) {
+    return reply.code;
+  }
+  http.addHeader("apikey", SUPABASE_ANON_KEY);
+  http.addHeader("Authorization", String("Bearer ") + SUPABASE_ANON_KEY);
+  http.addHeader("Content-Type", "application/json");
+  http.addHeader("Prefer", "return=minimal");
+  http.collectHeaders(headers, 2);
+
+  reply.code = http.POST(body);
+  // Only the delta-seconds form of Retry-After, an HTTP date reads as 0
+  reply.retryAfterMs = strtoul(http.header("Retry-After").c_str(), NULL, 10) *
+                       1000;
+  reply.hintMs = strtoul(http.header(SYNC_HINT_HEADER).c_str(), NULL, 10) *
+                 1000;
+  http.end();
+  return reply.code;
+}
+
 /**
  * Send sensor data to Supabase
  */
 bool postSensorData(float temperature, float humidity) {
-  JsonDocument doc;
+  JsonDocument doc(&jsonLargeArena);
   doc["device_id"] = DEVICE_ID;
   doc["tenant_id"] = TENANT_ID;
   doc["temperature"] = temperature;
@@ -58,23 +97,67 @@ bool postSensorData(float temperature, float humidity) {
 
 /**
  * Get device configuration from Supabase
+ * With updatedSince set, only returns a row when devices.updated_at is newer,
+ * so an unchanged config costs one request with an empty "[]" body.
  */
-String getDeviceConfig() {
-  String query = supabase.from("device_configs")
-                     .select("*")
-                     .eq("device_id", DEVICE_ID)
-                     .limit(1)
-                     .doSelect();
-
-  DEBUG_PRINTLN("Config: " + query);
+String getDeviceConfig(const char *updatedSince) {
+  supabase.from("devices").select("config,updated_at").eq("device_id", DEVICE_ID);
+
+  if (updatedSince && updatedSince[0]) {
+    // Timestamps carry a "+00:00" offset, '+' must be escaped in the query
+    String since = updatedSince;
+    since.replace("+", "%2B");
+    supabase.gt("updated_at", since);
+  }
+
+  String query = supabase.limit(1).doSelect();
+  supabase.urlQuery_reset();
   return query;
 }
 
+/**
+ * Fetch remote configuration and apply it live when it changed
+ * Returns false when the request or response failed
+ */
+bool refreshDeviceConfig() {
+  lastConfigRefresh = millis();
+  String response = getDeviceConfig(deviceConfig.updatedAt);
+
+  JsonDocument doc(&jsonLargeArena);
+  DeserializationError error = deserializeJson(doc, response);
+  if (error || !doc.is<JsonArray>()) {
+    DEBUG_PRINTLN("Config refresh failed: " + response);
+    return false;
+  }
+
+  JsonArrayConst rows = doc.as<JsonArrayConst>();
+  if (rows.size() == 0) {
+    return true; // Unchanged
+  }
+
+  JsonObjectConst row = rows[0];
+  applyDeviceConfigJSON(row["config"]);
+
+  // Local rules travel with the config as one text field
+  const char *rules = row["config"]["rules"];
+  if (rules) {
+    extern bool applyRules(const char *, RuleError &, bool);
+    RuleError ruleError;
+    applyRules(rules, ruleError, true);
+  }
+  strlcpy(deviceConfig.updatedAt, row["updated_at"] | "",
+          sizeof(deviceConfig.updatedAt));
+  saveDeviceConfig();
+
+  DEBUG_PRINTF("Config updated (updated_at: %s)\n", deviceConfig.updatedAt);
+  return true;
+}
+
 /**
  * Update device status in Supabase
  */
 bool updateDeviceStatus(bool online, int rssi) {
-  JsonDocument doc;
+  JsonDocument doc(&jsonLargeArena);
   doc["online"] = online;
   doc["rssi"] = rssi;
   doc["last_seen"] = "now()";
@@ -90,10 +173,10 @@ bool updateDeviceStatus(bool online, int rssi) {
 }
 
 /**
- * Log event to Supabase
+ * Build a device_logs row
  */
-bool logEvent(const char *eventType, const char *message) {
-  JsonDocument doc;
+String getLogEventPayload(const char *eventType, const char *message) {
+  JsonDocument doc(&jsonLargeArena);
   doc["device_id"] = DEVICE_ID;
   doc["tenant_id"] = TENANT_ID;
   doc["event_type"] = eventType;
@@ -101,9 +184,52 @@ bool logEvent(const char *eventType, const char *message) {
 
   String jsonData;
   serializeJson(doc, jsonData);
+  return jsonData;
+}
 
-  int httpCode = supabase.insert("device_logs", jsonData, false);
+/**
+ * Log event to Supabase
+ */
+bool logEvent(const char *eventType, const char *message) {
+  int httpCode = supabase.insert("device_logs",
+                                 getLogEventPayload(eventType, message), false);
   return httpCode == 201;
 }
 
+/**
+ * Queue an event for upload, sent ahead of routine rows by priority
+ * Survives WiFi/Supabase outages (see outbox.h)
+ */
+bool queueLogEvent(const char *eventType, const char *message,
+                   uint8_t priority) {
+  return outboxPush("device_logs", getLogEventPayload(eventType, message),
+                    priority);
+}
+
+/**
+ * Upload the next queued row, one per call to keep loop() responsive
+ * Waits while the server has uploads on hold (see sync_schedule.h)
+ * Returns true when a row was sent
+ */
+bool drainOutbox() {
+  OutboxEntry *entry = outboxPeek();
+  if (!entry || outboxWaiting() || syncHeld(millis())) {
+    return false;
+  }
+
+  SyncReply reply;
+  if (insertRow(entry->table, entry->body, reply) == 201) {
+    outboxPop(entry);
+    return true;
+  }
+
+  // A rate-limited backend holds readings and events alike
+  if (reply.code == 429 || reply.code == 503) {
+    holdSync(millis(), reply);
+  }
+  DEBUG_PRINTF("Outbox upload failed: %d\n", reply.code);
+  outboxBackoff();
+  return false;
+}
+
 #endif // SUPABASE_CLIENT_H
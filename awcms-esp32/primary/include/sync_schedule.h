@@ -0,0 +1,247 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Sync Scheduler
+ *
+ * Decides when the next sensor_readings upload goes out. Each device gets
+ * a fixed phase and per-cycle jitter derived from DEVICE_ID, so a fleet
+ * that powers up together spreads its uploads over the whole interval
+ * instead of posting in step. The server can slow devices down with
+ * Retry-After (on 429/503) or a minimum interval header; other failures
+ * back off exponentially.
+ */
+
+#ifndef SYNC_SCHEDULE_H
+#define SYNC_SCHEDULE_H
+
+#include "config.h"
+#include "device_config.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ============================================
+// Sync Schedule Configuration
+// ============================================
+
+// Share of the interval the first upload after connecting is spread over (%)
+#ifndef SYNC_SPREAD_PCT
+#define SYNC_SPREAD_PCT 100
+#endif
+
+// Per-cycle jitter, +/- this share of the interval (%)
+#ifndef SYNC_JITTER_PCT
+#define SYNC_JITTER_PCT 10
+#endif
+
+// Longest wait after repeated failures (ms)
+#ifndef SYNC_BACKOFF_MAX
+#define SYNC_BACKOFF_MAX 600000
+#endif
+
+// Wait after a 429/503 that carries no usable Retry-After (ms)
+#ifndef SYNC_RETRY_AFTER_DEFAULT
+#define SYNC_RETRY_AFTER_DEFAULT 60000
+#endif
+
+// Upper bound for Retry-After and rate hints (ms)
+#ifndef SYNC_WAIT_MAX
+#define SYNC_WAIT_MAX 3600000
+#endif
+
+// Response header with the minimum seconds between uploads
+#ifndef SYNC_HINT_HEADER
+#define SYNC_HINT_HEADER "X-Sync-Interval"
+#endif
+
+// ============================================
+// Sync Schedule Types
+// ============================================
+
+struct SyncReply {
+  int code;              // HTTP status, <= 0 for connection errors
+  uint32_t retryAfterMs; // 0 = no Retry-After
+  uint32_t hintMs;       // 0 = no rate hint
+};
+
+struct SyncSchedule {
+  uint32_t seed;  // FNV-1a of DEVICE_ID
+  uint32_t cycle; // Uploads scheduled so far, varies the jitter
+  unsigned long nextAt;
+  bool held; // Server asked every upload to wait holdMs from heldAt
+  unsigned long heldAt;
+  uint32_t holdMs;
+  uint32_t hintMs;
+  uint32_t failures; // Consecutive, reset on success
+  int lastCode;
+  uint32_t synced;
+  uint32_t rateLimited;
+  uint32_t errors;
+};
+
+// ============================================
+// Sync Schedule Variables
+// ============================================
+SyncSchedule syncSchedule;
+
+// ============================================
+// Sync Schedule Functions
+// ============================================
+
+/**
+ * 32-bit FNV-1a
+ */
+uint32_t syncHash(const char *text) {
+  uint32_t hash = 2166136261u;
+  while (*text) {
+    hash ^= (uint8_t)*text++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Deterministic value in [0, range] for this device and cycle
+ */
+uint32_t syncJitter(uint32_t range) {
+  uint32_t x = syncSchedule.seed ^ (syncSchedule.cycle * 2654435761u);
+  x ^= x >> 16;
+  x *= 0x45d9f3bu;
+  x ^= x >> 16;
+  return x % (range + 1);
+}
+
+/**
+ * Upload interval in effect: the configured one, or the server's hint
+ * when that is longer
+ */
+uint32_t syncInterval() {
+  uint32_t interval = deviceConfig.dataSyncInterval;
+  return syncSchedule.hintMs > interval ? syncSchedule.hintMs : interval;
+}
+
+void initSyncSchedule() {
+  memset(&syncSchedule, 0, sizeof(syncSchedule));
+  syncSchedule.seed = syncHash(DEVICE_ID);
+}
+
+/**
+ * (Re)connected: first upload at this device's phase within one interval
+ */
+void startSyncSchedule(unsigned long now) {
+  uint32_t spread =
+      (uint32_t)((uint64_t)syncInterval() * SYNC_SPREAD_PCT / 100);
+  syncSchedule.failures = 0;
+  syncSchedule.nextAt = now + syncSchedule.seed % (spread + 1);
+  DEBUG_PRINTF("First sync in %lu ms\n", syncSchedule.nextAt - now);
+}
+
+/**
+ * Whether the server asked uploads to pause (outbox rows included)
+ * Elapsed time is compared, so a hold ends even across a millis() wrap
+ */
+bool syncHeld(unsigned long now) {
+  if (syncSchedule.held && now - syncSchedule.heldAt >= syncSchedule.holdMs) {
+    syncSchedule.held = false;
+  }
+  return syncSchedule.held;
+}
+
+bool syncDue(unsigned long now) {
+  return !syncHeld(now) && (long)(now - syncSchedule.nextAt) >= 0;
+}
+
+/**
+ * When loop() should next look at the schedule: the end of a hold, or
+ * the next upload
+ */
+unsigned long syncWakeAt(unsigned long now) {
+  if (syncHeld(now)) {
+    return syncSchedule.heldAt + syncSchedule.holdMs;
+  }
+  return syncSchedule.nextAt;
+}
+
+/**
+ * Pause uploads after a 429/503, for Retry-After when the server gave one
+ * Jitter on top keeps devices told the same Retry-After from returning
+ * together
+ */
+void holdSync(unsigned long now, const SyncReply &reply) {
+  uint32_t wait =
+      reply.retryAfterMs ? reply.retryAfterMs : SYNC_RETRY_AFTER_DEFAULT;
+  if (wait > SYNC_WAIT_MAX) {
+    wait = SYNC_WAIT_MAX;
+  }
+  wait += syncJitter(syncInterval() * SYNC_JITTER_PCT / 100);
+
+  syncSchedule.rateLimited++;
+  syncSchedule.held = true;
+  syncSchedule.heldAt = now;
+  syncSchedule.holdMs = wait;
+  if ((long)(syncSchedule.nextAt - (now + wait)) < 0) {
+    syncSchedule.nextAt = now + wait;
+  }
+  DEBUG_PRINTF("Uploads held for %lu ms (HTTP %d)\n", (unsigned long)wait,
+               reply.code);
+}
+
+/**
+ * Schedule the next upload from the result of this one
+ */
+void scheduleNextSync(unsigned long now, const SyncReply &reply) {
+  syncSchedule.cycle++;
+  syncSchedule.lastCode = reply.code;
+  syncSchedule.hintMs =
+      reply.hintMs > SYNC_WAIT_MAX ? SYNC_WAIT_MAX : reply.hintMs;
+  uint32_t interval = syncInterval();
+
+  if (reply.code >= 200 && reply.code < 300) {
+    syncSchedule.synced++;
+    syncSchedule.failures = 0;
+    uint32_t jitter = (uint32_t)((uint64_t)interval * SYNC_JITTER_PCT / 100);
+    syncSchedule.nextAt = now + interval - jitter + syncJitter(2 * jitter);
+    return;
+  }
+
+  if (reply.code == 429 || reply.code == 503) {
+    syncSchedule.nextAt = now + interval;
+    holdSync(now, reply);
+    return;
+  }
+
+  // Doubling per consecutive failure, randomized in [d/2, d]
+  syncSchedule.errors++;
+  syncSchedule.failures++;
+  uint32_t ceiling = interval;
+  for (uint32_t i = 1; i < syncSchedule.failures && ceiling < SYNC_BACKOFF_MAX;
+       i++) {
+    ceiling *= 2;
+  }
+  if (ceiling > SYNC_BACKOFF_MAX) {
+    ceiling = SYNC_BACKOFF_MAX;
+  }
+  uint32_t delay = ceiling / 2 + syncJitter(ceiling / 2);
+  syncSchedule.nextAt = now + delay;
+  DEBUG_PRINTF("Sync failed (HTTP %d), retry in %lu ms\n", reply.code,
+               (unsigned long)delay);
+}
+
+/**
+ * Add scheduler state to a metrics JSON object
+ */
+void addSyncJSON(JsonObject sync) {
+  unsigned long now = millis();
+  sync["interval_ms"] = syncInterval();
+  sync["hint_ms"] = syncSchedule.hintMs;
+  sync["next_in_ms"] = (long)(syncSchedule.nextAt - now) > 0
+                           ? syncSchedule.nextAt - now
+                           : 0;
+  sync["held_ms"] =
+      syncHeld(now) ? syncSchedule.holdMs - (now - syncSchedule.heldAt) : 0;
+  sync["failures"] = syncSchedule.failures;
+  sync["last_code"] = syncSchedule.lastCode;
+  sync["synced"] = syncSchedule.synced;
+  sync["rate_limited"] = syncSchedule.rateLimited;
+  sync["errors"] = syncSchedule.errors;
+}
+
+#endif // SYNC_SCHEDULE_H
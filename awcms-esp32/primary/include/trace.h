@@ -0,0 +1,295 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Hot-Path Tracer
+ *
+ * Fixed-size in-RAM ring of begin/end events with microsecond timestamps
+ * and task/core IDs. Exported as Chrome trace JSON
+ * (chrome://tracing, ui.perfetto.dev). Builds on the device and on the host.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#endif
+
+// ============================================
+// Tracer Configuration
+// ============================================
+
+// Set to 0 to compile all TRACE_* macros out completely
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// Ring capacity in events (24 bytes each)
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 256
+#endif
+
+// ============================================
+// Tracer Macros
+// ============================================
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if TRACE_ENABLED
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_BEGIN(name) traceRecord(name, 'B')
+#define TRACE_END(name) traceRecord(name, 'E')
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#endif
+
+#if TRACE_ENABLED
+
+// ============================================
+// Tracer Types
+// ============================================
+
+struct TraceEvent {
+  const char *name; // Must point to a string literal
+  uint64_t ticks;   // Microseconds (device) or nanoseconds (host)
+  uint32_t tid;     // Task / thread ID
+  char phase;       // 'B' = begin, 'E' = end
+  uint8_t core;     // CPU core the event was recorded on
+};
+
+struct TraceSnapshot {
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+  size_t count;
+  uint32_t ticksPerUs;
+};
+
+// Streaming export state, one per download
+struct TraceExportCursor {
+  size_t next = 0;     // Next event index, count = footer
+  bool started = false;
+  char pending[192];   // Formatted piece not yet copied out
+  size_t pendingLen = 0;
+  size_t pendingPos = 0;
+};
+
+// ============================================
+// Tracer Variables
+// ============================================
+TraceEvent traceRing[TRACE_BUFFER_EVENTS];
+size_t traceHead = 0;
+uint32_t traceRecorded = 0;
+uint32_t traceOverwritten = 0;
+
+#ifdef ARDUINO
+portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+#else
+std::mutex traceMutex;
+#endif
+
+// ============================================
+// Tracer Functions
+// ============================================
+
+/**
+ * Timestamp ticks per microsecond
+ */
+uint32_t traceTicksPerUs() {
+#ifdef ARDUINO
+  return 1;
+#else
+  return 1000;
+#endif
+}
+
+/**
+ * Record a single begin/end event into the ring
+ */
+void traceRecord(const char *name, char phase) {
+#ifdef ARDUINO
+  uint32_t tid = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&traceMux);
+  uint8_t core = (uint8_t)xPortGetCoreID();
+  // One clock for both cores: each core's CCOUNT runs on its own and
+  // wraps every ~18 s, which scrambles the order across cores
+  uint64_t ticks = (uint64_t)esp_timer_get_time();
+#else
+  uint32_t tid =
+      (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+  uint8_t core = 0;
+  uint64_t ticks = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                       .count();
+  std::lock_guard<std::mutex> lock(traceMutex);
+#endif
+
+  TraceEvent &event = traceRing[traceHead];
+  event.name = name;
+  event.ticks = ticks;
+  event.tid = tid;
+  event.phase = phase;
+  event.core = core;
+
+  traceHead = (traceHead + 1) % TRACE_BUFFER_EVENTS;
+  if (traceRecorded >= TRACE_BUFFER_EVENTS) {
+    traceOverwritten++;
+  }
+  traceRecorded++;
+
+#ifdef ARDUINO
+  portEXIT_CRITICAL(&traceMux);
+#endif
+}
+
+/**
+ * RAII helper behind TRACE_SCOPE()
+ */
+class TraceScope {
+public:
+  explicit TraceScope(const char *name) : _name(name) {
+    traceRecord(_name, 'B');
+  }
+  ~TraceScope() { traceRecord(_name, 'E'); }
+
+private:
+  const char *_name;
+};
+
+/**
+ * Copy the ring, oldest event first
+ */
+void traceTakeSnapshot(TraceSnapshot *snapshot) {
+#ifdef ARDUINO
+  portENTER_CRITICAL(&traceMux);
+#else
+  std::lock_guard<std::mutex> lock(traceMutex);
+#endif
+
+  size_t count = traceRecorded < TRACE_BUFFER_EVENTS ? traceRecorded
+                                                     : TRACE_BUFFER_EVENTS;
+  size_t start = (traceHead + TRACE_BUFFER_EVENTS - count) % TRACE_BUFFER_EVENTS;
+  for (size_t i = 0; i < count; i++) {
+    snapshot->events[i] = traceRing[(start + i) % TRACE_BUFFER_EVENTS];
+  }
+  snapshot->count = count;
+
+#ifdef ARDUINO
+  portEXIT_CRITICAL(&traceMux);
+#endif
+
+  snapshot->ticksPerUs = traceTicksPerUs();
+}
+
+/**
+ * Clear all recorded events
+ */
+void traceReset() {
+#ifdef ARDUINO
+  portENTER_CRITICAL(&traceMux);
+#else
+  std::lock_guard<std::mutex> lock(traceMutex);
+#endif
+
+  traceHead = 0;
+  traceRecorded = 0;
+  traceOverwritten = 0;
+
+#ifdef ARDUINO
+  portEXIT_CRITICAL(&traceMux);
+#endif
+}
+
+/**
+ * Format the next JSON piece (header, one event or footer) into the cursor
+ * Returns false once the document is complete
+ */
+bool traceFormatPiece(const TraceSnapshot &snapshot, TraceExportCursor &cursor) {
+  size_t count = snapshot.count;
+  int written = 0;
+
+  if (!cursor.started) {
+    written = snprintf(cursor.pending, sizeof(cursor.pending),
+                       "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    cursor.started = true;
+  } else if (cursor.next < count) {
+    const TraceEvent &event = snapshot.events[cursor.next];
+    // Signed, so an event older than the first one cannot wrap around
+    int64_t delta = (int64_t)(event.ticks - snapshot.events[0].ticks);
+    double ts = (double)delta / snapshot.ticksPerUs;
+    written = snprintf(cursor.pending, sizeof(cursor.pending),
+                       "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                       "\"pid\":1,\"tid\":%u,\"args\":{\"core\":%u}}",
+                       cursor.next > 0 ? "," : "", event.name, event.phase, ts,
+                       (unsigned)event.tid, (unsigned)event.core);
+    cursor.next++;
+  } else if (cursor.next == count) {
+    written = snprintf(cursor.pending, sizeof(cursor.pending), "]}");
+    cursor.next++;
+  } else {
+    return false;
+  }
+
+  cursor.pendingLen =
+      written < (int)sizeof(cursor.pending) ? written : sizeof(cursor.pending) - 1;
+  cursor.pendingPos = 0;
+  return true;
+}
+
+/**
+ * Write as much of the Chrome trace JSON as fits into buffer
+ * Returns bytes written, 0 when the export is complete
+ */
+size_t traceExportChunk(const TraceSnapshot &snapshot, TraceExportCursor &cursor,
+                        char *buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (cursor.pendingPos >= cursor.pendingLen &&
+        !traceFormatPiece(snapshot, cursor)) {
+      break;
+    }
+
+    size_t n = cursor.pendingLen - cursor.pendingPos;
+    if (n > maxLen - written) {
+      n = maxLen - written;
+    }
+    memcpy(buffer + written, cursor.pending + cursor.pendingPos, n);
+    cursor.pendingPos += n;
+    written += n;
+  }
+
+  return written;
+}
+
+/**
+ * Write the complete trace to a stdio stream (host builds, replays)
+ */
+void traceWriteFile(FILE *out) {
+  TraceSnapshot *snapshot = new TraceSnapshot();
+  traceTakeSnapshot(snapshot);
+
+  TraceExportCursor cursor;
+  char buffer[512];
+  size_t n;
+  while ((n = traceExportChunk(*snapshot, cursor, buffer, sizeof(buffer))) > 0) {
+    fwrite(buffer, 1, n, out);
+  }
+
+  delete snapshot;
+}
+
+#endif // TRACE_ENABLED
+
+#endif // TRACE_H
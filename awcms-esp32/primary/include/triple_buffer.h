@@ -0,0 +1,162 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Latest-Frame Triple Buffer
+ *
+ * One writer (the capture task) and any number of readers share
+ * FRAME_SLOTS slots. The writer fills a slot nobody holds and publishes it
+ * as the latest; readers take a reference to the latest complete frame.
+ * Nobody waits on a lock or on the sensor: a reader that holds a frame for
+ * a slow client only narrows the writer's choice of slots, and when every
+ * slot is held the new frame is dropped and counted.
+ *
+ * Only indexes, reference counts and frame metadata live here; the frame
+ * bytes are owned by the caller (camera.h keeps them in PSRAM). No Arduino
+ * dependencies, bench/bench_main.cpp exercises it on the host.
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================
+// Triple Buffer Configuration
+// ============================================
+
+#ifndef FRAME_SLOTS
+#define FRAME_SLOTS 3
+#endif
+
+// Lag EWMA weight per acquired frame
+#define FRAME_LAG_ALPHA 0.1f
+
+// ============================================
+// Triple Buffer Types
+// ============================================
+
+struct FrameSlot {
+  uint8_t *buf;
+  size_t capacity;
+  size_t len;
+  uint32_t seq;        // Publish order, 0 = never published
+  uint32_t capturedAt; // ms
+  std::atomic<uint32_t> refs;
+};
+
+struct TripleBuffer {
+  FrameSlot slots[FRAME_SLOTS];
+  std::atomic<int> latest; // Index of the newest complete frame, -1 = none
+  uint32_t seq;            // Writer only
+  uint32_t published;
+  uint32_t dropped; // Frames lost because every other slot was held
+};
+
+// Per-consumer view of how far behind the capture it runs
+struct FrameConsumer {
+  const char *name;
+  uint32_t lastSeq;
+  uint32_t frames;
+  uint32_t skipped; // Published frames this consumer never saw
+  uint32_t repeats; // Same frame acquired again (consumer faster than capture)
+  uint32_t lagMax;  // ms from capture to acquire
+  float lagAvg;
+};
+
+// ============================================
+// Triple Buffer Functions
+// ============================================
+
+void tripleBufferInit(TripleBuffer &tb) {
+  for (size_t i = 0; i < FRAME_SLOTS; i++) {
+    FrameSlot &slot = tb.slots[i];
+    slot.buf = NULL;
+    slot.capacity = 0;
+    slot.len = 0;
+    slot.seq = 0;
+    slot.capturedAt = 0;
+    slot.refs.store(0);
+  }
+  tb.latest.store(-1);
+  tb.seq = 0;
+  tb.published = 0;
+  tb.dropped = 0;
+}
+
+/**
+ * Writer: a slot that is neither the latest nor held by a reader,
+ * NULL when readers hold all the others
+ */
+FrameSlot *tripleBufferClaim(TripleBuffer &tb) {
+  int latest = tb.latest.load();
+  for (int i = 0; i < FRAME_SLOTS; i++) {
+    if (i != latest && tb.slots[i].refs.load() == 0) {
+      return &tb.slots[i];
+    }
+  }
+  tb.dropped++;
+  return NULL;
+}
+
+/**
+ * Writer: make a filled slot the latest frame
+ */
+void tripleBufferPublish(TripleBuffer &tb, FrameSlot *slot, size_t len,
+                         uint32_t capturedAt) {
+  slot->len = len;
+  slot->seq = ++tb.seq;
+  slot->capturedAt = capturedAt;
+  tb.latest.store((int)(slot - tb.slots));
+  tb.published++;
+}
+
+/**
+ * Reader: reference the newest complete frame, NULL before the first one
+ * Pair with tripleBufferRelease(). The reference is taken before the index
+ * is checked again, so the writer either sees it or the reader retries.
+ */
+FrameSlot *tripleBufferAcquire(TripleBuffer &tb) {
+  while (true) {
+    int index = tb.latest.load();
+    if (index < 0) {
+      return NULL;
+    }
+    FrameSlot *slot = &tb.slots[index];
+    slot->refs.fetch_add(1);
+    if (tb.latest.load() == index) {
+      return slot;
+    }
+    slot->refs.fetch_sub(1); // Replaced meanwhile, take the newer one
+  }
+}
+
+void tripleBufferRelease(FrameSlot *slot) {
+  if (slot) {
+    slot->refs.fetch_sub(1);
+  }
+}
+
+/**
+ * Account an acquired frame to its consumer
+ */
+void frameConsumerNote(FrameConsumer &consumer, const FrameSlot *slot,
+                       uint32_t now) {
+  if (slot->seq == consumer.lastSeq) {
+    consumer.repeats++;
+    return;
+  }
+  if (consumer.lastSeq != 0 && slot->seq > consumer.lastSeq + 1) {
+    consumer.skipped += slot->seq - consumer.lastSeq - 1;
+  }
+  uint32_t lag = now - slot->capturedAt;
+  consumer.lagMax = lag > consumer.lagMax ? lag : consumer.lagMax;
+  consumer.lagAvg = consumer.frames == 0
+                        ? lag
+                        : consumer.lagAvg +
+                              FRAME_LAG_ALPHA * (lag - consumer.lagAvg);
+  consumer.lastSeq = slot->seq;
+  consumer.frames++;
+}
+
+#endif // TRIPLE_BUFFER_H
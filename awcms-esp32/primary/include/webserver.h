@@ -10,15 +10,27 @@
 
 #include "auth.h"
 #include "config.h"
+#include "i18n.h"
+#include "jobs.h"
+#include "lang_bundle.h"
+#include "mem_pools.h"
+#include "metrics.h"
+#include "rate_limit.h"
+#include "rules.h"
+#include "stage_watch.h"
+#include "trace.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
 #include <WiFi.h>
+#include <memory>
 
 // Web server instance
 AsyncWebServer server(WEB_SERVER_PORT);
 AsyncWebSocket ws("/ws");
+bool webServerStarted = false;
+uint32_t calibrationJobId = 0; // Reused while a calibration is pending
 
 // ============================================
 // Function Declarations
@@ -37,51 +49,58 @@ bool initSPIFFS() {
 }
 
 /**
- * Connect to WiFi network
+ * Add device status to a JSON object
  */
-bool connectWiFi() {
-  DEBUG_PRINT("Connecting to WiFi: ");
-  DEBUG_PRINTLN(WIFI_SSID);
-
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED) {
-    if (millis() - startTime > WIFI_TIMEOUT) {
-      DEBUG_PRINTLN("WiFi Connection Timeout");
-      return false;
-    }
-    delay(500);
-    DEBUG_PRINT(".");
-  }
-
-  DEBUG_PRINTLN();
-  DEBUG_PRINT("Connected! IP: ");
-  DEBUG_PRINTLN(WiFi.localIP());
-
-  return true;
+void addDeviceStatusJSON(JsonObject status) {
+  status["device_id"] = DEVICE_ID;
+  status["device_name"] = DEVICE_NAME;
+  status["wifi_rssi"] = WiFi.RSSI();
+  status["ip_address"] = WiFi.localIP().toString();
+  status["uptime"] = millis() / 1000;
+  status["heap_free"] = ESP.getFreeHeap();
+  status["heap_total"] = ESP.getHeapSize();
 }
 
 /**
  * Get device status as JSON
  */
 String getDeviceStatus() {
-  JsonDocument doc;
-
-  doc["device_id"] = DEVICE_ID;
-  doc["device_name"] = DEVICE_NAME;
-  doc["wifi_rssi"] = WiFi.RSSI();
-  doc["ip_address"] = WiFi.localIP().toString();
-  doc["uptime"] = millis() / 1000;
-  doc["heap_free"] = ESP.getFreeHeap();
-  doc["heap_total"] = ESP.getHeapSize();
+  JsonDocument doc(&jsonWebPool);
+  addDeviceStatusJSON(doc.to<JsonObject>());
 
   String output;
   serializeJson(doc, output);
   return output;
 }
 
+/**
+ * Add WiFi link details to a JSON object
+ */
+void addWiFiInfoJSON(JsonObject wifi) {
+  wifi["ssid"] = WiFi.SSID();
+  wifi["rssi"] = WiFi.RSSI();
+  wifi["ip"] = WiFi.localIP().toString();
+  wifi["mac"] = WiFi.macAddress();
+}
+
+/**
+ * Send the dashboard snapshot to one WebSocket client
+ * Serialized straight into the message buffer, no intermediate String
+ */
+void sendSnapshotWS(AsyncWebSocketClient *client) {
+  extern void buildSnapshot(JsonDocument &);
+  JsonDocument doc(&jsonWebPool);
+  buildSnapshot(doc);
+
+  size_t len = measureJson(doc);
+  AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(len);
+  if (!buffer) {
+    return;
+  }
+  serializeJson(doc, (char *)buffer->get(), len + 1);
+  client->text(buffer);
+}
+
 /**
  * WebSocket event handler
  */
@@ -89,8 +108,14 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                AwsEventType type, void *arg, uint8_t *data, size_t len) {
   switch (type) {
   case WS_EVT_CONNECT:
+    if (!admitWebSocket(client, server->count())) {
+      break;
+    }
     DEBUG_PRINTF("WebSocket client #%u connected\n", client->id());
-    client->text(getDeviceStatus());
+    {
+      STAGE_SCOPE(STAGE_WEB);
+      sendSnapshotWS(client);
+    }
     break;
   case WS_EVT_DISCONNECT:
     DEBUG_PRINTF("WebSocket client #%u disconnected\n", client->id());
@@ -110,41 +135,314 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
  */
 void broadcastWS(const String &message) { ws.textAll(message); }
 
+/**
+ * Reply 202 Accepted with the job id, or 503 when the executor is busy
+ */
+void sendJobAccepted(AsyncWebServerRequest *request, uint32_t id) {
+  if (id == 0) {
+    AsyncWebServerResponse *response = request->beginResponse(
+        503, "application/json", "{\"status\":\"busy\"}");
+    response->addHeader("Retry-After", "1");
+    request->send(response);
+    return;
+  }
+
+  AsyncWebServerResponse *response = request->beginResponse(
+      202, "application/json",
+      "{\"status\":\"queued\",\"job\":" + String(id) + "}");
+  response->addHeader("Location", "/api/jobs?id=" + String(id));
+  request->send(response);
+}
+
+/**
+ * Language of a request: ?lang=, then Accept-Language, then the device
+ * default from devices.config
+ */
+uint8_t requestLanguage(AsyncWebServerRequest *request) {
+  extern uint8_t deviceLanguage();
+  if (request->hasParam("lang")) {
+    int lang = findLanguage(request->getParam("lang")->value().c_str());
+    if (lang >= 0) {
+      return lang;
+    }
+  }
+  return languageFromAccept(request->header("Accept-Language").c_str(),
+                            deviceLanguage());
+}
+
+/**
+ * Send the dashboard language bundle straight from flash, already gzip'd
+ * Browsers revalidate every load; an unchanged bundle costs a bodiless 304
+ */
+void sendLangBundle(AsyncWebServerRequest *request) {
+  const char *code = languages[requestLanguage(request)].code;
+  const LangBundle *bundle = &langBundles[0];
+  for (size_t i = 0; i < LANG_BUNDLE_COUNT; i++) {
+    if (strcmp(langBundles[i].code, code) == 0) {
+      bundle = &langBundles[i];
+    }
+  }
+
+  AsyncWebServerResponse *response;
+  if (request->header("If-None-Match") == bundle->etag) {
+    response = request->beginResponse(304);
+  } else {
+    response = request->beginResponse_P(200, "application/json",
+                                        bundle->gzip, bundle->len);
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", bundle->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  response->addHeader("Vary", "Accept-Language");
+  request->send(response);
+}
+
+/**
+ * Job: restart once the response has gone out
+ */
+bool restartJob(void *arg) {
+  delay(1000);
+  ESP.restart();
+  return true;
+}
+
 /**
  * Setup API routes
  */
 void setupAPIRoutes() {
   // API: Get device status
   server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    STAGE_SCOPE(STAGE_WEB);
     request->send(200, "application/json", getDeviceStatus());
   });
 
-  // API: Get sensor data (placeholder)
+  // API: Get everything the dashboard shows in one response
+  server.on("/api/snapshot", HTTP_GET, [](AsyncWebServerRequest *request) {
+    extern void buildSnapshot(JsonDocument &);
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    STAGE_SCOPE(STAGE_WEB);
+    JsonDocument doc(&jsonWebPool);
+    buildSnapshot(doc);
+
+    AsyncResponseStream *response =
+        request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+  });
+
+  // Dashboard strings, ?lang= or Accept-Language picks the language
+  server.on("/lang.json", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    sendLangBundle(request);
+  });
+
+  // API: Get all sensor channels
   server.on("/api/sensors", HTTP_GET, [](AsyncWebServerRequest *request) {
-    JsonDocument doc;
-    doc["temperature"] = 25.5;
-    doc["humidity"] = 60.0;
-    doc["timestamp"] = millis();
+    extern String getSensorsJSON();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    STAGE_SCOPE(STAGE_WEB);
+    request->send(200, "application/json", getSensorsJSON());
+  });
+
+  // API: Get runtime configuration
+  server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
+    extern String getDeviceConfigJSON();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    STAGE_SCOPE(STAGE_WEB);
+    request->send(200, "application/json", getDeviceConfigJSON());
+  });
+
+  // API: Get runtime metrics
+  server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    STAGE_SCOPE(STAGE_WEB);
+    JsonDocument doc(&jsonWebPool);
+    extern void addConnectivityJSON(JsonObject);
+    doc["uptime_ms"] = millis();
+    addBootMetricsJSON(doc["boot"].to<JsonObject>());
+    addConnectivityJSON(doc["wifi"].to<JsonObject>());
+
+    extern size_t outboxDepth();
+    extern uint32_t outboxSent;
+    extern uint32_t outboxDropped;
+    JsonObject outboxObj = doc["outbox"].to<JsonObject>();
+    outboxObj["depth"] = outboxDepth();
+    outboxObj["sent"] = outboxSent;
+    outboxObj["dropped"] = outboxDropped;
+    addJobStatsJSON(doc["jobs"].to<JsonObject>());
+    addAdmissionJSON(doc["admission"].to<JsonObject>());
+    addMemoryJSON(doc["memory"].to<JsonObject>());
+
+    extern void addRecorderJSON(JsonObject);
+    extern void addHistoryJSON(JsonObject);
+    extern void addSyncJSON(JsonObject);
+    extern void addMqttJSON(JsonObject);
+    extern void addStageJSON(JsonObject);
+    extern void addDutyJSON(JsonObject);
+    addRecorderJSON(doc["recorder"].to<JsonObject>());
+    addHistoryJSON(doc["history"].to<JsonObject>());
+    addSyncJSON(doc["sync"].to<JsonObject>());
+    addMqttJSON(doc["mqtt"].to<JsonObject>());
+    addStageJSON(doc["stages"].to<JsonObject>());
+    addDutyJSON(doc["duty"].to<JsonObject>());
 
     String output;
     serializeJson(doc, output);
     request->send(200, "application/json", output);
   });
 
+  // API: Get local rules with hit counters
+  server.on("/api/rules", HTTP_GET, [](AsyncWebServerRequest *request) {
+    extern String getRulesJSON();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    request->send(200, "application/json", getRulesJSON());
+  });
+
+  // API: Replace local rules (text/plain body, one rule per line)
+  server.on(
+      "/api/rules", HTTP_POST,
+      [](AsyncWebServerRequest *request) {
+        extern void queueRulesUpdate(const char *);
+        if (!admitRequest(request, RATE_CLASS_CONTROL)) {
+          return;
+        }
+        if (!requireAuth(request)) {
+          return;
+        }
+        STAGE_SCOPE(STAGE_WEB);
+
+        if (request->contentLength() >= RULES_SOURCE_MAX) {
+          request->send(413, "text/plain", "Rules too long");
+          return;
+        }
+
+        // No body clears all rules
+        const char *source = (const char *)request->_tempObject;
+        if (!source) {
+          source = "";
+        }
+
+        // Validate here so errors reach the client, loop() installs them
+        std::unique_ptr<RuleSet> compiled(new (std::nothrow) RuleSet());
+        if (!compiled) {
+          request->send(503, "text/plain", "Not enough memory");
+          return;
+        }
+
+        RuleError error;
+        if (!rulesCompile(source, *compiled, error)) {
+          JsonDocument doc(&jsonWebPool);
+          doc["error"] = error.message;
+          doc["position"] = error.position;
+          String output;
+          serializeJson(doc, output);
+          request->send(400, "application/json", output);
+          return;
+        }
+
+        queueRulesUpdate(source);
+        request->send(200, "application/json",
+                      "{\"status\":\"accepted\",\"count\":" +
+                          String(compiled->count) + "}");
+      },
+      NULL,
+      [](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+         size_t index, size_t total) {
+        // Collect the body, freed by the request (free())
+        if (total >= RULES_SOURCE_MAX) {
+          return;
+        }
+        if (index == 0) {
+          request->_tempObject = malloc(total + 1);
+        }
+        char *body = (char *)request->_tempObject;
+        if (body) {
+          memcpy(body + index, data, len);
+          body[index + len] = '\0';
+        }
+      });
+
+  // API: Get deferred jobs, or one job with ?id=
+  server.on("/api/jobs", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    uint32_t id = 0;
+    if (request->hasParam("id")) {
+      id = request->getParam("id")->value().toInt();
+    }
+
+    String output = getJobsJSON(id);
+    if (output.length() == 0) {
+      request->send(404, "application/json", "{\"error\":\"unknown job\"}");
+      return;
+    }
+    request->send(200, "application/json", output);
+  });
+
   // API: Restart device
   server.on("/api/restart", HTTP_POST, [](AsyncWebServerRequest *request) {
-    request->send(200, "application/json", "{\"status\":\"restarting\"}");
-    delay(1000);
-    ESP.restart();
+    if (!admitRequest(request, RATE_CLASS_CONTROL)) {
+      return;
+    }
+    sendJobAccepted(request,
+                    submitJob("restart", restartJob, NULL, JOB_PRIORITY_HIGH));
+  });
+
+  // API: Firmware update state
+  server.on("/api/ota", HTTP_GET, [](AsyncWebServerRequest *request) {
+    extern void addOtaJSON(JsonObject);
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    JsonDocument doc(&jsonWebPool);
+    addOtaJSON(doc.to<JsonObject>());
+    String output;
+    serializeJson(doc, output);
+    request->send(200, "application/json", output);
+  });
+
+  // API: Check for a delta update now (?url= overrides OTA_URL)
+  server.on("/api/ota", HTTP_POST, [](AsyncWebServerRequest *request) {
+    extern bool requestOtaCheck(const char *);
+    if (!admitRequest(request, RATE_CLASS_CONTROL)) {
+      return;
+    }
+    if (!requireAuth(request)) {
+      return;
+    }
+    String url =
+        request->hasParam("url") ? request->getParam("url")->value() : "";
+    if (!requestOtaCheck(url.c_str())) {
+      request->send(409, "application/json",
+                    "{\"error\":\"offline, no URL or update running\"}");
+      return;
+    }
+    request->send(202, "application/json", "{\"status\":\"checking\"}");
   });
 
   // API: Get WiFi info
   server.on("/api/wifi", HTTP_GET, [](AsyncWebServerRequest *request) {
-    JsonDocument doc;
-    doc["ssid"] = WiFi.SSID();
-    doc["rssi"] = WiFi.RSSI();
-    doc["ip"] = WiFi.localIP().toString();
-    doc["mac"] = WiFi.macAddress();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    JsonDocument doc(&jsonWebPool);
+    addWiFiInfoJSON(doc.to<JsonObject>());
 
     String output;
     serializeJson(doc, output);
@@ -154,54 +452,253 @@ void setupAPIRoutes() {
   // API: Get gas sensor data
   server.on("/api/gas", HTTP_GET, [](AsyncWebServerRequest *request) {
     extern String getGasSensorJSON();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
     request->send(200, "application/json", getGasSensorJSON());
   });
 
-  // API: Calibrate gas sensor
+  // API: Calibrate gas sensor (CALIBRATION_SAMPLES scans over CALIBRATION_DELAY,
+  // about 0.5 s; poll /api/jobs?id= for the result)
   server.on("/api/gas/calibrate", HTTP_POST,
             [](AsyncWebServerRequest *request) {
-              extern bool calibrateGasSensor();
-              bool success = calibrateGasSensor();
-              String response = success ? "{\"status\":\"calibrated\"}"
-                                        : "{\"status\":\"failed\"}";
-              request->send(200, "application/json", response);
+              extern bool gasCalibrationJob(void *);
+              if (!admitRequest(request, RATE_CLASS_CONTROL)) {
+                return;
+              }
+              if (!isJobPending(calibrationJobId)) {
+                calibrationJobId = submitJob("gas.calibrate", gasCalibrationJob,
+                                             NULL, JOB_PRIORITY_NORMAL);
+              }
+              sendJobAccepted(request, calibrationJobId);
             });
 
   // API: Get camera status
   server.on("/api/camera", HTTP_GET, [](AsyncWebServerRequest *request) {
     extern String getCameraStatusJSON();
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
     request->send(200, "application/json", getCameraStatusJSON());
   });
 
-  // API: Capture single frame
+  // API: Latest frame from the capture task's buffer (never waits on the
+  // sensor)
   server.on("/capture", HTTP_GET, [](AsyncWebServerRequest *request) {
-    extern camera_fb_t *captureFrame();
-    extern void releaseFrame(camera_fb_t *);
+    extern FrameSlot *acquireFrame(FrameConsumer &);
+    extern void releaseFrame(FrameSlot *);
+    extern FrameConsumer camCaptureConsumer;
     extern bool cameraInitialized;
+    if (!admitRequest(request, RATE_CLASS_CAPTURE)) {
+      return;
+    }
 
     if (!cameraInitialized) {
       request->send(503, "text/plain", "Camera not initialized");
       return;
     }
 
-    camera_fb_t *fb = captureFrame();
-    if (!fb) {
-      request->send(500, "text/plain", "Camera capture failed");
+    // The slot stays referenced until the response is destroyed
+    FrameSlot *slot = acquireFrame(camCaptureConsumer);
+    std::shared_ptr<FrameRef> frame(slot ? new (std::nothrow) FrameRef(slot)
+                                         : NULL);
+    if (!frame) {
+      releaseFrame(slot);
+      AsyncWebServerResponse *response =
+          request->beginResponse(503, "text/plain", "No frame yet");
+      response->addHeader("Retry-After", "1");
+      request->send(response);
       return;
     }
 
-    AsyncWebServerResponse *response =
-        request->beginResponse_P(200, "image/jpeg", fb->buf, fb->len);
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "image/jpeg",
+        [frame](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+          FrameSlot *fs = frame->slot;
+          if (index >= fs->len) {
+            return 0;
+          }
+          size_t len = fs->len - index < maxLen ? fs->len - index : maxLen;
+          memcpy(buffer, fs->buf + index, len);
+          return len;
+        });
     response->addHeader("Content-Disposition", "inline; filename=capture.jpg");
+    response->addHeader("X-Frame-Age-Ms", String(millis() - slot->capturedAt));
+    request->send(response);
+  });
+
+  // API: Export stored history as CSV or NDJSON, streamed from flash
+  // ?format=csv|ndjson&from=&to= (Unix s)&type=reading,anomaly,rule&channel=
+  server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_EXPORT)) {
+      return;
+    }
+    std::shared_ptr<HistExportCursor> cursor(new (std::nothrow)
+                                                 HistExportCursor());
+    if (!cursor) {
+      request->send(503, "text/plain", "Not enough memory for export");
+      return;
+    }
+
+    HistFilter filter = {0, 0, 0, -1, HIST_FORMAT_CSV};
+    if (request->hasParam("format") &&
+        request->getParam("format")->value() == "ndjson") {
+      filter.format = HIST_FORMAT_NDJSON;
+    }
+    if (request->hasParam("from")) {
+      filter.from =
+          strtoul(request->getParam("from")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("to")) {
+      filter.to =
+          strtoul(request->getParam("to")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("channel")) {
+      filter.channel = request->getParam("channel")->value().toInt();
+    }
+    if (request->hasParam("type")) {
+      const String &types = request->getParam("type")->value();
+      if (types.indexOf("reading") >= 0) {
+        filter.kinds |= 1 << HIST_READING;
+      }
+      if (types.indexOf("anomaly") >= 0) {
+        filter.kinds |= 1 << HIST_ANOMALY;
+      }
+      if (types.indexOf("rule") >= 0) {
+        filter.kinds |= 1 << HIST_RULE;
+      }
+    }
+    histExportBegin(*cursor, filter);
+
+    bool csv = filter.format == HIST_FORMAT_CSV;
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        csv ? "text/csv" : "application/x-ndjson",
+        [cursor](uint8_t *buffer, size_t maxLen, size_t) {
+          return histExportChunk(*cursor, (char *)buffer, maxLen);
+        });
+    response->addHeader("Content-Disposition",
+                        csv ? "attachment; filename=history.csv"
+                            : "attachment; filename=history.ndjson");
+    request->send(response);
+  });
+
+  // API: Start an event burst (?seconds=, default REC_EVENT_DURATION)
+  server.on("/api/recordings/event", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              extern void recordEvent(uint32_t);
+              extern bool recorderAvailable;
+              if (!admitRequest(request, RATE_CLASS_CONTROL)) {
+                return;
+              }
+              if (!requireAuth(request)) {
+                return;
+              }
+              if (!recorderAvailable) {
+                request->send(503, "application/json",
+                              "{\"error\":\"recorder not available\"}");
+                return;
+              }
+              uint32_t durationMs = REC_EVENT_DURATION;
+              if (request->hasParam("seconds")) {
+                long seconds = request->getParam("seconds")->value().toInt();
+                if (seconds <= 0) {
+                  request->send(400, "application/json",
+                                "{\"error\":\"seconds must be positive\"}");
+                  return;
+                }
+                durationMs = seconds < REC_EVENT_MAX / 1000
+                                 ? (uint32_t)seconds * 1000
+                                 : REC_EVENT_MAX;
+              }
+              recordEvent(durationMs);
+              request->send(200, "application/json",
+                            "{\"status\":\"recording\"}");
+            });
+
+  // API: One recorded frame, ?segment=&t= (ms since segment start)
+  server.on("/api/recordings/frame", HTTP_GET,
+            [](AsyncWebServerRequest *request) {
+              extern void sendRecordingFrame(AsyncWebServerRequest *, uint32_t,
+                                             uint32_t);
+              if (!admitRequest(request, RATE_CLASS_CAPTURE)) {
+                return;
+              }
+              if (!request->hasParam("segment")) {
+                request->send(400, "text/plain", "Missing segment");
+                return;
+              }
+              uint32_t t = 0;
+              if (request->hasParam("t")) {
+                t = request->getParam("t")->value().toInt();
+              }
+              sendRecordingFrame(
+                  request, request->getParam("segment")->value().toInt(), t);
+            });
+
+  // API: Get recorder state and the newest segments (?limit=). Routes match
+  // by prefix, so this goes after the /api/recordings/... routes.
+  server.on("/api/recordings", HTTP_GET, [](AsyncWebServerRequest *request) {
+    extern String getRecordingsJSON(uint32_t);
+    if (!admitRequest(request, RATE_CLASS_API)) {
+      return;
+    }
+    uint32_t limit = REC_LIST_DEFAULT;
+    if (request->hasParam("limit")) {
+      long value = request->getParam("limit")->value().toInt();
+      limit = value < 1 ? 1 : (value > REC_LIST_MAX ? REC_LIST_MAX : value);
+    }
+    request->send(200, "application/json", getRecordingsJSON(limit));
+  });
+
+  // Recording segments, Range requests supported for seeking/resuming
+  server.on("^\\/rec\\/seg_([0-9]+)\\.(mjpg|idx)$", HTTP_GET,
+            [](AsyncWebServerRequest *request) {
+              extern void sendRecordingFile(AsyncWebServerRequest *, uint32_t,
+                                            const String &);
+              if (!admitRequest(request, RATE_CLASS_EXPORT)) {
+                return;
+              }
+              sendRecordingFile(request, request->pathArg(0).toInt(),
+                                request->pathArg(1));
+            });
+
+  // API: Download hot-path trace (Chrome trace / Perfetto JSON)
+  server.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request) {
+    if (!admitRequest(request, RATE_CLASS_CAPTURE)) {
+      return;
+    }
+#if TRACE_ENABLED
+    std::shared_ptr<TraceSnapshot> snapshot(new (std::nothrow) TraceSnapshot());
+    if (!snapshot) {
+      request->send(503, "text/plain", "Not enough memory for trace");
+      return;
+    }
+    traceTakeSnapshot(snapshot.get());
+
+    std::shared_ptr<TraceExportCursor> cursor(new TraceExportCursor());
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "application/json",
+        [snapshot, cursor](uint8_t *buffer, size_t maxLen, size_t) {
+          return traceExportChunk(*snapshot, *cursor, (char *)buffer, maxLen);
+        });
+    response->addHeader("Content-Disposition",
+                        "attachment; filename=trace.json");
     request->send(response);
-    releaseFrame(fb);
+#else
+    request->send(404, "text/plain", "Tracing disabled");
+#endif
   });
 }
 
 /**
  * Initialize and start web server
+ * Safe to call again, e.g. for each network interface that comes up
  */
 void initWebServer() {
+  if (webServerStarted) {
+    return;
+  }
+
   // Initialize SPIFFS
   if (!initSPIFFS()) {
     return;
@@ -224,6 +721,7 @@ void initWebServer() {
 
   // Start server
   server.begin();
+  webServerStarted = true;
   DEBUG_PRINTLN("Web Server Started");
 }
 
@@ -0,0 +1,173 @@
+/**
+ * AWCMS ESP32 IoT Firmware
+ * Window Statistics
+ *
+ * Streaming per-window aggregates updated in O(1) per sample: count,
+ * min/max, mean/variance (Welford), time above a threshold and a
+ * fixed-memory log-bucket histogram for quantiles.
+ * No Arduino dependencies, so it builds on the host as well.
+ */
+
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// ============================================
+// Window Stats Configuration
+// ============================================
+
+// Histogram range; values below the first edge share bucket 0
+#ifndef WINDOW_HIST_MIN
+#define WINDOW_HIST_MIN 1.0f
+#endif
+
+#ifndef WINDOW_HIST_MAX
+#define WINDOW_HIST_MAX 100000.0f
+#endif
+
+// Log-spaced buckets over [MIN, MAX]; 96 gives ~6% relative quantile error
+#ifndef WINDOW_HIST_BUCKETS
+#define WINDOW_HIST_BUCKETS 96
+#endif
+
+// ============================================
+// Window Stats Types
+// ============================================
+
+struct WindowStats {
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+  float m2;          // Sum of squared deviations (Welford)
+  uint32_t startMs;  // Window start
+  uint32_t lastMs;   // Last sample time
+  uint32_t aboveMs;  // Time spent above the threshold
+  bool lastAbove;    // Last sample was above the threshold
+  uint32_t hist[WINDOW_HIST_BUCKETS];
+};
+
+// ============================================
+// Window Stats Functions
+// ============================================
+
+/**
+ * Log-bucket width: bucket i covers [MIN * r^(i-1), MIN * r^i)
+ */
+float windowBucketLogRatio() {
+  static const float logRatio =
+      logf(WINDOW_HIST_MAX / WINDOW_HIST_MIN) / (WINDOW_HIST_BUCKETS - 1);
+  return logRatio;
+}
+
+/**
+ * Histogram bucket for a value
+ */
+int windowBucket(float value) {
+  if (!(value >= WINDOW_HIST_MIN)) {
+    return 0;
+  }
+  int bucket = 1 + (int)(logf(value / WINDOW_HIST_MIN) / windowBucketLogRatio());
+  return bucket < WINDOW_HIST_BUCKETS ? bucket : WINDOW_HIST_BUCKETS - 1;
+}
+
+/**
+ * Start a new, empty window
+ * The above-threshold state carries over so exposure time stays continuous
+ */
+void windowStatsReset(WindowStats &stats, uint32_t nowMs) {
+  bool above = stats.lastAbove;
+  memset(&stats, 0, sizeof(stats));
+  stats.startMs = nowMs;
+  stats.lastMs = nowMs;
+  stats.lastAbove = above;
+}
+
+/**
+ * Add one sample
+ * Time above threshold is credited for the interval since the previous
+ * sample when that sample was above it (sample-and-hold)
+ */
+void windowStatsAdd(WindowStats &stats, float value, uint32_t nowMs,
+                    float threshold) {
+  if (stats.lastAbove) {
+    stats.aboveMs += nowMs - stats.lastMs;
+  }
+  stats.lastMs = nowMs;
+  stats.lastAbove = value > threshold;
+
+  stats.count++;
+  if (stats.count == 1 || value < stats.min) {
+    stats.min = value;
+  }
+  if (stats.count == 1 || value > stats.max) {
+    stats.max = value;
+  }
+
+  float delta = value - stats.mean;
+  stats.mean += delta / stats.count;
+  stats.m2 += delta * (value - stats.mean);
+
+  stats.hist[windowBucket(value)]++;
+}
+
+/**
+ * Sample variance of the window (0 with fewer than two samples)
+ */
+float windowStatsVariance(const WindowStats &stats) {
+  return stats.count > 1 ? stats.m2 / (stats.count - 1) : 0.0f;
+}
+
+/**
+ * Approximate quantile (q in [0, 1]) from the histogram
+ * Returns the geometric centre of the matching bucket, clamped to min/max
+ */
+float windowStatsQuantile(const WindowStats &stats, float q) {
+  if (stats.count == 0) {
+    return 0.0f;
+  }
+
+  uint32_t rank = (uint32_t)ceilf(q * stats.count);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  uint32_t seen = 0;
+  int bucket = 0;
+  for (; bucket < WINDOW_HIST_BUCKETS; bucket++) {
+    seen += stats.hist[bucket];
+    if (seen >= rank) {
+      break;
+    }
+  }
+
+  float value = bucket == 0 ? stats.min
+                            : WINDOW_HIST_MIN *
+                                  expf((bucket - 0.5f) * windowBucketLogRatio());
+  if (value < stats.min) {
+    value = stats.min;
+  }
+  if (value > stats.max) {
+    value = stats.max;
+  }
+  return value;
+}
+
+/**
+ * Time above the threshold so far, including the current held sample
+ */
+uint32_t windowStatsAboveMs(const WindowStats &stats, uint32_t nowMs) {
+  return stats.aboveMs + (stats.lastAbove ? nowMs - stats.lastMs : 0);
+}
+
+/**
+ * Window length so far
+ */
+uint32_t windowStatsDuration(const WindowStats &stats, uint32_t nowMs) {
+  return nowMs - stats.startMs;
+}
+
+#endif // WINDOW_STATS_H
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+AWCMS ESP32 IoT Firmware
+Benchmark comparison
+
+Reads the JSON lines printed by bench/bench_main.cpp and compares ns_per_op
+against a stored baseline. Exits 1 when any benchmark regressed by more than
+the threshold.
+
+    .pio/build/native_bench/program > results.jsonl
+    python scripts/bench_compare.py results.jsonl bench/baseline-host.json
+    python scripts/bench_compare.py results.jsonl bench/baseline-host.json --update
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as handle:
+        for line in handle:
+            line = line.strip()
+            # Device logs mix benchmark lines with boot output
+            if not line.startswith("{"):
+                continue
+            try:
+                entry = json.loads(line)
+            except ValueError:
+                continue
+            if "ns_per_op" in entry:
+                results[entry["bench"]] = entry
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[2])
+    parser.add_argument("results", help="benchmark output (JSON lines)")
+    parser.add_argument("baseline", help="baseline JSON file")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed slowdown ratio (default 0.10 = 10%%)")
+    parser.add_argument("--update", action="store_true",
+                        help="write the results as the new baseline")
+    args = parser.parse_args()
+
+    results = load_results(args.results)
+    if not results:
+        print("No benchmark results found in", args.results)
+        return 1
+
+    if args.update:
+        target = next(iter(results.values())).get("target", "unknown")
+        baseline = {
+            "target": target,
+            "ns_per_op": {name: r["ns_per_op"] for name, r in sorted(results.items())},
+        }
+        with open(args.baseline, "w", encoding="utf-8") as handle:
+            json.dump(baseline, handle, indent=2)
+            handle.write("\n")
+        print(f"Baseline written: {args.baseline} ({len(results)} benchmarks)")
+        return 0
+
+    with open(args.baseline, encoding="utf-8") as handle:
+        baseline = json.load(handle)["ns_per_op"]
+
+    regressions = 0
+    print(f"{'benchmark':<28}{'baseline':>12}{'current':>12}{'change':>10}")
+    for name, result in sorted(results.items()):
+        current = result["ns_per_op"]
+        if name not in baseline:
+            print(f"{name:<28}{'-':>12}{current:>12.1f}{'new':>10}")
+            continue
+        base = baseline[name]
+        change = (current - base) / base if base else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<28}{base:>12.1f}{current:>12.1f}{change:>+10.1%}{flag}")
+
+    for name in sorted(set(baseline) - set(results)):
+        print(f"{name:<28}{baseline[name]:>12.1f}{'-':>12}{'missing':>10}")
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+AWCMS ESP32 IoT Firmware
+Language bundle generator
+
+Runs before every firmware build (extra_scripts = pre:scripts/build_web.py)
+and turns each include/lang_<code>.h catalog into a gzip'd JSON bundle for
+the dashboard:
+
+    {"lang": "id", "languages": {"en": "English", ...}, "strings": {...}}
+
+The bundles are written as flash byte arrays to lang_bundle.h in the
+build directory, which is added to the include path; webserver.h serves
+them from flash as-is at /lang.json. Each gets an ETag from its content.
+The header is only rewritten when a catalog changed, so unchanged builds
+stay incremental. Standalone, for a look at the output:
+
+    python scripts/build_web.py --out /tmp/lang
+
+Catalog entries are X(KEY, "text") with one string literal each.
+Standard library only.
+"""
+
+import argparse
+import ast
+import glob
+import gzip
+import hashlib
+import json
+import os
+import re
+
+ENTRY = re.compile(r'^\s*X\((\w+),\s*("(?:[^"\\]|\\.)*")\)', re.MULTILINE)
+
+
+def read_catalog(path):
+    with open(path, encoding="utf-8") as f:
+        source = f.read()
+    return [(key, ast.literal_eval(text)) for key, text in ENTRY.findall(source)]
+
+
+def load_catalogs(include_dir):
+    catalogs = {}
+    for path in sorted(glob.glob(os.path.join(include_dir, "lang_*.h"))):
+        code = os.path.basename(path)[len("lang_"):-len(".h")]
+        catalogs[code] = read_catalog(path)
+
+    reference = [key for key, _ in catalogs["en"]]
+    for code, entries in catalogs.items():
+        keys = [key for key, _ in entries]
+        if keys != reference:
+            missing = sorted(set(reference) - set(keys))
+            extra = sorted(set(keys) - set(reference))
+            raise SystemExit(
+                "lang_%s.h does not match lang_en.h (missing %s, extra %s, "
+                "or out of order)" % (code, missing, extra))
+    return catalogs
+
+
+def build_bundles(catalogs):
+    languages = {code: dict(entries)["LANG_NAME"]
+                 for code, entries in catalogs.items()}
+    bundles = []
+    for code, entries in catalogs.items():
+        body = json.dumps(
+            {"lang": code, "languages": languages, "strings": dict(entries)},
+            ensure_ascii=False, separators=(",", ":")).encode("utf-8")
+        # mtime=0 keeps the bytes, and so the ETag, stable across builds
+        data = gzip.compress(body, compresslevel=9, mtime=0)
+        etag = hashlib.sha256(data).hexdigest()[:16]
+        bundles.append((code, body, data, etag))
+    return bundles
+
+
+def render_header(bundles):
+    lines = [
+        "// Generated by scripts/build_web.py from include/lang_*.h, do not edit",
+        "#ifndef LANG_BUNDLE_H",
+        "#define LANG_BUNDLE_H",
+        "",
+        '#include "i18n.h"',
+        "",
+    ]
+    for code, body, data, etag in bundles:
+        lines.append("// %s: %d bytes JSON, %d gzip'd" % (code, len(body), len(data)))
+        lines.append("const uint8_t LANG_BUNDLE_%s[] PROGMEM = {" % code.upper())
+        for i in range(0, len(data), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+        lines.append("};")
+        lines.append("")
+    lines.append("const LangBundle langBundles[] = {")
+    for code, _, data, etag in bundles:
+        lines.append('    {"%s", LANG_BUNDLE_%s, %d, "\\"%s\\""},'
+                     % (code, code.upper(), len(data), etag))
+    lines.append("};")
+    lines.append("")
+    lines.append("#define LANG_BUNDLE_COUNT %d" % len(bundles))
+    lines.append("")
+    lines.append("#endif // LANG_BUNDLE_H")
+    return "\n".join(lines) + "\n"
+
+
+def generate(project_dir, out_dir):
+    bundles = build_bundles(load_catalogs(os.path.join(project_dir, "include")))
+    header = render_header(bundles)
+    os.makedirs(out_dir, exist_ok=True)
+    path = os.path.join(out_dir, "lang_bundle.h")
+    if os.path.exists(path):
+        with open(path, encoding="utf-8") as f:
+            if f.read() == header:
+                return path, bundles
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(header)
+    return path, bundles
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[1])
+    parser.add_argument("--out", required=True, help="directory for lang_bundle.h")
+    args = parser.parse_args()
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    path, bundles = generate(project_dir, args.out)
+    for code, body, data, etag in bundles:
+        with open(os.path.join(args.out, "lang_%s.json" % code), "wb") as f:
+            f.write(body)
+        print("%s: %d bytes JSON, %d gzip'd, etag %s" % (code, len(body), len(data), etag))
+    print("Wrote %s" % path)
+
+
+try:
+    # SCons, when run by PlatformIO (no __file__ there)
+    Import("env")  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main()
+else:
+    out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")  # noqa: F821
+    path, bundles = generate(env.subst("$PROJECT_DIR"), out_dir)  # noqa: F821
+    env.Append(CPPPATH=[out_dir])  # noqa: F821
+    print("Language bundles: %s -> %s" % (", ".join(b[0] for b in bundles), path))
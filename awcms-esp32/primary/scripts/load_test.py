@@ -0,0 +1,367 @@
+#!/usr/bin/env python3
+"""
+AWCMS ESP32 IoT Firmware
+Web server load test
+
+Simulates WebSocket dashboards, API pollers and camera viewers against a
+device (or any server with the same routes) and prints JSON lines: one per
+report interval with latency percentiles, throughput, error/shed counts and
+the device's own heap/queue figures from /api/metrics, then a summary.
+
+    python scripts/load_test.py 192.168.1.50 bench/scenarios/dashboards.json
+    python scripts/load_test.py 192.168.1.50 bench/scenarios/dashboards.json \\
+        --ws 8 --duration 120 --out run.jsonl
+
+Scenarios are JSON (see bench/scenarios/). Arrivals are seeded, so a
+scenario replays the same request pattern each run; keep the summaries per
+release to track capacity. Standard library only.
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import random
+import struct
+import sys
+import time
+
+# Statuses the admission control answers with when it sheds load
+SHED_STATUSES = (429, 503)
+
+
+class Stats:
+    """Counters and latency samples for one client kind"""
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.requests = 0
+        self.ok = 0
+        self.shed = 0
+        self.errors = 0
+        self.bytes = 0
+        self.messages = 0
+        self.latencies = []
+
+    def add(self, latency_ms, status, size):
+        self.requests += 1
+        self.bytes += size
+        if 200 <= status < 300:
+            self.ok += 1
+            self.latencies.append(latency_ms)
+        elif status in SHED_STATUSES:
+            self.shed += 1
+        else:
+            self.errors += 1
+
+    def merge(self, other):
+        for field in ("requests", "ok", "shed", "errors", "bytes",
+                      "messages"):
+            setattr(self, field, getattr(self, field) + getattr(other, field))
+        self.latencies.extend(other.latencies)
+
+
+def percentile(values, q):
+    if not values:
+        return None
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, int(round(q * (len(ordered) - 1))))
+    return round(ordered[index], 1)
+
+
+def summarize(stats, seconds):
+    return {
+        "requests": stats.requests,
+        "ok": stats.ok,
+        "shed": stats.shed,
+        "errors": stats.errors,
+        "messages": stats.messages,
+        "rps": round(stats.requests / seconds, 2) if seconds else 0,
+        "kbps": round(stats.bytes * 8 / 1000 / seconds, 1) if seconds else 0,
+        "p50_ms": percentile(stats.latencies, 0.50),
+        "p99_ms": percentile(stats.latencies, 0.99),
+        "max_ms": percentile(stats.latencies, 1.0),
+    }
+
+
+class Target:
+    def __init__(self, host, port, auth, timeout):
+        self.host = host
+        self.port = port
+        self.timeout = timeout
+        self.auth = None
+        if auth:
+            token = base64.b64encode(f"{auth[0]}:{auth[1]}".encode()).decode()
+            self.auth = f"Basic {token}"
+
+    def request_head(self, method, path, extra=""):
+        lines = [f"{method} {path} HTTP/1.1", f"Host: {self.host}"]
+        if self.auth:
+            lines.append(f"Authorization: {self.auth}")
+        return ("\r\n".join(lines) + "\r\n" + extra + "\r\n").encode()
+
+
+async def http_request(target, method, path):
+    """One request on a fresh connection, returns (status, body bytes)"""
+    reader, writer = await asyncio.wait_for(
+        asyncio.open_connection(target.host, target.port), target.timeout)
+    try:
+        extra = "Connection: close\r\n"
+        if method == "POST":
+            extra += "Content-Length: 0\r\n"
+        writer.write(target.request_head(method, path, extra))
+        await writer.drain()
+        status_line = await asyncio.wait_for(reader.readline(), target.timeout)
+        parts = status_line.split()
+        status = int(parts[1]) if len(parts) > 1 else 0
+        size = 0
+        while True:
+            chunk = await asyncio.wait_for(reader.read(4096), target.timeout)
+            if not chunk:
+                break
+            size += len(chunk)
+        return status, size
+    finally:
+        writer.close()
+
+
+async def request_loop(target, stats, group, rng, stop_at):
+    """Poll paths at rate_hz (fixed or Poisson arrivals) until stop_at"""
+    paths = group.get("paths") or [group["path"]]
+    method = group.get("method", "GET")
+    interval = 1.0 / group.get("rate_hz", 1.0)
+    poisson = group.get("arrival", "fixed") == "poisson"
+
+    # Spread the first requests over one interval
+    await asyncio.sleep(rng.uniform(0, interval))
+    while time.monotonic() < stop_at:
+        started = time.monotonic()
+        path = paths[rng.randrange(len(paths))]
+        try:
+            status, size = await http_request(target, method, path)
+        except (OSError, asyncio.TimeoutError, ValueError):
+            status, size = 0, 0
+        stats.add((time.monotonic() - started) * 1000, status, size)
+
+        delay = rng.expovariate(1.0 / interval) if poisson else interval
+        await asyncio.sleep(max(0.0, started + delay - time.monotonic()))
+
+
+async def ws_read_frame(reader, timeout):
+    head = await asyncio.wait_for(reader.readexactly(2), timeout)
+    opcode = head[0] & 0x0F
+    length = head[1] & 0x7F
+    if length == 126:
+        length = struct.unpack(">H", await reader.readexactly(2))[0]
+    elif length == 127:
+        length = struct.unpack(">Q", await reader.readexactly(8))[0]
+    if head[1] & 0x80:
+        await reader.readexactly(4)  # Servers do not mask, skip if they do
+    payload = await reader.readexactly(length)
+    return opcode, payload
+
+
+def ws_frame(opcode, payload):
+    """Client frames are always masked"""
+    mask = os.urandom(4)
+    masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+    return bytes([0x80 | opcode, 0x80 | len(payload)]) + mask + masked
+
+
+async def retry_pause(group, stop_at):
+    """Wait retry_s before reconnecting, but never past stop_at"""
+    await asyncio.sleep(
+        max(0.0, min(group.get("retry_s", 5), stop_at - time.monotonic())))
+
+
+async def ws_client(target, stats, group, rng, stop_at):
+    """Subscribe to /ws, count messages and the gaps between them"""
+    path = group.get("path", "/ws")
+    await asyncio.sleep(rng.uniform(0, group.get("ramp_s", 0)))
+
+    while time.monotonic() < stop_at:
+        writer = None
+        try:
+            reader, writer = await asyncio.wait_for(
+                asyncio.open_connection(target.host, target.port),
+                target.timeout)
+            key = base64.b64encode(os.urandom(16)).decode()
+            extra = ("Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                     f"Sec-WebSocket-Key: {key}\r\n"
+                     "Sec-WebSocket-Version: 13\r\n")
+            writer.write(target.request_head("GET", path, extra))
+            await writer.drain()
+
+            status_line = await asyncio.wait_for(reader.readline(),
+                                                 target.timeout)
+            parts = status_line.split()
+            status = int(parts[1]) if len(parts) > 1 else 0
+            while (await reader.readline()) not in (b"\r\n", b""):
+                pass
+            if status != 101:
+                stats.add(0, status, 0)
+                await retry_pause(group, stop_at)
+                continue
+
+            # Latencies for this group are push gaps, not connect times
+            stats.requests += 1
+            stats.ok += 1
+            last = time.monotonic()
+            while time.monotonic() < stop_at:
+                remaining = max(0.1, stop_at - time.monotonic())
+                opcode, payload = await ws_read_frame(
+                    reader, min(remaining, group.get("idle_timeout_s", 30)))
+                if opcode == 0x8:  # Close, e.g. 1013 when over capacity
+                    code = struct.unpack(">H", payload[:2])[0] if payload else 0
+                    stats.shed += code == 1013
+                    stats.errors += code != 1013
+                    break
+                if opcode == 0x9:
+                    writer.write(ws_frame(0xA, payload))
+                    continue
+                now = time.monotonic()
+                stats.messages += 1
+                stats.bytes += len(payload)
+                # Gap between pushes shows how stale a dashboard gets
+                stats.latencies.append((now - last) * 1000)
+                last = now
+        except asyncio.TimeoutError:
+            if time.monotonic() < stop_at:
+                stats.errors += 1
+        except (OSError, asyncio.IncompleteReadError, ValueError):
+            stats.errors += 1
+        finally:
+            if writer:
+                writer.close()
+        await retry_pause(group, stop_at)
+
+
+async def device_metrics(target):
+    """Heap, queue and admission figures reported by the device itself"""
+    try:
+        reader, writer = await asyncio.wait_for(
+            asyncio.open_connection(target.host, target.port), target.timeout)
+        writer.write(target.request_head("GET", "/api/metrics",
+                                         "Connection: close\r\n"))
+        await writer.drain()
+        raw = await asyncio.wait_for(reader.read(), target.timeout)
+        writer.close()
+        head, _, body = raw.partition(b"\r\n\r\n")
+        if b" 200 " not in head.split(b"\r\n")[0]:
+            return None
+        metrics = json.loads(body)
+    except (OSError, asyncio.TimeoutError, ValueError):
+        return None
+
+    memory = metrics.get("memory", {})
+    return {
+        "internal_free": memory.get("internal_free"),
+        "internal_largest_block": memory.get("internal_largest_block"),
+        "internal_min_free": memory.get("internal_min_free"),
+        "jobs": metrics.get("jobs"),
+        "admission": metrics.get("admission"),
+    }
+
+
+async def run(args, scenario):
+    auth = scenario.get("auth")
+    target = Target(args.host, args.port,
+                    (auth["user"], auth["password"]) if auth else None,
+                    scenario.get("timeout_s", 10))
+    duration = args.duration or scenario.get("duration_s", 60)
+    report_every = scenario.get("report_interval_s", 5)
+    rng = random.Random(scenario.get("seed", 1))
+    overrides = {"ws": args.ws, "api": args.api, "camera": args.camera}
+
+    stop_at = time.monotonic() + duration
+    interval_stats = {}
+    total_stats = {}
+    tasks = []
+    for group in scenario["groups"]:
+        kind = group["kind"]
+        name = group.get("name", kind)
+        count = overrides.get(kind)
+        count = group.get("count", 1) if count is None else count
+        interval_stats[name] = Stats()
+        total_stats[name] = Stats()
+        for _ in range(count):
+            client_rng = random.Random(rng.random())
+            worker = ws_client if kind == "ws" else request_loop
+            tasks.append(asyncio.ensure_future(
+                worker(target, interval_stats[name], group, client_rng,
+                       stop_at)))
+
+    out = open(args.out, "w", encoding="utf-8") if args.out else None
+
+    def emit(entry):
+        line = json.dumps(entry)
+        print(line, flush=True)
+        if out:
+            out.write(line + "\n")
+
+    started = time.monotonic()
+    last_report = started
+    device_low = None
+    while time.monotonic() < stop_at:
+        await asyncio.sleep(min(report_every, stop_at - time.monotonic()))
+        now = time.monotonic()
+        elapsed, last_report = now - last_report, now
+        device = await device_metrics(target)
+        if device and device["internal_free"] is not None:
+            free = device["internal_free"]
+            device_low = free if device_low is None else min(device_low, free)
+
+        entry = {"t": round(now - started, 1), "device": device}
+        for name, stats in interval_stats.items():
+            entry[name] = summarize(stats, elapsed)
+            total_stats[name].merge(stats)
+            stats.reset()
+        emit(entry)
+
+    await asyncio.gather(*tasks, return_exceptions=True)
+    # Requests and frames that finished after the last report
+    for name, stats in interval_stats.items():
+        total_stats[name].merge(stats)
+
+    summary = {
+        "summary": scenario.get("name", args.scenario),
+        "host": args.host,
+        "duration_s": duration,
+        "internal_free_low": device_low,
+    }
+    for name, stats in total_stats.items():
+        summary[name] = summarize(stats, duration)
+    emit(summary)
+    if out:
+        out.close()
+
+    errors = sum(stats.errors for stats in total_stats.values())
+    return 1 if args.fail_on_errors and errors else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[2])
+    parser.add_argument("host", help="device address")
+    parser.add_argument("scenario", help="scenario JSON file")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--duration", type=float,
+                        help="seconds, overrides the scenario")
+    parser.add_argument("--ws", type=int, help="WebSocket subscribers")
+    parser.add_argument("--api", type=int, help="API pollers")
+    parser.add_argument("--camera", type=int, help="camera viewers")
+    parser.add_argument("--out", help="also write the JSON lines here")
+    parser.add_argument("--fail-on-errors", action="store_true",
+                        help="exit 1 if any request failed (shed is not "
+                             "an error)")
+    args = parser.parse_args()
+
+    with open(args.scenario, encoding="utf-8") as handle:
+        scenario = json.load(handle)
+    return asyncio.get_event_loop().run_until_complete(run(args, scenario))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
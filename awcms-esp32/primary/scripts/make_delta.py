@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""
+AWCMS ESP32 IoT Firmware
+Delta patch generator
+
+Builds an AWDP patch (format in include/delta_patch.h) that turns one
+firmware image into another, and names it after the source image's
+SHA-256 so a device can ask for "<ota_url>/<running sha256>.awdp":
+
+    python scripts/make_delta.py old/firmware.bin .pio/build/esp32dev/firmware.bin \\
+        --key ota_key.pem --out-dir ota/
+
+Matches are found on BLOCK-byte source blocks and extended both ways, the
+rest is sent as literals. Signing shells out to `openssl dgst -sha256
+-sign` (ECDSA P-256 recommended: openssl ecparam -name prime256v1 -genkey
+-noout -out ota_key.pem). Standard library only.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+MAGIC = 0x50445741  # "AWDP"
+VERSION = 1
+OP_COPY = 0x01
+OP_DATA = 0x02
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return value * 2 if value >= 0 else -value * 2 - 1
+
+
+def diff(source, target, block):
+    """Yield ("copy", offset, length) and ("data", bytes) ops"""
+    index = {}
+    for offset in range(0, len(source) - block + 1, block):
+        index.setdefault(source[offset:offset + block], offset)
+
+    literal_start = 0
+    pos = 0
+    expect = None  # Source offset that would continue the last copy
+    while pos + block <= len(target):
+        window = target[pos:pos + block]
+        if expect is not None and source[expect:expect + block] == window:
+            offset = expect
+        else:
+            offset = index.get(window)
+        if offset is None:
+            pos += 1
+            continue
+
+        # Extend backwards into pending literals, then forwards
+        start = pos
+        while (start > literal_start and offset > 0 and
+               source[offset - 1] == target[start - 1]):
+            start -= 1
+            offset -= 1
+        end = pos + block
+        src_end = offset + (end - start)
+        while (end < len(target) and src_end < len(source) and
+               source[src_end] == target[end]):
+            end += 1
+            src_end += 1
+
+        if start > literal_start:
+            yield ("data", target[literal_start:start])
+        yield ("copy", offset, end - start)
+        literal_start = pos = end
+        expect = src_end
+
+    if literal_start < len(target):
+        yield ("data", target[literal_start:])
+
+
+def encode(source, target, block):
+    body = bytearray()
+    copy_end = 0
+    copied = 0
+    for op in diff(source, target, block):
+        if op[0] == "copy":
+            _, offset, length = op
+            body += bytes([OP_COPY]) + varint(zigzag(offset - copy_end))
+            body += varint(length)
+            copy_end = offset + length
+            copied += length
+        else:
+            body += bytes([OP_DATA]) + varint(len(op[1])) + op[1]
+    return bytes(body), copied
+
+
+def sign(header, key):
+    with tempfile.NamedTemporaryFile(delete=False) as handle:
+        handle.write(header)
+        path = handle.name
+    try:
+        return subprocess.run(
+            ["openssl", "dgst", "-sha256", "-sign", key, path],
+            check=True, stdout=subprocess.PIPE).stdout
+    finally:
+        os.unlink(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[2])
+    parser.add_argument("source", help="image the device runs now")
+    parser.add_argument("target", help="new image")
+    parser.add_argument("-o", "--out", help="patch file")
+    parser.add_argument("--out-dir",
+                        help="write <source sha256>.awdp into this directory")
+    parser.add_argument("--key", help="PEM private key to sign with")
+    parser.add_argument("--block", type=int, default=32,
+                        help="match block size (default 32)")
+    args = parser.parse_args()
+
+    with open(args.source, "rb") as handle:
+        source = handle.read()
+    with open(args.target, "rb") as handle:
+        target = handle.read()
+
+    source_sha = hashlib.sha256(source).digest()
+    target_sha = hashlib.sha256(target).digest()
+    header = struct.pack("<IHHII32s32s", MAGIC, VERSION, 0, len(source),
+                         len(target), source_sha, target_sha)
+    signature = sign(header, args.key) if args.key else b""
+    body, copied = encode(source, target, args.block)
+    patch = header + struct.pack("<H", len(signature)) + signature + body
+
+    out = args.out
+    if not out:
+        out = os.path.join(args.out_dir or ".", source_sha.hex() + ".awdp")
+    if os.path.dirname(out):
+        os.makedirs(os.path.dirname(out), exist_ok=True)
+    with open(out, "wb") as handle:
+        handle.write(patch)
+
+    print(f"{out}: {len(patch)} bytes for a {len(target)} byte image "
+          f"({100.0 * len(patch) / max(1, len(target)):.1f}%, "
+          f"{100.0 * copied / max(1, len(target)):.1f}% copied), "
+          f"{'signed' if signature else 'UNSIGNED'}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -6,14 +6,35 @@
  * - Web dashboard interface
  * - Gas sensor monitoring (MQ series)
  * - Camera streaming (ESP32-CAM)
- * - Supabase cloud sync
+ * - Supabase cloud sync (REST or MQTT)
  * - Real-time WebSocket updates
+ * - Hot-path tracing (/api/trace)
+ * - Local history with CSV/NDJSON export (/api/history)
+ * - SD card time-lapse/event recording (ESP32-CAM)
+ * - Signed delta OTA updates with rollback (/api/ota)
+ * - Stage time budgets with stall reports across resets
+ * - Duty-cycled loop with light/modem sleep between deadlines
  */
 
 #include "camera.h"
 #include "config.h"
+#include "connectivity.h"
+#include "device_config.h"
+#include "duty_cycle.h"
 #include "gas_sensor.h"
+#include "history.h"
+#include "jobs.h"
+#include "local_rules.h"
+#include "loop_wake.h"
+#include "mem_pools.h"
+#include "metrics.h"
+#include "mqtt_client.h"
+#include "ota.h"
+#include "recorder.h"
+#include "snapshot.h"
+#include "stage_watch.h"
 #include "supabase_client.h"
+#include "trace.h"
 #include "webserver.h"
 #include <Arduino.h>
 
@@ -21,9 +42,115 @@
 // Global Variables
 // ============================================
 unsigned long lastSensorRead = 0;
-unsigned long lastDataSync = 0;
 unsigned long lastGasCheck = 0;
 bool supabaseConnected = false;
+bool networkStarted = false;
+
+// ============================================
+// Network Services
+// ============================================
+
+/**
+ * Station got an IP: (re)start services that need the network
+ */
+void onNetworkUp() {
+  bool firstUp = !networkStarted;
+  networkStarted = true;
+
+  // Initialize web server (no-op if the fallback AP already started it)
+  initWebServer();
+
+  // Set the clock for history timestamps (UTC)
+  configTime(0, 0, NTP_SERVER);
+
+  // Initialize Supabase
+  supabaseConnected = initSupabase();
+
+  // Log startup / recovery event
+  if (supabaseConnected) {
+    // First request on the link also vouches for a reused cached IP
+    confirmWiFiLease(refreshDeviceConfig());
+    if (firstUp) {
+      logEvent("startup", "Device started with gas sensor and camera");
+    } else {
+      logEvent("reconnect", "WiFi connection restored");
+    }
+
+    // Upload at this device's phase of the interval, not in step with every
+    // other device that lost power or WiFi at the same time
+    startSyncSchedule(millis());
+  }
+}
+
+/**
+ * Station lost its connection: pause cloud sync, keep sampling
+ */
+void onNetworkDown() { supabaseConnected = false; }
+
+// ============================================
+// Gas Anomalies
+// ============================================
+
+/**
+ * Push anomaly events from the last scan to WebSocket clients and queue
+ * them for priority upload
+ */
+void handleGasAnomalies() {
+  for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+    uint8_t flags = gasAnomalies[ch];
+    if (flags == ANOMALY_NONE) {
+      continue;
+    }
+
+    broadcastWS(getGasAnomalyFrame(ch, flags));
+
+    char message[128];
+    snprintf(message, sizeof(message),
+             "%s on %s: %.1f PPM, slope %.2f PPM/s, baseline %.1f PPM",
+             anomalyName(flags), gasChannels[ch].model, gasChannels[ch].ppm,
+             gasDetectors[ch].slope, gasDetectors[ch].mean);
+    queueLogEvent("anomaly", message, OUTBOX_PRIORITY_HIGH);
+    appendHistory(HIST_ANOMALY, ch, flags, gasChannels[ch].ppm,
+                  gasDetectors[ch].slope);
+    recordEvent(REC_EVENT_DURATION);
+    DEBUG_PRINTF("⚠️ Anomaly: %s\n", message);
+  }
+}
+
+// ============================================
+// Local Rules
+// ============================================
+
+/**
+ * Run the actions of a rule that fired or cleared
+ */
+void onRuleEvent(const RuleSet &set, uint8_t index, bool active) {
+  const Rule &rule = set.rules[index];
+
+  if (rule.actions & RULE_ACTION_RELAY) {
+    digitalWrite(rule.relayPin, active ? HIGH : LOW);
+  }
+  if (rule.actions & RULE_ACTION_WS) {
+    broadcastWS(getRuleFrame(set, index, active));
+  }
+  appendHistory(HIST_RULE, rule.channel, index, rule.value, active ? 1 : 0);
+  if (!active) {
+    return;
+  }
+
+  if (rule.actions & RULE_ACTION_LOG) {
+    char text[RULES_SOURCE_MAX];
+    ruleText(set, index, text, sizeof(text));
+    queueLogEvent("rule", text, OUTBOX_PRIORITY_HIGH);
+  }
+  if (rule.actions & RULE_ACTION_SNAPSHOT) {
+    outboxPush("sensor_readings", getGasSyncPayload(), OUTBOX_PRIORITY_HIGH);
+  }
+  if (rule.actions & RULE_ACTION_RECORD) {
+    recordEvent(REC_EVENT_DURATION);
+  }
+  DEBUG_PRINTF("Rule %u fired (%u hits)\n", index, rule.hits);
+}
 
 // ============================================
 // Setup
@@ -31,7 +158,6 @@ bool supabaseConnected = false;
 void setup() {
   // Initialize Serial
   Serial.begin(115200);
-  delay(1000);
 
   DEBUG_PRINTLN();
   DEBUG_PRINTLN("================================");
@@ -42,35 +168,48 @@ void setup() {
   DEBUG_PRINTF("Firmware: v2.0.0\n");
   DEBUG_PRINTLN();
 
-  // Initialize gas sensor
+  // Move large JSON documents to PSRAM when present
+  initMemPools();
+
+  // Load runtime configuration cached in NVS
+  loadDeviceConfig();
+  initSyncSchedule();
+
+  // Start the worker for slow web requests (calibration, restart)
+  initJobs();
+
+  // Count boots of a new firmware image (rolls back if it keeps failing)
+  initOta();
+
+  // Watch stage budgets, queue the last boot's worst overrun for upload
+  initStageWatch();
+  reportPreviousStall();
+
+  // Find stored history on SPIFFS
+  initHistory();
+
+  // Initialize gas sensor and local rules, take the first reading right away
   initGasSensor();
+  loadRules();
+  readGasSensor();
+  lastSensorRead = millis();
+  markBootMilestone(bootMetrics.firstReadingMs);
   DEBUG_PRINTLN("Gas sensor warming up (5-10 min)...");
 
-// Initialize camera (ESP32-CAM only)
-#ifdef ENABLE_CAMERA
-  if (initCamera()) {
-    DEBUG_PRINTLN("Camera ready");
-  } else {
-    DEBUG_PRINTLN("Camera init failed - check connections");
-  }
-#endif
+  // Connect to WiFi in the background, services start from loop()
+  beginWiFi();
 
-  // Connect to WiFi
-  if (connectWiFi()) {
-    // Initialize web server
-    initWebServer();
+// Initialize camera while WiFi associates (ESP32-CAM only)
+#ifdef ENABLE_CAMERA
+  startCameraInit();
 
-    // Initialize Supabase
-    supabaseConnected = initSupabase();
+  // Record to the SD card if one is fitted (frames start once the camera is up)
+  initRecorder();
+#endif
 
-    // Log startup event
-    if (supabaseConnected) {
-      logEvent("startup", "Device started with gas sensor and camera");
-    }
-  } else {
-    DEBUG_PRINTLN("Failed to connect to WiFi");
-    // TODO: Start AP mode for configuration
-  }
+  // Block between deadlines from here on instead of spinning
+  initDutyCycle();
+  loopWakeHook = dutyWake;
 
   DEBUG_PRINTLN("Setup complete!");
   DEBUG_PRINTLN();
@@ -80,59 +219,181 @@ void setup() {
 // Loop
 // ============================================
 void loop() {
+  stageLoopTick();
+
+  // Install rules posted to /api/rules
+  applyPendingRules();
+
+  // Install Ro from a finished calibration job, readings resume
+  applyPendingCalibration();
+
+  // Drive WiFi reconnects and the fallback AP, never blocks
+  switch (updateConnectivity()) {
+  case CONN_EVENT_UP: {
+    TRACE_SCOPE("network.up");
+    STAGE_SCOPE(STAGE_NETWORK);
+    onNetworkUp();
+    break;
+  }
+  case CONN_EVENT_DOWN:
+    onNetworkDown();
+    break;
+  case CONN_EVENT_AP_UP:
+    initWebServer();
+    break;
+  default:
+    break;
+  }
+
   // Clean up WebSocket clients
-  ws.cleanupClients();
+  {
+    TRACE_SCOPE("ws.cleanupClients");
+    ws.cleanupClients();
+  }
 
-  // Read gas sensor at interval
-  if (millis() - lastSensorRead >= SENSOR_READ_INTERVAL) {
+  // Read gas sensor at interval (paused while a calibration job scans)
+  // The MQ comparator output (GAS_ALARM_PIN) samples right away; a trip
+  // during calibration stays pending until readings resume
+  bool gasAlarm = !gasCalibrating && takeGasAlarm();
+  if (!gasCalibrating &&
+      (gasAlarm ||
+       millis() - lastSensorRead >= deviceConfig.sensorReadInterval)) {
     lastSensorRead = millis();
 
     // Read gas sensor
-    readGasSensor();
+    {
+      TRACE_SCOPE("readGasSensor");
+      STAGE_SCOPE(STAGE_SENSOR);
+      readGasSensor();
+    }
 
     // Broadcast to WebSocket clients
-    JsonDocument doc;
-    doc["type"] = "sensor_data";
-    doc["gas_ppm"] = gasPPM;
-    doc["gas_raw"] = gasRaw;
-    doc["gas_voltage"] = gasVoltage;
-    doc["gas_calibrated"] = sensorCalibrated;
-    doc["timestamp"] = millis();
+    String message;
+    {
+      TRACE_SCOPE("serializeJson");
+      message = getGasSensorFrame();
+    }
+    {
+      TRACE_SCOPE("ws.broadcast");
+      STAGE_SCOPE(STAGE_BROADCAST);
+      broadcastWS(message);
+    }
+
+    // Keep one reading per channel every HIST_INTERVAL
+    if (millis() - lastHistorySample >= HIST_INTERVAL) {
+      lastHistorySample = millis();
+      for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+        appendHistory(HIST_READING, ch, (uint16_t)gasChannels[ch].raw,
+                      gasChannels[ch].ppm, gasChannels[ch].voltage);
+      }
+    }
+
+    handleGasAnomalies();
+    {
+      TRACE_SCOPE("rules.evaluate");
+      evaluateGasRules(onRuleEvent);
+    }
 
     // Check for danger level
     if (isGasDangerous()) {
-      doc["alert"] = "DANGER: High gas level detected!";
       DEBUG_PRINTLN("⚠️ DANGER: High gas level!");
     }
 
-    String message;
-    serializeJson(doc, message);
-    broadcastWS(message);
-
-    DEBUG_PRINTF("Gas: %.1f PPM (raw: %.0f)\n", gasPPM, gasRaw);
+    for (size_t ch = 0; ch < GAS_CHANNEL_COUNT; ch++) {
+      DEBUG_PRINTF("Gas %s: %.1f PPM (raw: %.0f)\n", gasChannels[ch].model,
+                   gasChannels[ch].ppm, gasChannels[ch].raw);
+    }
   }
 
-  // Sync data to Supabase at interval
-  if (supabaseConnected && (millis() - lastDataSync >= DATA_SYNC_INTERVAL)) {
-    lastDataSync = millis();
+  // Write history records that have waited too long in RAM
+  updateHistory();
 
-    // Post gas sensor data
-    JsonDocument doc;
-    doc["device_id"] = DEVICE_ID;
-    doc["tenant_id"] = TENANT_ID;
-    doc["gas_ppm"] = gasPPM;
-    doc["gas_raw"] = gasRaw;
-    doc["timestamp"] = millis();
+  // Keep a new firmware image once it has proven itself
+  updateOta();
+
+  // Upload queued events first (anomalies jump the queue)
+  bool mqtt = mqttSelected();
+  bool cloudUp = mqtt ? isWiFiConnected() : supabaseConnected;
+  bool drained = false;
+  if (mqtt && cloudUp) {
+    TRACE_SCOPE("outbox.drain");
+    STAGE_SCOPE(STAGE_OUTBOX);
+    updateMqtt();
+    drained = drainOutboxMqtt();
+  } else {
+    stopMqtt();
+    if (supabaseConnected) {
+      TRACE_SCOPE("outbox.drain");
+      STAGE_SCOPE(STAGE_OUTBOX);
+      drained = drainOutbox();
+    }
+  }
 
+  // Sync data to the cloud when the schedule says so (jitter, server hints)
+  if (cloudUp && syncDue(millis())) {
+    // Post gas sensor data
     String jsonData;
-    serializeJson(doc, jsonData);
+    {
+      TRACE_SCOPE("serializeJson");
+      jsonData = getGasSyncPayload();
+    }
 
-    int httpCode = supabase.insert("sensor_readings", jsonData, false);
-    if (httpCode == 201) {
-      DEBUG_PRINTLN("Gas data synced to Supabase");
+    SyncReply reply = {0, 0, 0};
+    if (mqtt) {
+      // Published from the outbox, so readings survive a broker outage
+      reply.code = outboxPush("sensor_readings", jsonData,
+                              OUTBOX_PRIORITY_NORMAL)
+                       ? 201
+                       : 507;
+    } else {
+      TRACE_SCOPE("supabase.insert");
+      STAGE_SCOPE(STAGE_SYNC);
+      insertRow("sensor_readings", jsonData, reply);
+    }
+    scheduleNextSync(millis(), reply);
+    if (reply.code == 201) {
+      // Window summaries are stored, start the next window
+      resetGasWindows();
+      if (!mqtt) {
+        // Over MQTT only the PUBACK proves the backend has it (mqtt_client.h)
+        markBootMilestone(bootMetrics.firstUploadMs);
+      }
+      DEBUG_PRINTLN(mqtt ? "Gas data queued for MQTT"
+                         : "Gas data synced to Supabase");
     }
   }
 
-  // Small delay to prevent watchdog issues
-  delay(10);
+  // Refresh remote configuration at interval (applies live)
+  if (supabaseConnected &&
+      (millis() - lastConfigRefresh >= deviceConfig.configRefreshInterval)) {
+    TRACE_SCOPE("config.refresh");
+    STAGE_SCOPE(STAGE_CONFIG);
+    refreshDeviceConfig();
+  }
+
+  // Sleep until the next deadline; WiFi events, posted rules and the gas
+  // alarm pin wake us earlier
+  unsigned long next = millis() + DUTY_MAX_SLEEP;
+  if (!gasCalibrating) {
+    next = dutyEarliest(next,
+                        lastSensorRead + deviceConfig.sensorReadInterval);
+  }
+  if (cloudUp) {
+    next = dutyEarliest(next, syncWakeAt(millis()));
+  }
+  if (supabaseConnected) {
+    next = dutyEarliest(next, lastConfigRefresh +
+                                  deviceConfig.configRefreshInterval);
+  }
+  if (apFallbackActive) {
+    // DNSServer is polled, not event driven
+    next = dutyEarliest(next, millis() + WIFI_AP_DNS_POLL);
+  }
+  if (drained) {
+    next = millis(); // More queued rows may be waiting
+  } else if (mqtt && mqttWaiting()) {
+    next = dutyEarliest(next, millis() + 10);
+  }
+  stageLoopIdle();
+  dutyWait(next);
 }